@@ -1,15 +1,20 @@
 #version 430
 
-layout(local_size_x = 27, local_size_y = 1, local_size_z = 1) in;
-
-struct AsteroidData {
-    vec4 position;
-    vec4 rotation;
-    vec4 scale;
-    vec4 velocity;
-    vec4 angularVelocity;
-    vec4 separationVector;
-};
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+// the next state's transforms, the current ones may still be drawn
+#define ASTEROID_NEXT_INSTANCES
+#include "asteroid_instance.glsl"
+#include "asteroid_grid.glsl"
+
+// Collision, separation and integration in one pass. One invocation per entry of the sorted grid, so a workgroup
+// covers a few neighbouring cells. Neighbours are read from the 16 byte cellBodies snapshot that asteroidGridScatter
+// wrote. The state is read from this frame's buffers and written to the next ones, survivors keep their order, and
+// every survivor's instance matrix is built here once instead of in every vertex.
+
+#ifndef COLLISION_STATS
+#define COLLISION_STATS 0
+#endif
 
 const ivec3 offsets3D[27] =
 {
@@ -51,68 +56,181 @@ struct Offsets {
     int value;
 };
 
-layout(std430, binding = 0) buffer AsteroidBuffer {
-    AsteroidData asteroidsData[];
+// one array per member of AsteroidData, positions carry the scale in w
+layout(std430, binding = 0) readonly buffer AsteroidPositionBuffer {
+    vec4 positions[];
+};
+
+layout(std430, binding = 21) readonly buffer AsteroidOrientationBuffer {
+    vec4 orientations[];
+};
+
+layout(std430, binding = 22) readonly buffer AsteroidVelocityBuffer {
+    vec4 velocities[];
+};
+
+layout(std430, binding = 18) writeonly buffer NextAsteroidPositionBuffer {
+    vec4 nextPositions[];
+};
+
+layout(std430, binding = 23) writeonly buffer NextAsteroidOrientationBuffer {
+    vec4 nextOrientations[];
+};
+
+// asteroidGravityForce already wrote the pulled velocity of this asteroid's slot while gravity is on
+layout(std430, binding = 24) buffer NextAsteroidVelocityBuffer {
+    vec4 nextVelocities[];
+};
+
+// slot of every survivor in the next state, the aliveScan of the flags asteroidGridCreation wrote
+layout(std430, binding = 20) readonly buffer SurvivorSlotBuffer {
+    Offsets survivorSlots[];
 };
 
-layout(std430, binding = 1) buffer CellBuffer {
+layout(std430, binding = 1) readonly buffer CellBuffer {
     CellData cellData[];
 };
 
-layout(std430, binding = 2) buffer OffsetsBuffer {
-    Offsets offsets[];
+// every bucket's range of the sorted grid, rewritten by the scan every step so empty buckets are empty ranges
+layout(std430, binding = 2) readonly buffer CellStartBuffer {
+    Offsets cellStarts[];
 };
 
-uvec3 PositionToCellCoord(vec3 position, float radius) {
-    return ivec3(floor(position / radius));
-}
+layout(std430, binding = 27) readonly buffer CellEndBuffer {
+    Offsets cellEnds[];
+};
 
-uint HashCell(uvec3 cellCord){
-    uint a = uint(cellCord.x * 15823);
-    uint c = uint(cellCord.y * 9737333);
-    uint b = uint(cellCord.z * 440817757);
-    return (a + b + c) % uint(cellData.length());
-}
+layout(std430, binding = 9) readonly buffer CellBodyBuffer {
+    vec4 cellBodies[];
+};
+
+#if COLLISION_STATS
+// neighbour bodies looked at and how many of them came from the shared tile, read back by AsteroidBenchmark
+layout(std430, binding = 16) buffer CollisionStatsBuffer {
+    uint candidates;
+    uint tileHits;
+    // candidates from cells that aren't neighbours at all, only there because their cell hashed to the same bucket
+    uint foreignCandidates;
+    // neighbour cells whose bucket an earlier neighbour already scanned
+    uint duplicateBuckets;
+    // the longest bucket any asteroid scanned
+    uint longestChain;
+};
+#endif
 
 vec3 SeparationVector(vec3 a, vec3 b, float ra, float rb){
     return ((a - b)/length(a - b)) * (ra + rb  - length(a-b));
 }
 
-float MeanOfScales(vec3 scale) {
-    return dot(scale, vec3(1.0)) / 3.0;
+uniform float gridRadius;
+uniform float deltaTime;
+// asteroids that start the step further out than this are dropped from the next state, 0 keeps all of them
+uniform float despawnRadius;
+// 1 on the first substep of a fixed step, its start is what drawing blends from
+uniform int startsFixedStep;
+// 1 while asteroidGravityForce runs before collision
+uniform int gravity;
+
+// has to agree with asteroidGridCreation
+bool Dead(vec3 position) {
+    return despawnRadius > 0.0 && length(position) > despawnRadius;
 }
 
-uniform float collisionRadius;
-uniform float gridRadius;
+// the workgroup's own slice of the sorted grid, most neighbours of the same cell are in it
+shared vec4 tile[LOCAL_SIZE_X];
 
 void main() {
-    uint index = gl_WorkGroupID.x;
+    uint slot = gl_GlobalInvocationID.x;
+    uint count = liveCount;
+    uint tableSize = uint(cellStarts.length());
+    uint tileStart = gl_WorkGroupID.x * gl_WorkGroupSize.x;
+    uint tileEnd = min(tileStart + gl_WorkGroupSize.x, count);
+    if (slot < count) tile[gl_LocalInvocationID.x] = cellBodies[slot];
+    barrier();
+    if (slot >= count) return;
+
+    vec4 body = tile[gl_LocalInvocationID.x];
     vec3 sumOfCollisions = vec3(0);
     int amountOfCollisions = 0;
-    AsteroidData currentAsteroid = asteroidsData[index];
-    float scale = MeanOfScales(currentAsteroid.scale.xyz);
-    uvec3 cellCoord = PositionToCellCoord(currentAsteroid.position.xyz, gridRadius) + offsets3D[gl_LocalInvocationID.x];
-    uint hash = HashCell(cellCoord);
-    int currentTablePos = offsets[hash].value;
-
-    while (currentTablePos < int(cellData.length()) && cellData[currentTablePos].cellHash == int(hash)) {
-        //if (cellData[currentTablePos].key != int(index)) { We aleready kinda ignore case when points are the same
-        AsteroidData asteroidToCheck = asteroidsData[cellData[currentTablePos].key];
-        float scale2 = MeanOfScales(asteroidToCheck.scale.xyz);
-
-        float dist = length(asteroidToCheck.position.xyz - currentAsteroid.position.xyz);
-        if (dist <= collisionRadius * scale/2 + collisionRadius * scale2/2) {
-            if (dist != 0){
-                sumOfCollisions += SeparationVector(asteroidToCheck.position.xyz, currentAsteroid.position.xyz, collisionRadius * scale/2, collisionRadius * scale2/2);
+#if COLLISION_STATS
+    uint looked = 0;
+    uint fromTile = 0;
+    uint foreign = 0;
+    uint duplicates = 0;
+    uint longest = 0;
+#endif
+
+    ivec3 cellCoord = PositionToCellCoord(body.xyz, gridRadius);
+    uint scanned[27];
+    for (int neighbour = 0; neighbour < 27; ++neighbour) {
+        uint hash = HashCell(cellCoord + offsets3D[neighbour], tableSize);
+        // two neighbour cells sharing a bucket would count everything in it twice
+        bool duplicate = false;
+        for (int earlier = 0; earlier < neighbour; ++earlier) duplicate = duplicate || scanned[earlier] == hash;
+        scanned[neighbour] = hash;
+        if (duplicate) {
+#if COLLISION_STATS
+            duplicates++;
+#endif
+            continue;
+        }
+        uint begin = uint(cellStarts[hash].value);
+        uint end = uint(cellEnds[hash].value);
+#if COLLISION_STATS
+        longest = max(longest, end - begin);
+#endif
+        for (uint other = begin; other < end; ++other) {
+            bool inTile = other >= tileStart && other < tileEnd;
+            vec4 otherBody = inTile ? tile[other - tileStart] : cellBodies[other];
+#if COLLISION_STATS
+            looked++;
+            if (inTile) fromTile++;
+            ivec3 otherCell = PositionToCellCoord(otherBody.xyz, gridRadius);
+            if (any(greaterThan(abs(otherCell - cellCoord), ivec3(1)))) foreign++;
+#endif
+            float dist = length(otherBody.xyz - body.xyz);
+            // the asteroid itself is at distance 0
+            if (dist != 0 && dist <= body.w + otherBody.w) {
+                sumOfCollisions += SeparationVector(otherBody.xyz, body.xyz, body.w, otherBody.w);
                 amountOfCollisions++;
             }
         }
-        currentTablePos++;
     }
-
-
-    if (amountOfCollisions != 0) {
-        sumOfCollisions /= float(amountOfCollisions);
-        asteroidsData[index].separationVector += vec4(-sumOfCollisions, 1);
+#if COLLISION_STATS
+    atomicAdd(candidates, looked);
+    atomicAdd(tileHits, fromTile);
+    atomicAdd(foreignCandidates, foreign);
+    atomicAdd(duplicateBuckets, duplicates);
+    atomicMax(longestChain, longest);
+#endif
+
+    uint index = uint(cellData[slot].key);
+    if (Dead(body.xyz)) {
+        atomicAdd(deadCount, 1u);
+        return;
+    }
+    vec4 position = positions[index];
+    vec4 start = position;
+    uint next = uint(survivorSlots[index].value);
+    // only this invocation touches the asteroid's next slot, reading gravity's velocity back from it is safe
+    vec4 velocity = gravity != 0 ? nextVelocities[next] : velocities[index];
+    vec4 orientation = orientations[index];
+    vec3 separation = vec3(0);
+    if (amountOfCollisions != 0) separation = -sumOfCollisions / float(amountOfCollisions);
+    if (separation != vec3(0)) {
+        position.xyz += separation;
+        velocity.xyz = normalize(separation) * position.w;
     }
+    position.xyz += velocity.xyz * deltaTime;
+
+    nextPositions[next] = position;
+    nextOrientations[next] = orientation;
+    nextVelocities[next] = velocity;
+    nextAsteroidInstances[next] = AsteroidInstance(position, orientation);
+    // later substeps of a fixed step carry its start along to the survivor's new slot
+    nextAsteroidPreviousInstances[next] = startsFixedStep != 0 ? AsteroidInstance(start, orientation)
+                                                               : asteroidPreviousInstances[index];
+    // the plain read skips the atomic once a faster asteroid got there first, which is nearly always
+    uint speedBits = floatBitsToUint(length(velocity.xyz));
+    if (speedBits > maxSpeedBits) atomicMax(maxSpeedBits, speedBits);
 }
@@ -0,0 +1,29 @@
+#version 430
+
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+
+// Single invocation bookkeeping around a frame, so nothing about the count ever has to go back to the CPU.
+// stage 0, before the grid: count in what the emitter appended, up to the capacity, and size the dispatches
+// stage 1, after collision: drop the dead and size the draws
+
+uniform int stage;
+uniform uint capacity;
+uniform uint spawned;
+
+void main() {
+    if (stage == 0) {
+        liveCount = min(liveCount + spawned, capacity);
+        deadCount = 0;
+        maxSpeedBits = 0;
+        for (uint size = 0; size < ASTEROID_WORKGROUP_SIZES; ++size) {
+            uint localSize = 1u << size;
+            dispatches[size].x = (liveCount + localSize - 1) / localSize;
+            dispatches[size].y = 1;
+            dispatches[size].z = 1;
+        }
+    } else {
+        liveCount -= deadCount;
+        for (uint mesh = 0; mesh < draws.length(); ++mesh) draws[mesh].instanceCount = liveCount;
+    }
+}
@@ -0,0 +1,75 @@
+#version 430
+
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+
+// the current state, one array per member of AsteroidData
+layout (std430, binding = 0) writeonly buffer AsteroidPositionBuffer {
+    vec4 positions[];
+};
+
+layout (std430, binding = 21) writeonly buffer AsteroidOrientationBuffer {
+    vec4 orientations[];
+};
+
+layout (std430, binding = 22) writeonly buffer AsteroidVelocityBuffer {
+    vec4 velocities[];
+};
+
+// same distribution as AsteroidsSystem::Generate
+uniform uint spawnCount;
+uniform uint seed;
+uniform float ringRadius;
+uniform float ringSpan;
+uniform float minScale;
+uniform float maxScale;
+// gravitational constant times the central mass while gravity is on, the asteroids start on circular orbits
+uniform float orbitalGravity;
+
+const float PI = 3.14159265359;
+
+uint Hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float Random(inout uint state, float low, float high) {
+    state = Hash(state);
+    return mix(low, high, float(state) / 4294967295.0);
+}
+
+// glm::quat(euler), w is the scalar part
+vec4 EulerToQuaternion(vec3 euler) {
+    vec3 c = cos(euler * 0.5);
+    vec3 s = sin(euler * 0.5);
+    return vec4(s.x * c.y * c.z - c.x * s.y * s.z,
+                c.x * s.y * c.z + s.x * c.y * s.z,
+                c.x * c.y * s.z - s.x * s.y * c.z,
+                c.x * c.y * c.z + s.x * s.y * s.z);
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= spawnCount) return;
+    // asteroidCounters adds spawnCount to the live count afterwards, past the capacity they are dropped. No atomics,
+    // the same seed always puts the same asteroid in the same slot.
+    uint slot = liveCount + index;
+    if (slot >= positions.length()) return;
+
+    uint state = Hash(seed ^ Hash(index));
+    float angle = Random(state, 0.0, 2.0 * PI);
+    float distance = Random(state, ringRadius, ringRadius + ringSpan);
+    vec3 position = vec3(distance * sin(angle), Random(state, -ringSpan * 5.0, ringSpan * 5.0), distance * cos(angle));
+    vec3 velocity = vec3(Random(state, -0.5, 0.5), Random(state, -0.5, 0.5), Random(state, -0.5, 0.5));
+    // AsteroidsSystem::OrbitalVelocity
+    velocity += vec3(cos(angle), 0.0, -sin(angle)) * sqrt(orbitalGravity / distance);
+    vec3 rotation = vec3(Random(state, 0.0, 2.0 * PI));
+
+    positions[slot] = vec4(position, Random(state, minScale, maxScale));
+    orientations[slot] = EulerToQuaternion(rotation);
+    velocities[slot] = vec4(velocity, 0.0);
+}
@@ -0,0 +1,92 @@
+#version 430
+
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+#include "asteroid_gravity.glsl"
+
+// Builds the BVH over the sorted keys, in passes:
+// 0: every sorted asteroid writes its leaf, and internal node i finds its range and split from the keys alone
+//    (Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees")
+// 1: every leaf walks up to the root, the second child to arrive at a node sums both into it
+// A node is always the sum of its left and right child, in that order, whichever invocation gets to it.
+
+// xyz position, w scale
+layout (std430, binding = 0) readonly buffer AsteroidPositionBuffer {
+    vec4 positions[];
+};
+
+uniform int buildPass;
+
+// length of the common prefix of two sorted keys, their indices break ties between equal codes
+int Delta(int i, int j) {
+    if (j < 0 || j >= int(liveCount)) return -1;
+    uint a = gravityKeys[i].x, b = gravityKeys[j].x;
+    if (a == b) return 32 + (31 - findMSB(uint(i) ^ uint(j)));
+    return 31 - findMSB(a ^ b);
+}
+
+void BuildInternal(int i) {
+    int direction = Delta(i, i + 1) - Delta(i, i - 1) >= 0 ? 1 : -1;
+    // the range reaches as far as the keys share more than with the neighbour on the other side
+    int deltaMin = Delta(i, i - direction);
+    int spanMax = 2;
+    while (Delta(i, i + spanMax * direction) > deltaMin) spanMax *= 2;
+    int span = 0;
+    for (int step = spanMax / 2; step >= 1; step /= 2)
+        if (Delta(i, i + (span + step) * direction) > deltaMin) span += step;
+    int j = i + span * direction;
+
+    // the split is where the range's common prefix ends
+    int deltaNode = Delta(i, j);
+    int split = 0;
+    for (int divisor = 2;; divisor *= 2) {
+        int step = (span + divisor - 1) / divisor;
+        if (Delta(i, i + (split + step) * direction) > deltaNode) split += step;
+        if (step <= 1) break;
+    }
+    int gamma = i + split * direction + min(direction, 0);
+
+    uint left = min(i, j) == gamma ? LeafNode(uint(gamma)) : uint(gamma);
+    uint right = max(i, j) == gamma + 1 ? LeafNode(uint(gamma + 1)) : uint(gamma + 1);
+    gravityLinks[i].x = left;
+    gravityLinks[i].y = right;
+    gravityLinks[i].w = 0u;
+    gravityLinks[left].z = uint(i);
+    gravityLinks[right].z = uint(i);
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= liveCount) return;
+
+    if (buildPass == 0) {
+        vec4 position = positions[gravityKeys[index].y];
+        uint leaf = LeafNode(index);
+        gravityNodes[leaf].centerOfMass = vec4(position.xyz, AsteroidMass(position.w));
+        gravityNodes[leaf].lower = vec4(position.xyz, 0.0);
+        gravityNodes[leaf].upper = vec4(position.xyz, 0.0);
+        // nothing points at the root
+        if (index == 0) gravityLinks[0].z = NO_NODE;
+        if (index + 1 < liveCount) BuildInternal(int(index));
+        return;
+    }
+
+    uint node = gravityLinks[LeafNode(index)].z;
+    while (node != NO_NODE) {
+        // the first child to arrive leaves the node to the second, which sees both children written
+        memoryBarrierBuffer();
+        if (atomicAdd(gravityLinks[node].w, 1u) == 0u) return;
+        memoryBarrierBuffer();
+
+        GravityNode left = gravityNodes[gravityLinks[node].x];
+        GravityNode right = gravityNodes[gravityLinks[node].y];
+        float mass = left.centerOfMass.w + right.centerOfMass.w;
+        vec3 center = mass > 0.0
+                      ? (left.centerOfMass.xyz * left.centerOfMass.w + right.centerOfMass.xyz * right.centerOfMass.w) / mass
+                      : (left.centerOfMass.xyz + right.centerOfMass.xyz) * 0.5;
+        gravityNodes[node].centerOfMass = vec4(center, mass);
+        gravityNodes[node].lower = min(left.lower, right.lower);
+        gravityNodes[node].upper = max(left.upper, right.upper);
+        node = gravityLinks[node].z;
+    }
+}
@@ -0,0 +1,87 @@
+#version 430
+
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+#include "asteroid_gravity.glsl"
+
+// Accelerates every asteroid towards the others and the central body, before asteroidCollision integrates them.
+// Barnes-Hut over the BVH: a node small enough for its distance pulls as one body at its center of mass, closer
+// ones are opened into their children down to the single asteroids. The current state is only read, the pulled
+// velocity goes to the asteroid's slot in the next state, where collision picks it up.
+
+// xyz position, w scale
+layout (std430, binding = 0) readonly buffer AsteroidPositionBuffer {
+    vec4 positions[];
+};
+
+layout (std430, binding = 22) readonly buffer AsteroidVelocityBuffer {
+    vec4 velocities[];
+};
+
+layout (std430, binding = 24) writeonly buffer NextAsteroidVelocityBuffer {
+    vec4 nextVelocities[];
+};
+
+// slot of every survivor in the next state, the aliveScan of the flags asteroidGridCreation wrote
+layout (std430, binding = 20) readonly buffer SurvivorSlotBuffer {
+    int survivorSlots[];
+};
+
+uniform float deltaTime;
+uniform float gravitationalConstant;
+// the body at the origin the asteroids orbit
+uniform float centralMass;
+// nodes smaller than this times their distance pull as one body, 0 opens all of them
+uniform float openingAngle;
+// keeps close pulls finite, about the size of an asteroid
+uniform float softening;
+// asteroids that start the step further out than this are dropped from the next state, 0 keeps all of them
+uniform float despawnRadius;
+
+// has to agree with asteroidGridCreation, a dead asteroid shares its slot with the next survivor
+bool Dead(vec3 position) {
+    return despawnRadius > 0.0 && length(position) > despawnRadius;
+}
+
+// a walk holds one node per level, the 30 bit codes and a few thousand equal ones stay below it. A node that would
+// go past it pulls as one body.
+#define STACK_SIZE 64
+
+vec3 Attraction(vec3 offset, float mass) {
+    float distanceSquared = dot(offset, offset) + softening * softening;
+    return gravitationalConstant * mass * offset * inversesqrt(distanceSquared * distanceSquared * distanceSquared);
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= liveCount) return;
+    vec3 position = positions[index].xyz;
+    if (Dead(position)) return;
+
+    vec3 acceleration = Attraction(-position, centralMass);
+    uint stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0u;
+    while (top > 0) {
+        uint node = stack[--top];
+        GravityNode data = gravityNodes[node];
+        vec3 offset = data.centerOfMass.xyz - position;
+        if (node >= LeafNode(0u)) {
+            if (gravityKeys[node - LeafNode(0u)].y != index) acceleration += Attraction(offset, data.centerOfMass.w);
+            continue;
+        }
+        vec3 size = data.upper.xyz - data.lower.xyz;
+        // a node around the asteroid is always opened, its center of mass can sit right on top of it
+        bool inside = all(greaterThanEqual(position, data.lower.xyz)) && all(lessThanEqual(position, data.upper.xyz));
+        bool far = max(size.x, max(size.y, size.z)) < openingAngle * length(offset);
+        if ((!inside && far) || top + 2 > STACK_SIZE) {
+            acceleration += Attraction(offset, data.centerOfMass.w);
+            continue;
+        }
+        stack[top++] = gravityLinks[node].y;
+        stack[top++] = gravityLinks[node].x;
+    }
+
+    vec4 velocity = velocities[index];
+    nextVelocities[survivorSlots[index]] = vec4(velocity.xyz + acceleration * deltaTime, velocity.w);
+}
@@ -0,0 +1,144 @@
+#version 430
+
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+
+// Sorts the asteroids along a Morton curve for asteroidGravityBuild, a stable radix sort of DIGIT_BITS per round:
+// 0: every asteroid's key, the Morton code of its position and its index
+// 1: every workgroup counts the digits of its block
+// 2: a single workgroup turns the counts into where each block's digits go, all blocks' 0s first
+// 3: every workgroup moves its keys there, in their order, from one key buffer into the other
+// Ten rounds cover the 30 bit codes and end up back in gravityKeys. Equal codes stay in index order, so the sorted
+// keys are unique and the tree built from them doesn't depend on timing.
+
+#define DIGIT_BITS 3
+#define DIGITS 8u
+
+// x Morton code, y asteroid index
+layout (std430, binding = 28) buffer GravityKeyBuffer {
+    uvec2 gravityKeys[];
+};
+
+layout (std430, binding = 29) buffer GravityScratchKeyBuffer {
+    uvec2 scratchKeys[];
+};
+
+// per digit and block, digit major
+layout (std430, binding = 30) buffer GravityDigitBuffer {
+    uint digitOffsets[];
+};
+
+// xyz position, w scale
+layout (std430, binding = 0) readonly buffer AsteroidPositionBuffer {
+    vec4 positions[];
+};
+
+uniform int sortPass;
+// the codes cover [-gravityExtent, gravityExtent]^3, positions outside it share the border's codes
+uniform float gravityExtent;
+// lowest bit of the round's digit
+uniform int digitShift;
+
+// the eight digits' counters, 16 bits each
+shared uvec4 digitCounts[LOCAL_SIZE_X];
+shared uint partial[LOCAL_SIZE_X];
+shared uint carry;
+
+// the 10 bits of x to every third bit
+uint SpreadBits(uint x) {
+    x = (x | (x << 16)) & 0x030000FFu;
+    x = (x | (x << 8)) & 0x0300F00Fu;
+    x = (x | (x << 4)) & 0x030C30C3u;
+    x = (x | (x << 2)) & 0x09249249u;
+    return x;
+}
+
+uint MortonCode(vec3 position) {
+    uvec3 cell = uvec3(clamp((position + gravityExtent) / (2.0 * gravityExtent) * 1024.0, 0.0, 1023.0));
+    return SpreadBits(cell.x) | (SpreadBits(cell.y) << 1) | (SpreadBits(cell.z) << 2);
+}
+
+// digit's counter at one, DIGITS counts nowhere
+uvec4 DigitFlag(uint digit) {
+    uvec4 flag = uvec4(0u);
+    if (digit < DIGITS) flag[digit >> 1] = 1u << (16u * (digit & 1u));
+    return flag;
+}
+
+uint DigitCount(uvec4 counts, uint digit) {
+    return (counts[digit >> 1] >> (16u * (digit & 1u))) & 0xFFFFu;
+}
+
+// Hillis-Steele scans over the workgroup, every invocation has to call them
+uvec4 InclusiveDigitScan(uvec4 value) {
+    uint local = gl_LocalInvocationID.x;
+    digitCounts[local] = value;
+    barrier();
+    for (uint stride = 1; stride < gl_WorkGroupSize.x; stride <<= 1) {
+        uvec4 add = local >= stride ? digitCounts[local - stride] : uvec4(0u);
+        barrier();
+        digitCounts[local] += add;
+        barrier();
+    }
+    return digitCounts[local];
+}
+
+uint ExclusiveScan(uint value) {
+    uint local = gl_LocalInvocationID.x;
+    partial[local] = value;
+    barrier();
+    for (uint stride = 1; stride < gl_WorkGroupSize.x; stride <<= 1) {
+        uint add = local >= stride ? partial[local - stride] : 0u;
+        barrier();
+        partial[local] += add;
+        barrier();
+    }
+    return partial[local] - value;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    uint local = gl_LocalInvocationID.x;
+    if (sortPass == 0) {
+        if (index < liveCount) gravityKeys[index] = uvec2(MortonCode(positions[index].xyz), index);
+        return;
+    }
+
+    uint blocks = (liveCount + gl_WorkGroupSize.x - 1) / gl_WorkGroupSize.x;
+    if (sortPass == 2) {
+        if (local == 0) carry = 0;
+        barrier();
+        uint total = DIGITS * blocks;
+        for (uint base = 0; base < total; base += gl_WorkGroupSize.x) {
+            uint entry = base + local;
+            uint count = entry < total ? digitOffsets[entry] : 0u;
+            uint exclusive = ExclusiveScan(count);
+            uint previous = carry;
+            if (entry < total) digitOffsets[entry] = previous + exclusive;
+            barrier();
+            if (local == gl_WorkGroupSize.x - 1) carry = previous + exclusive + count;
+            barrier();
+        }
+        return;
+    }
+
+    // odd rounds sort back from the scratch keys
+    bool fromScratch = ((digitShift / DIGIT_BITS) & 1) == 1;
+    bool valid = index < liveCount;
+    uvec2 key = uvec2(0u);
+    if (valid) key = fromScratch ? scratchKeys[index] : gravityKeys[index];
+    uint digit = valid ? (key.x >> digitShift) & (DIGITS - 1u) : DIGITS;
+    uvec4 inclusive = InclusiveDigitScan(DigitFlag(digit));
+
+    if (sortPass == 1) {
+        uvec4 totals = digitCounts[gl_WorkGroupSize.x - 1];
+        for (uint counted = local; counted < DIGITS; counted += gl_WorkGroupSize.x)
+            digitOffsets[counted * blocks + gl_WorkGroupID.x] = DigitCount(totals, counted);
+        return;
+    }
+
+    if (!valid) return;
+    uint slot = digitOffsets[digit * blocks + gl_WorkGroupID.x] + DigitCount(inclusive, digit) - 1u;
+    if (fromScratch) gravityKeys[slot] = key;
+    else scratchKeys[slot] = key;
+}
@@ -1,53 +1,49 @@
 #version 430
 
-layout (local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
-
-struct AsteroidData
-{
-    vec4 position;
-    vec4 rotation;
-    vec4 scale;
-    vec4 velocity;
-    vec4 angularVelocity;
-    vec4 separationVector;
-};
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+#include "asteroid_grid.glsl"
 
-struct CellData {
-    int key;
+struct CellRank {
     int cellHash;
+    int rank;
 };
 
-struct Offsets {
-    int value;
+// xyz position, w scale
+layout (std430, binding = 0) readonly buffer AsteroidPositionBuffer {
+    vec4 positions[];
 };
 
-layout (std430, binding = 0) buffer AsteroidBuffer {
-    AsteroidData asteroidsData[];
+// asteroids per bucket of the hash table, zeroed again by asteroidGridScan once it read them
+layout (std430, binding = 6) buffer CellCountBuffer {
+    int cellCounts[];
 };
 
-layout (std430, binding = 1) buffer CellBuffer {
-    CellData cellData[];
+layout (std430, binding = 7) buffer CellRankBuffer {
+    CellRank cellRanks[];
 };
 
-layout (std430, binding = 2) buffer OffsetsBuffer {
-    Offsets offsets[];
+// 1 for asteroids that make it into the next state, zeroed again by the aliveScan that reads them
+layout (std430, binding = 19) buffer AliveFlagBuffer {
+    int aliveFlags[];
 };
 
-uvec3 PositionToCellCoord(vec3 position, float radius) {
-    return ivec3(floor(position / radius));
-}
+uniform float gridRadius;
+// asteroids that start the step further out than this are dropped from the next state, 0 keeps all of them
+uniform float despawnRadius;
 
-uint HashCell(uvec3 cellCord) {
-    uint a = uint(cellCord.x * 15823);
-    uint c = uint(cellCord.y * 9737333);
-    uint b = uint(cellCord.z * 440817757);
-    return (a + b + c) % uint(cellData.length());
+// has to agree with asteroidCollision
+bool Dead(vec3 position) {
+    return despawnRadius > 0.0 && length(position) > despawnRadius;
 }
 
-uniform float gridRadius;
-
 void main() {
-    uint index = gl_WorkGroupID .x;
-    cellData[index].key = int(index);
-    cellData[index].cellHash = int(HashCell(PositionToCellCoord(asteroidsData[index].position.xyz, gridRadius)));
-}
\ No newline at end of file
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= liveCount) return;
+    vec3 position = positions[index].xyz;
+    aliveFlags[index] = Dead(position) ? 0 : 1;
+    int hash = int(HashCell(PositionToCellCoord(position, gridRadius), uint(cellCounts.length())));
+    // the count before our increment is our slot inside the cell, asteroidGridScatter needs nothing else
+    cellRanks[index].cellHash = hash;
+    cellRanks[index].rank = atomicAdd(cellCounts[hash], 1);
+}
@@ -0,0 +1,98 @@
+#version 430
+
+#include "workgroup.glsl"
+
+// Exclusive prefix sum of the cell counts into the cell offsets, in three passes:
+// 0: every workgroup scans its block of cells in shared memory and stores the block's total
+// 1: a single workgroup scans the block totals
+// 2: every cell adds the offset of its block
+// The grid's scan also stores where every bucket ends, so no reader has to look at the next bucket. The aliveScan
+// variant binds the alive flags and survivor slots instead and needs no ends, see AsteroidsSystem::Kernels.
+
+#ifndef SCAN_COUNTS_BINDING
+#define SCAN_COUNTS_BINDING 6
+#endif
+#ifndef SCAN_OFFSETS_BINDING
+#define SCAN_OFFSETS_BINDING 2
+#endif
+
+struct Offsets {
+    int value;
+};
+
+layout (std430, binding = SCAN_OFFSETS_BINDING) buffer OffsetsBuffer {
+    Offsets offsets[];
+};
+
+layout (std430, binding = SCAN_COUNTS_BINDING) buffer CellCountBuffer {
+    int cellCounts[];
+};
+
+#ifdef SCAN_ENDS_BINDING
+layout (std430, binding = SCAN_ENDS_BINDING) buffer EndsBuffer {
+    Offsets ends[];
+};
+#endif
+
+layout (std430, binding = 8) buffer ScanBlockBuffer {
+    int blockSums[];
+};
+
+uniform int scanPass;
+uniform int blockCount;
+
+shared int partial[LOCAL_SIZE_X];
+shared int carry;
+
+// Hillis-Steele scan over the workgroup, every invocation has to call it
+int ExclusiveScan(int value) {
+    uint local = gl_LocalInvocationID.x;
+    partial[local] = value;
+    barrier();
+    for (uint stride = 1; stride < gl_WorkGroupSize.x; stride <<= 1) {
+        int add = local >= stride ? partial[local - stride] : 0;
+        barrier();
+        partial[local] += add;
+        barrier();
+    }
+    return partial[local] - value;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    uint local = gl_LocalInvocationID.x;
+    uint cellCount = uint(offsets.length());
+
+    if (scanPass == 0) {
+        int count = 0;
+        if (index < cellCount) {
+            count = cellCounts[index];
+            // next frame's asteroidGridCreation counts from zero again
+            cellCounts[index] = 0;
+        }
+        int exclusive = ExclusiveScan(count);
+        if (index < cellCount) offsets[index].value = exclusive;
+#ifdef SCAN_ENDS_BINDING
+        if (index < cellCount) ends[index].value = exclusive + count;
+#endif
+        if (local == gl_WorkGroupSize.x - 1) blockSums[gl_WorkGroupID.x] = exclusive + count;
+    } else if (scanPass == 1) {
+        if (local == 0) carry = 0;
+        barrier();
+        for (uint base = 0; base < uint(blockCount); base += gl_WorkGroupSize.x) {
+            uint block = base + local;
+            int sum = block < uint(blockCount) ? blockSums[block] : 0;
+            int exclusive = ExclusiveScan(sum);
+            int previous = carry;
+            if (block < uint(blockCount)) blockSums[block] = previous + exclusive;
+            barrier();
+            if (local == gl_WorkGroupSize.x - 1) carry = previous + exclusive + sum;
+            barrier();
+        }
+    } else {
+        if (index < cellCount) offsets[index].value += blockSums[gl_WorkGroupID.x];
+#ifdef SCAN_ENDS_BINDING
+        if (index < cellCount) ends[index].value += blockSums[gl_WorkGroupID.x];
+#endif
+    }
+}
@@ -0,0 +1,56 @@
+#version 430
+
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+
+struct CellData {
+    int key;
+    int cellHash;
+};
+
+struct Offsets {
+    int value;
+};
+
+struct CellRank {
+    int cellHash;
+    int rank;
+};
+
+// xyz position, w scale
+layout (std430, binding = 0) readonly buffer AsteroidPositionBuffer {
+    vec4 positions[];
+};
+
+layout (std430, binding = 1) buffer CellBuffer {
+    CellData cellData[];
+};
+
+layout (std430, binding = 2) buffer CellStartBuffer {
+    Offsets cellStarts[];
+};
+
+layout (std430, binding = 7) buffer CellRankBuffer {
+    CellRank cellRanks[];
+};
+
+// xyz position, w collision radius, in the same order as cellData
+layout (std430, binding = 9) buffer CellBodyBuffer {
+    vec4 cellBodies[];
+};
+
+uniform float collisionRadius;
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= liveCount) return;
+    // cells end up contiguous and ordered by hash, the order inside a cell is whatever the atomics gave out
+    CellRank cell = cellRanks[index];
+    int slot = cellStarts[cell.cellHash].value + cell.rank;
+    if (slot >= liveCount) return;
+    cellData[slot].key = int(index);
+    cellData[slot].cellHash = cell.cellHash;
+    // the collision kernel only ever needs these 16 bytes of a neighbour
+    vec4 position = positions[index];
+    cellBodies[slot] = vec4(position.xyz, collisionRadius * position.w / 2);
+}
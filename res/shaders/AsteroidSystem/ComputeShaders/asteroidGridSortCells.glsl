@@ -0,0 +1,54 @@
+#version 430
+
+#include "workgroup.glsl"
+#include "asteroid_counters.glsl"
+
+// The scatter places asteroids inside a cell in whatever order the atomics handed out ranks. Sorting every cell by
+// asteroid index makes the order collision sums neighbours in, and with it the whole step, deterministic.
+
+struct CellData {
+    int key;
+    int cellHash;
+};
+
+struct Offsets {
+    int value;
+};
+
+layout (std430, binding = 1) buffer CellBuffer {
+    CellData cellData[];
+};
+
+layout (std430, binding = 2) readonly buffer CellStartBuffer {
+    Offsets cellStarts[];
+};
+
+layout (std430, binding = 27) readonly buffer CellEndBuffer {
+    Offsets cellEnds[];
+};
+
+layout (std430, binding = 9) buffer CellBodyBuffer {
+    vec4 cellBodies[];
+};
+
+void main() {
+    uint slot = gl_GlobalInvocationID.x;
+    if (slot >= liveCount) return;
+    int hash = cellData[slot].cellHash;
+    // the first entry of each cell sorts it, cells are a handful of asteroids
+    if (uint(cellStarts[hash].value) != slot) return;
+    uint end = uint(cellEnds[hash].value);
+
+    for (uint i = slot + 1; i < end; ++i) {
+        CellData cell = cellData[i];
+        vec4 body = cellBodies[i];
+        uint j = i;
+        while (j > slot && cellData[j - 1].key > cell.key) {
+            cellData[j] = cellData[j - 1];
+            cellBodies[j] = cellBodies[j - 1];
+            j--;
+        }
+        cellData[j] = cell;
+        cellBodies[j] = body;
+    }
+}
@@ -0,0 +1,39 @@
+#version 460
+
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// level 0 copies the depth buffer, every other level keeps the farthest depth of the texels it covers
+layout (binding = 0) uniform sampler2D source;
+layout (r32f, binding = 0) uniform writeonly image2D destination;
+
+uniform int sourceLevel;
+uniform ivec2 sourceSize;
+uniform bool firstLevel;
+
+float Fetch(ivec2 coord) {
+    return texelFetch(source, min(coord, sourceSize - 1), sourceLevel).r;
+}
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 destinationSize = imageSize(destination);
+    if (any(greaterThanEqual(coord, destinationSize))) return;
+
+    if (firstLevel) {
+        imageStore(destination, coord, vec4(Fetch(coord)));
+        return;
+    }
+
+    ivec2 sourceCoord = coord * 2;
+    float depth = max(max(Fetch(sourceCoord), Fetch(sourceCoord + ivec2(1, 0))),
+                      max(Fetch(sourceCoord + ivec2(0, 1)), Fetch(sourceCoord + ivec2(1, 1))));
+
+    // odd source sizes: the last row/column would otherwise never be looked at
+    bool extraColumn = (sourceSize.x & 1) != 0 && coord.x == destinationSize.x - 1;
+    bool extraRow = (sourceSize.y & 1) != 0 && coord.y == destinationSize.y - 1;
+    if (extraColumn) depth = max(depth, max(Fetch(sourceCoord + ivec2(2, 0)), Fetch(sourceCoord + ivec2(2, 1))));
+    if (extraRow) depth = max(depth, max(Fetch(sourceCoord + ivec2(0, 2)), Fetch(sourceCoord + ivec2(1, 2))));
+    if (extraColumn && extraRow) depth = max(depth, Fetch(sourceCoord + ivec2(2, 2)));
+
+    imageStore(destination, coord, vec4(depth));
+}
@@ -0,0 +1,149 @@
+#version 460
+
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+struct Meshlet {
+    vec4 sphere;
+    vec4 cone;
+    uint vertexOffset;
+    uint vertexCount;
+    uint triangleOffset;
+    uint triangleCount;
+};
+
+struct DrawElementsIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 10) readonly buffer MeshletBuffer {
+    Meshlet meshlets[];
+};
+
+layout (std430, binding = 11) readonly buffer MeshletVertexBuffer {
+    uint meshletVertices[];
+};
+
+layout (std430, binding = 12) readonly buffer MeshletTriangleBuffer {
+    uint meshletTriangles[];
+};
+
+layout (std430, binding = 13) writeonly buffer CulledIndexBuffer {
+    uint culledIndices[];
+};
+
+layout (std430, binding = 14) buffer DrawCommandBuffer {
+    DrawElementsIndirectCommand command;
+};
+
+// per meshlet, 1 if it was visible at the end of the last frame
+layout (std430, binding = 15) buffer MeshletVisibilityBuffer {
+    uint meshletVisibility[];
+};
+
+uniform mat4 model;
+uniform mat3 normalMatrix;
+uniform mat4 viewProjection;
+uniform vec4 frustumPlanes[6];
+uniform vec3 cameraPosition;
+uniform float maxScale;
+uniform uint meshletCount;
+
+uniform bool frustumCulling;
+uniform bool coneCulling;
+uniform bool occlusionCulling;
+// the early pass draws what was visible last frame, the late pass tests the rest against the Hi-Z built in between
+uniform bool latePass;
+
+uniform sampler2D hiZ;
+uniform vec2 hiZSize;
+uniform int hiZLevels;
+
+shared bool visible;
+shared uint outputOffset;
+
+bool InsideFrustum(vec3 center, float radius) {
+    for (int i = 0; i < 6; ++i) {
+        if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius) return false;
+    }
+    return true;
+}
+
+bool BackfacingCone(vec3 center, float radius, vec4 cone) {
+    if (cone.w >= 1.0) return false;
+    vec3 axis = normalize(normalMatrix * cone.xyz);
+    vec3 view = center - cameraPosition;
+    return dot(view, axis) >= cone.w * length(view) + radius;
+}
+
+bool Occluded(vec3 center, float radius) {
+    // screen rect and nearest depth of the sphere's bounding box
+    vec2 minUV = vec2(1.0);
+    vec2 maxUV = vec2(0.0);
+    float nearestDepth = 1.0;
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = center + radius * vec3((i & 1) == 0 ? -1.0 : 1.0, (i & 2) == 0 ? -1.0 : 1.0, (i & 4) == 0 ? -1.0 : 1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0) return false; // crosses the camera plane, can't say anything
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+        nearestDepth = min(nearestDepth, ndc.z * 0.5 + 0.5);
+    }
+    minUV = clamp(minUV, 0.0, 1.0);
+    maxUV = clamp(maxUV, 0.0, 1.0);
+
+    // pick the level where the rect spans at most 2x2 texels, the 4 samples then cover it completely
+    vec2 size = (maxUV - minUV) * hiZSize;
+    float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, float(hiZLevels - 1));
+
+    float farthest = textureLod(hiZ, minUV, level).r;
+    farthest = max(farthest, textureLod(hiZ, vec2(maxUV.x, minUV.y), level).r);
+    farthest = max(farthest, textureLod(hiZ, vec2(minUV.x, maxUV.y), level).r);
+    farthest = max(farthest, textureLod(hiZ, maxUV, level).r);
+    return nearestDepth > farthest;
+}
+
+void main() {
+    uint meshletIndex = min(gl_WorkGroupID.x, meshletCount - 1);
+    Meshlet meshlet = meshlets[meshletIndex];
+
+    if (gl_LocalInvocationIndex == 0) {
+        vec3 center = (model * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+        float radius = meshlet.sphere.w * maxScale;
+
+        bool valid = gl_WorkGroupID.x < meshletCount;
+        bool isVisible = valid;
+        if (isVisible && frustumCulling) isVisible = InsideFrustum(center, radius);
+        if (isVisible && coneCulling) isVisible = !BackfacingCone(center, radius, meshlet.cone);
+
+        bool wasVisible = valid && meshletVisibility[meshletIndex] == 1u;
+        if (latePass) {
+            // the Hi-Z holds this frame's depth, whatever passes now is visible and becomes next frame's early set
+            if (isVisible) isVisible = !Occluded(center, radius);
+            if (valid) meshletVisibility[meshletIndex] = isVisible ? 1u : 0u;
+            // the early pass already drew it
+            if (wasVisible) isVisible = false;
+        } else if (occlusionCulling) {
+            isVisible = isVisible && wasVisible;
+        }
+
+        visible = isVisible;
+        if (isVisible) outputOffset = atomicAdd(command.count, meshlet.triangleCount * 3);
+    }
+    barrier();
+    if (!visible) return;
+
+    // every invocation expands a few triangles into the compacted index buffer
+    for (uint t = gl_LocalInvocationIndex; t < meshlet.triangleCount; t += gl_WorkGroupSize.x) {
+        uint packed = meshletTriangles[meshlet.triangleOffset + t];
+        uint base = outputOffset + t * 3;
+        culledIndices[base] = meshletVertices[meshlet.vertexOffset + (packed & 0xFFu)];
+        culledIndices[base + 1] = meshletVertices[meshlet.vertexOffset + ((packed >> 8) & 0xFFu)];
+        culledIndices[base + 2] = meshletVertices[meshlet.vertexOffset + ((packed >> 16) & 0xFFu)];
+    }
+}
@@ -3,7 +3,10 @@ layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
 
+#include "vertex_format.glsl"
+
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0);
+    vec3 position = decodePosition(aPos);
+    gl_Position = model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+// GPU resident asteroid count and the indirect arguments derived from it, AsteroidCounters in AsteroidData.h
+
+// groups for every power of two workgroup size, index log2(local size)
+#define ASTEROID_WORKGROUP_SIZES 11
+
+struct DispatchIndirectCommand {
+    uint x;
+    uint y;
+    uint z;
+};
+
+struct DrawElementsIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 17) buffer AsteroidCounterBuffer {
+    // asteroids [0, liveCount) are alive
+    uint liveCount;
+    // counted by asteroidCollision, which leaves them out of the next state
+    uint deadCount;
+    // fastest survivor of the step as float bits, positive floats order like their bits
+    uint maxSpeedBits;
+    DispatchIndirectCommand dispatches[ASTEROID_WORKGROUP_SIZES];
+    // one per mesh of the asteroid model, the CPU fills everything but instanceCount
+    DrawElementsIndirectCommand draws[];
+};
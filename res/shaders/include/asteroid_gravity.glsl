@@ -0,0 +1,38 @@
+// The linear BVH of the gravity stage, AsteroidCpuSimulation builds the same one. Over the asteroids sorted along a
+// Morton curve: internal node i < liveCount - 1 splits its range of them in two, leaf liveCount - 1 + i is the i-th
+// sorted asteroid. Node 0 is the root, with a single asteroid it's the only leaf.
+
+#define NO_NODE 0xFFFFFFFFu
+
+// x Morton code, y asteroid index, sorted by asteroidGravitySort
+layout (std430, binding = 28) buffer GravityKeyBuffer {
+    uvec2 gravityKeys[];
+};
+
+// x, y left and right child, z parent, w how many children the bottom-up pass finished
+layout (std430, binding = 31) buffer GravityLinkBuffer {
+    uvec4 gravityLinks[];
+};
+
+struct GravityNode {
+    // w is the mass
+    vec4 centerOfMass;
+    vec4 lower;
+    vec4 upper;
+};
+
+// the bottom-up pass reads what other invocations just wrote
+layout (std430, binding = 32) coherent buffer GravityNodeBuffer {
+    GravityNode gravityNodes[];
+};
+
+// asteroid mass per scale^3
+uniform float asteroidDensity;
+
+float AsteroidMass(float scale) {
+    return asteroidDensity * scale * scale * scale;
+}
+
+uint LeafNode(uint sorted) {
+    return liveCount - 1u + sorted;
+}
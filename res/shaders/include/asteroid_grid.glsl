@@ -0,0 +1,17 @@
+// The uniform grid asteroids are hashed into, AsteroidCpuSimulation::hashCell on the CPU
+
+ivec3 PositionToCellCoord(vec3 position, float radius) {
+    return ivec3(floor(position / radius));
+}
+
+// tableSize has to be a power of two. Negative coordinates hash through their two's complement bits, so the cells
+// around zero spread over the table like any others instead of wrapping onto a few buckets.
+uint HashCell(ivec3 cell, uint tableSize) {
+    uvec3 bits = uvec3(cell);
+    uint hash = (bits.x * 73856093u) ^ (bits.y * 19349663u) ^ (bits.z * 83492791u);
+    // the products barely touch the low bits the mask keeps, fold the high ones down
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    return hash & (tableSize - 1u);
+}
@@ -0,0 +1,59 @@
+// Render-facing asteroid transforms, AsteroidInstance in AsteroidData.h. asteroidCollision writes one per survivor
+// every step into the next state's buffers, the instanced vertex shaders only read the completed current ones.
+
+// The rows of a 3x4 affine transform, stored as the columns of a mat3x4: vec4(position, 1.0) * matrix is the whole
+// transform, without any trig per vertex.
+#ifdef ASTEROID_NEXT_INSTANCES
+layout (std430, binding = 33) writeonly buffer NextAsteroidInstanceBuffer {
+    mat3x4 nextAsteroidInstances[];
+};
+
+layout (std430, binding = 34) writeonly buffer NextAsteroidPreviousInstanceBuffer {
+    mat3x4 nextAsteroidPreviousInstances[];
+};
+#else
+layout (std430, binding = 25) readonly buffer AsteroidInstanceBuffer {
+    mat3x4 asteroidInstances[];
+};
+
+// how far back towards asteroidPreviousInstances to draw, 0 draws the newest state
+uniform float stepLag;
+#endif
+
+// The transforms when the fixed step that wrote asteroidInstances began. The renderer draws between the two, so the
+// drawn position doesn't jump with how many fixed steps fit into a frame.
+layout (std430, binding = 26) readonly buffer AsteroidPreviousInstanceBuffer {
+    mat3x4 asteroidPreviousInstances[];
+};
+
+// the vertex shaders used to add this much of the model's translation matrix, its identity part included
+const float MODEL_BLEND = 0.835;
+
+// Same matrix as AsteroidInstance::of. positionScale is a position with its uniform scale in w, orientation a unit
+// quaternion with w as the scalar part.
+mat3x4 AsteroidInstance(vec4 positionScale, vec4 orientation) {
+    vec4 q = orientation;
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    float scale = positionScale.w + MODEL_BLEND;
+    // the old vertex shaders scaled the position along with the mesh
+    vec3 translation = positionScale.xyz * positionScale.w;
+    return mat3x4(
+        vec4(scale * vec3(1.0 - 2.0 * (yy + zz), 2.0 * (xy - wz), 2.0 * (xz + wy)), translation.x),
+        vec4(scale * vec3(2.0 * (xy + wz), 1.0 - 2.0 * (xx + zz), 2.0 * (yz - wx)), translation.y),
+        vec4(scale * vec3(2.0 * (xz - wy), 2.0 * (yz + wx), 1.0 - 2.0 * (xx + yy)), translation.z));
+}
+
+#ifndef ASTEROID_NEXT_INSTANCES
+// an instance's transform at frame time, stepLag of the way back to where its fixed step began
+mat3x4 AsteroidBlendedInstance(uint instance) {
+    mat3x4 newest = asteroidInstances[instance];
+    return newest + (asteroidPreviousInstances[instance] - newest) * stepLag;
+}
+
+// a mesh position of an instance at frame time
+vec3 AsteroidTransform(uint instance, vec3 position) {
+    return vec4(position, 1.0) * AsteroidBlendedInstance(instance);
+}
+#endif
@@ -0,0 +1,56 @@
+// PBR light data shared by the lighting shaders, LightSystem fills the buffers and binds the shadow maps.
+// MAX_LIGHTS is LightSystem::maxShadowMaps, injected by PBRSystem.
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 5
+#endif
+
+layout (binding = 8) uniform samplerCube cubeShadowMaps[MAX_LIGHTS];
+layout (binding = 8 + MAX_LIGHTS) uniform sampler2D planeShadowMaps[MAX_LIGHTS];
+
+struct DirLight {
+    vec4 direction;
+    vec4 color;
+    vec4 position;
+    mat4x4 lightSpaceMatrix;
+};
+
+struct PointLight {
+    vec4 position;
+
+    float constant;
+    float linear;
+    float quadratic;
+    float pointlessfloat;
+
+    vec4 color;
+};
+
+struct SpotLight {
+    vec4 position;
+    vec4 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float pointlessfloat;
+    float pointlessfloat2;
+    float pointlessfloat3;
+
+    vec4 color;
+    mat4x4 lightSpaceMatrix;
+};
+
+layout (std430, binding = 3) buffer DirLightBuffer {
+    DirLight dirLights[];
+};
+
+layout (std430, binding = 4) buffer PointLightBuffer {
+    PointLight pointLights[];
+};
+
+layout (std430, binding = 5) buffer SpotLightBuffer {
+    SpotLight spotLights[];
+};
@@ -0,0 +1,15 @@
+// vertex format decode, see Mesh::bindVertexFormat. Draws that never set it decode float positions as they are.
+uniform vec3 vertexPositionOffset = vec3(0.0);
+uniform vec3 vertexPositionScale = vec3(1.0);
+uniform bool vertexOctahedralNormals;
+
+vec3 decodePosition(vec3 position) {
+    return position * vertexPositionScale + vertexPositionOffset;
+}
+
+vec3 decodeNormal(vec3 normal) {
+    if (!vertexOctahedralNormals) return normal;
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
@@ -0,0 +1,88 @@
+#version 460
+
+// single workgroup: every invocation projects a strided share of the texels of all six faces, then the
+// partial sums are reduced one coefficient at a time so shared memory stays at one vec4 per invocation
+layout (local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+uniform samplerCube environmentMap;
+uniform float sampleLevel;
+uniform int sampleSize;
+
+// read as the std140 IrradianceSH uniform block by the PBR shaders
+layout (std430, binding = 15) writeonly buffer IrradianceSHBuffer {
+    vec4 coefficients[9];
+};
+
+shared vec4 partial[256];
+
+const float PI = 3.14159265359;
+// clamped cosine convolution per band divided by pi
+const float bandScale[9] = float[](1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25);
+
+vec3 FaceDirection(int face, float u, float v) {
+    if (face == 0) return vec3(1.0, -v, -u);
+    if (face == 1) return vec3(-1.0, -v, u);
+    if (face == 2) return vec3(u, 1.0, v);
+    if (face == 3) return vec3(u, -1.0, -v);
+    if (face == 4) return vec3(u, -v, 1.0);
+    return vec3(-u, -v, -1.0);
+}
+
+void Basis(vec3 n, out float y[9]) {
+    y[0] = 0.282095;
+    y[1] = 0.488603 * n.y;
+    y[2] = 0.488603 * n.z;
+    y[3] = 0.488603 * n.x;
+    y[4] = 1.092548 * n.x * n.y;
+    y[5] = 1.092548 * n.y * n.z;
+    y[6] = 0.315392 * (3.0 * n.z * n.z - 1.0);
+    y[7] = 1.092548 * n.x * n.z;
+    y[8] = 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+void main() {
+    vec3 sums[9];
+    for (int k = 0; k < 9; ++k) sums[k] = vec3(0.0);
+    float weightSum = 0.0;
+
+    float texelStep = 2.0 / float(sampleSize);
+    float texelArea = texelStep * texelStep;
+    int faceTexels = sampleSize * sampleSize;
+    for (int texel = int(gl_LocalInvocationIndex); texel < 6 * faceTexels; texel += int(gl_WorkGroupSize.x)) {
+        int face = texel / faceTexels;
+        int index = texel - face * faceTexels;
+        float u = (float(index % sampleSize) + 0.5) * texelStep - 1.0;
+        float v = (float(index / sampleSize) + 0.5) * texelStep - 1.0;
+
+        float inverseLength = inversesqrt(1.0 + u * u + v * v);
+        float weight = texelArea * inverseLength * inverseLength * inverseLength;
+        vec3 direction = FaceDirection(face, u, v) * inverseLength;
+        vec3 color = textureLod(environmentMap, direction, sampleLevel).rgb * weight;
+
+        float y[9];
+        Basis(direction, y);
+        for (int k = 0; k < 9; ++k) sums[k] += color * y[k];
+        weightSum += weight;
+    }
+
+    // the texel solid angles only approximately cover the sphere, scale them to exactly 4 pi
+    partial[gl_LocalInvocationIndex] = vec4(0.0, 0.0, 0.0, weightSum);
+    barrier();
+    for (uint stride = gl_WorkGroupSize.x / 2; stride > 0; stride /= 2) {
+        if (gl_LocalInvocationIndex < stride) partial[gl_LocalInvocationIndex] += partial[gl_LocalInvocationIndex + stride];
+        barrier();
+    }
+    float normalization = 4.0 * PI / partial[0].w;
+    barrier();
+
+    for (int k = 0; k < 9; ++k) {
+        partial[gl_LocalInvocationIndex] = vec4(sums[k], 0.0);
+        barrier();
+        for (uint stride = gl_WorkGroupSize.x / 2; stride > 0; stride /= 2) {
+            if (gl_LocalInvocationIndex < stride) partial[gl_LocalInvocationIndex] += partial[gl_LocalInvocationIndex + stride];
+            barrier();
+        }
+        if (gl_LocalInvocationIndex == 0) coefficients[k] = vec4(partial[0].rgb * normalization * bandScale[k], 0.0);
+        barrier();
+    }
+}
@@ -21,58 +21,7 @@ uniform sampler2D brdfLUT;
 uniform vec3 camPos;
 uniform float far_plane;
 
-#define MAX_LIGHTS 5 // IDKKKK!!!!!
-
-layout (binding = 8) uniform samplerCube cubeShadowMaps[MAX_LIGHTS];
-layout (binding = 8 + 5) uniform sampler2D planeShadowMaps[MAX_LIGHTS];
-
-struct DirLight {
-    vec4 direction;
-    vec4 color;
-    vec4 position;
-    mat4x4 lightSpaceMatrix;
-};
-
-struct PointLight {
-    vec4 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-    float pointlessfloat;
-
-    vec4 color;
-};
-
-struct SpotLight {
-    vec4 position;
-    vec4 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    float pointlessfloat;
-    float pointlessfloat2;
-    float pointlessfloat3;
-
-    vec4 color;
-    mat4x4 lightSpaceMatrix;
-};
-
-layout (std430, binding = 3) buffer DirLightBuffer {
-    DirLight dirLights[];
-};
-
-layout (std430, binding = 4) buffer PointLightBuffer {
-    PointLight pointLights[];
-};
-
-layout (std430, binding = 5) buffer SpotLightBuffer {
-    SpotLight spotLights[];
-};
+#include "lights.glsl"
 
 uniform bool shadows;
 
@@ -191,7 +140,9 @@ float PlaneShadowCalculation(mat4x4 lightSpaceMatrix, vec3 lightPos, int lightID
 // technique somewhere later in the normal mapping tutorial.
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+    // cooked normal maps are BC5 (two channels), z is rebuilt from the unit length
+    vec2 tangentNormalXY = texture(normalMap, TexCoords).xy * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(tangentNormalXY, sqrt(max(1.0 - dot(tangentNormalXY, tangentNormalXY), 0.0)));
 
     vec3 Q1 = dFdx(WorldPos);
     vec3 Q2 = dFdy(WorldPos);
@@ -12,11 +12,15 @@ uniform mat4 view;
 uniform mat4 model;
 uniform mat3 normalMatrix;
 
+#include "vertex_format.glsl"
+
 void main()
 {
+    vec3 position = decodePosition(aPos);
+    vec3 normal = decodeNormal(aNormal);
     TexCoords = aTexCoords;
-    WorldPos = vec3(model * vec4(aPos, 1.0));
-    Normal = transpose(inverse(mat3(model))) * aNormal;
+    WorldPos = vec3(model * vec4(position, 1.0));
+    Normal = transpose(inverse(mat3(model))) * normal;
 
     gl_Position = projection * view * vec4(WorldPos, 1.0);
 }
\ No newline at end of file
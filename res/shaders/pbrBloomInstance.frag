@@ -17,65 +17,35 @@ uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
 
+// permutations, see PBRSystem::SelectVariants
+#ifndef SHADOWS
+#define SHADOWS 1
+#endif
+// diffuse irradiance as 9 SH coefficients projected from the environment, replaces the irradiance map lookup
+#ifndef SH_IRRADIANCE
+#define SH_IRRADIANCE 0
+#endif
+// most lights of one kind the variant shades, a constant trip count the compiler can unroll or drop, -1 for any
+#ifndef LIGHT_COUNT_CLASS
+#define LIGHT_COUNT_CLASS -1
+#endif
+#if LIGHT_COUNT_CLASS < 0
+#define LIGHT_LOOP_COUNT(count) (count)
+#else
+#define LIGHT_LOOP_COUNT(count) min(count, LIGHT_COUNT_CLASS)
+#endif
+
+#if SH_IRRADIANCE
+layout (std140, binding = 0) uniform IrradianceSH {
+    vec4 irradianceSH[9];
+};
+#endif
+
 //Lighting and shadows
 uniform vec3 camPos;
 uniform float far_plane;
 
-#define MAX_LIGHTS 5 // IDKKKK!!!!!
-
-layout (binding = 8) uniform samplerCube cubeShadowMaps[MAX_LIGHTS];
-layout (binding = 8 + 5) uniform sampler2D planeShadowMaps[MAX_LIGHTS];
-
-struct DirLight {
-    vec4 direction;
-    vec4 color;
-    vec4 position;
-    mat4x4 lightSpaceMatrix;
-};
-
-struct PointLight {
-    vec4 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-    float pointlessfloat;
-
-    vec4 color;
-};
-
-struct SpotLight {
-    vec4 position;
-    vec4 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    float pointlessfloat;
-    float pointlessfloat2;
-    float pointlessfloat3;
-
-    vec4 color;
-    mat4x4 lightSpaceMatrix;
-};
-
-layout (std430, binding = 3) buffer DirLightBuffer {
-    DirLight dirLights[];
-};
-
-layout (std430, binding = 4) buffer PointLightBuffer {
-    PointLight pointLights[];
-};
-
-layout (std430, binding = 5) buffer SpotLightBuffer {
-    SpotLight spotLights[];
-};
-
-uniform bool shadows;
-
+#include "lights.glsl"
 
 
 const float PI = 3.14159265359;
@@ -191,7 +161,9 @@ float PlaneShadowCalculation(mat4x4 lightSpaceMatrix, vec3 lightPos, int lightID
 // technique somewhere later in the normal mapping tutorial.
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(normalMap, TexCoords).xyz * 2.0 - 1.0;
+    // cooked normal maps are BC5 (two channels), z is rebuilt from the unit length
+    vec2 tangentNormalXY = texture(normalMap, TexCoords).xy * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(tangentNormalXY, sqrt(max(1.0 - dot(tangentNormalXY, tangentNormalXY), 0.0)));
 
     vec3 Q1 = dFdx(WorldPos);
     vec3 Q2 = dFdy(WorldPos);
@@ -286,9 +258,9 @@ vec3 CalcDirLight(DirLight light, vec3 N, vec3 V, float roughness, float metalli
     float NdotL = max(dot(N, L), 0.0);
 
     float shadow = 1;
-    if (shadows) {
-        shadow = (1.0 - PlaneShadowCalculation(light.lightSpaceMatrix, light.position.xyz, lightIndex));
-    }
+#if SHADOWS
+    shadow = (1.0 - PlaneShadowCalculation(light.lightSpaceMatrix, light.position.xyz, lightIndex));
+#endif
 
 
     // add to outgoing radiance Lo
@@ -332,9 +304,9 @@ vec3 CalcPointLight(PointLight light, vec3 N, vec3 V, float roughness, float met
 
 
     float shadow = 1;
-    if (shadows) {
-        shadow = (1.0 - CubeShadowCalculation(WorldPos, light.position.xyz, lightIndex));
-    }
+#if SHADOWS
+    shadow = (1.0 - CubeShadowCalculation(WorldPos, light.position.xyz, lightIndex));
+#endif
 
     // add to outgoing radiance Lo
     return (kD * albedo / PI + specular) * radiance * NdotL * shadow; // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
@@ -380,15 +352,30 @@ vec3 CalcSpotLight(SpotLight light, vec3 N, vec3 V, float roughness, float metal
     float NdotL = max(dot(N, L), 0.0);
 
     float shadow = 1;
-    if (shadows) {
-        shadow = (1.0 - PlaneShadowCalculation(light.lightSpaceMatrix, light.position.xyz, lightIndex));
-    }
+#if SHADOWS
+    shadow = (1.0 - PlaneShadowCalculation(light.lightSpaceMatrix, light.position.xyz, lightIndex));
+#endif
 
     // add to outgoing radiance Lo
     return (kD * albedo / PI + specular) * radiance * NdotL * shadow; // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
 }
 
 
+#if SH_IRRADIANCE
+vec3 EvaluateIrradianceSH(vec3 n) {
+    vec3 irradiance = irradianceSH[0].rgb * 0.282095
+                    + irradianceSH[1].rgb * (0.488603 * n.y)
+                    + irradianceSH[2].rgb * (0.488603 * n.z)
+                    + irradianceSH[3].rgb * (0.488603 * n.x)
+                    + irradianceSH[4].rgb * (1.092548 * n.x * n.y)
+                    + irradianceSH[5].rgb * (1.092548 * n.y * n.z)
+                    + irradianceSH[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+                    + irradianceSH[7].rgb * (1.092548 * n.x * n.z)
+                    + irradianceSH[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+    return max(irradiance, vec3(0.0));
+}
+#endif
+
 void main()
 {
     // material properties
@@ -412,13 +399,13 @@ void main()
     int planeLightIndex = 0;
     int cubeLightIndex = 0;
 
-    for (int i = 0; i < dirLights.length(); ++i) {
+    for (int i = 0; i < LIGHT_LOOP_COUNT(dirLights.length()); ++i) {
         Lo += CalcDirLight(dirLights[i], N, V, roughness, metallic, albedo, F0, planeLightIndex++);
     }
-    for (int i = 0; i < pointLights.length(); ++i) {
+    for (int i = 0; i < LIGHT_LOOP_COUNT(pointLights.length()); ++i) {
         Lo += CalcPointLight(pointLights[i], N, V, roughness, metallic, albedo, F0, cubeLightIndex++);
     }
-    for (int i = 0; i < spotLights.length(); ++i) {
+    for (int i = 0; i < LIGHT_LOOP_COUNT(spotLights.length()); ++i) {
 
         Lo += CalcSpotLight(spotLights[i], N, V, roughness, metallic, albedo, F0, planeLightIndex++);
     }
@@ -430,7 +417,11 @@ void main()
     vec3 kD = 1.0 - kS;
     kD *= 1.0 - metallic;
 
+#if SH_IRRADIANCE
+    vec3 irradiance = EvaluateIrradianceSH(N);
+#else
     vec3 irradiance = texture(irradianceMap, N).rgb;
+#endif
     vec3 diffuse = irradiance * albedo;
 
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
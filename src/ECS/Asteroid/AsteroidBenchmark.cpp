@@ -0,0 +1,246 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "AsteroidBenchmark.h"
+#include "AsteroidsSystem.h"
+#include "modelLoading/AssetRegistry.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace {
+    std::string glString(GLenum name) {
+        const auto *value = reinterpret_cast<const char *>(glGetString(name));
+        return value != nullptr ? value : "";
+    }
+
+    std::string deviceName() {
+        return glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+    }
+}
+
+WorkgroupSizes AsteroidBenchmark::run(AsteroidsSystem &system) {
+    lastResults.clear();
+    lastPipelineResults.clear();
+    GLint maxInvocations = 0;
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxInvocations);
+    GLint maxGroupInvocations = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxGroupInvocations);
+    maxInvocations = std::min(maxInvocations, maxGroupInvocations);
+
+    // every kernel and size is compiled once per run, the ProgramCache makes the next run cheap
+    std::vector<AsteroidsSystem::Kernel> kernels = system.Kernels();
+    std::map<std::pair<std::string, int>, std::unique_ptr<ComputeShader>> programs;
+    auto program = [&](const AsteroidsSystem::Kernel &kernel, int localSize) -> ComputeShader & {
+        std::unique_ptr<ComputeShader> &shader = programs[{kernel.name, localSize}];
+        if (shader == nullptr) {
+            shader = std::make_unique<ComputeShader>(kernel.path);
+            shader->defines = kernel.defines;
+            shader->setLayout(localSize, 1, 1);
+            shader->init();
+            system.SetupKernel(kernel, *shader);
+        }
+        return *shader;
+    };
+
+    // gravity is what has to scale to 100k+ asteroids, and its kernels dispatch nothing while it's off
+    bool gravity = system.gravity;
+    system.gravity = true;
+    AsteroidBuffers buffers;
+    GLuint query;
+    glGenQueries(1, &query);
+    for (int count: counts) {
+        std::vector<AsteroidData> data = system.Generate(count);
+        buffers.create(data, count, system.hashTableSize, {});
+        buffers.bind();
+
+        // a regular frame rebuilds the grid, so the kernels later in the pipeline see a consistent one
+        auto regularFrame = [&]() {
+            for (const AsteroidsSystem::Kernel &kernel: kernels)
+                system.RunKernel(kernel, *kernel.shader, count, system.WorkgroupSize(kernel), 0.0f);
+        };
+        regularFrame();
+
+        for (const AsteroidsSystem::Kernel &kernel: kernels) {
+            for (int localSize: localSizes) {
+                if (localSize > maxInvocations) continue;
+                ComputeShader &shader = program(kernel, localSize);
+                // nothing swaps current and next here, so what gravity and collision write only ever lands in the
+                // next state and every repeat sees the same asteroids. Collision reading its own velocity back
+                // from there changes values, not work.
+                system.RunKernel(kernel, shader, count, localSize, 0.0f);
+                glBeginQuery(GL_TIME_ELAPSED, query);
+                for (int repeat = 0; repeat < repeats; ++repeat)
+                    system.RunKernel(kernel, shader, count, localSize, 0.0f);
+                glEndQuery(GL_TIME_ELAPSED);
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+                double milliseconds = static_cast<double>(elapsed) / 1e6 / repeats;
+                lastResults.push_back({kernel.name, count, localSize, milliseconds});
+                spdlog::info("Asteroid kernel {} N={} local size {}: {:.4f} ms", kernel.name, count, localSize,
+                             milliseconds);
+            }
+            // repeated grid kernels count the same asteroids several times, start the next kernel from a clean grid
+            buffers.clearCounts();
+            regularFrame();
+        }
+    }
+
+    for (int count: pipelineCounts) {
+        std::vector<AsteroidData> data = system.Generate(count);
+        buffers.create(data, count, system.hashTableSize, {});
+        buffers.bind();
+        lastPipelineResults.push_back(measurePipeline(system, count, query));
+        const PipelineResult &result = lastPipelineResults.back();
+        if (count >= gravityBudgetCount && result.gravityMilliseconds > gravityBudgetMilliseconds)
+            spdlog::warn("Asteroid gravity N={} takes {:.3f} ms, over its {:.1f} ms budget", count,
+                         result.gravityMilliseconds, gravityBudgetMilliseconds);
+    }
+    system.gravity = gravity;
+    glDeleteQueries(1, &query);
+    buffers.release();
+    for (auto &[key, shader]: programs) glDeleteProgram(shader->ID);
+    system.BindBuffers();
+
+    WorkgroupSizes best = pickBest();
+    for (const auto &[kernel, localSize]: best) spdlog::info("Asteroid kernel {} is fastest with {}", kernel, localSize);
+    return best;
+}
+
+AsteroidBenchmark::PipelineResult AsteroidBenchmark::measurePipeline(AsteroidsSystem &system, int count, GLuint query) {
+    PipelineResult result{count, 0, 0.0, 0.0, 0, 0, 0, 0, 0};
+    std::vector<AsteroidsSystem::Kernel> kernels = system.Kernels();
+    // without a swap the current state never changes, so the gravity kernels alone redo exactly the frame's gravity
+    // work
+    auto time = [&](bool gravityOnly) {
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            for (const AsteroidsSystem::Kernel &kernel: kernels) {
+                if (gravityOnly && strncmp(kernel.name, "gravity", 7) != 0) continue;
+                system.RunKernel(kernel, *kernel.shader, count, system.WorkgroupSize(kernel), 0.0f);
+            }
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        return static_cast<double>(elapsed) / 1e6 / repeats;
+    };
+    // an untimed frame first, it builds the grid and the tree the timed ones start from
+    for (const AsteroidsSystem::Kernel &kernel: kernels)
+        result.dispatches += system.RunKernel(kernel, *kernel.shader, count, system.WorkgroupSize(kernel), 0.0f);
+    result.milliseconds = time(false);
+    result.gravityMilliseconds = time(true);
+
+    // the grid is still built, one more collision pass with the counters compiled in
+    for (const AsteroidsSystem::Kernel &kernel: kernels) {
+        if (std::string(kernel.name) != "collision") continue;
+        ComputeShader shader(kernel.path);
+        shader.defines = kernel.defines;
+        shader.defines["COLLISION_STATS"] = "1";
+        shader.setLayout(system.WorkgroupSize(kernel), 1, 1);
+        shader.init();
+        system.SetupKernel(kernel, shader);
+
+        GLuint statsBuffer;
+        GLuint zero[5] = {};
+        glGenBuffers(1, &statsBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), zero, GL_DYNAMIC_READ);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, statsBuffer);
+        system.RunKernel(kernel, shader, count, system.WorkgroupSize(kernel), 0.0f);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        GLuint stats[5] = {};
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(stats), stats);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glDeleteBuffers(1, &statsBuffer);
+        glDeleteProgram(shader.ID);
+        result.neighbourReads = stats[0];
+        result.tileReads = stats[1];
+        result.foreignReads = stats[2];
+        result.duplicateBuckets = stats[3];
+        result.longestChain = stats[4];
+    }
+
+    spdlog::info("Asteroid pipeline N={}: {:.4f} ms in {} dispatches, {} neighbour reads ({} from shared memory), "
+                 "{:.2f} MB global instead of {:.2f} MB", count, result.milliseconds, result.dispatches,
+                 result.neighbourReads, result.tileReads, result.globalBytes() / 1e6, result.unfusedBytes() / 1e6);
+    spdlog::info("Asteroid gravity N={}: {:.4f} ms of the frame's {:.4f} ms", count, result.gravityMilliseconds,
+                 result.milliseconds);
+    spdlog::info("Asteroid hash N={}: {} reads of foreign cells, {} duplicate buckets skipped, longest chain {}",
+                 count, result.foreignReads, result.duplicateBuckets, result.longestChain);
+    return result;
+}
+
+WorkgroupSizes AsteroidBenchmark::pickBest() const {
+    // fastest time per kernel and count
+    std::map<std::pair<std::string, int>, double> fastest;
+    for (const Result &result: lastResults) {
+        auto [it, inserted] = fastest.try_emplace({result.kernel, result.count}, result.milliseconds);
+        if (!inserted) it->second = std::min(it->second, result.milliseconds);
+    }
+    // relative to the fastest, so small counts weigh as much as large ones
+    std::map<std::pair<std::string, int>, double> score;
+    std::map<std::pair<std::string, int>, int> measured;
+    for (const Result &result: lastResults) {
+        double best = fastest[{result.kernel, result.count}];
+        score[{result.kernel, result.localSize}] += best > 0.0 ? result.milliseconds / best : 1.0;
+        measured[{result.kernel, result.localSize}]++;
+    }
+
+    WorkgroupSizes sizes;
+    std::map<std::string, double> bestScore;
+    for (const auto &[key, value]: score) {
+        const auto &[kernel, localSize] = key;
+        // a kernel that only ran with one size has nothing to choose from
+        bool tunable = std::any_of(lastResults.begin(), lastResults.end(), [&](const Result &result) {
+            return result.kernel == kernel && result.localSize != localSize;
+        });
+        if (!tunable || measured[key] != static_cast<int>(counts.size())) continue;
+        auto found = bestScore.find(kernel);
+        if (found == bestScore.end() || value < found->second) {
+            bestScore[kernel] = value;
+            sizes[kernel] = localSize;
+        }
+    }
+    return sizes;
+}
+
+std::string AsteroidBenchmark::devicePath() {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(AssetRegistry::hash(deviceName())));
+    return std::string(directory) + name + ".txt";
+}
+
+WorkgroupSizes AsteroidBenchmark::load() {
+    WorkgroupSizes sizes;
+    std::ifstream in(devicePath());
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string kernel;
+        int localSize = 0;
+        if (fields >> kernel >> localSize && localSize > 0) sizes[kernel] = localSize;
+    }
+    if (!sizes.empty()) spdlog::info("Loaded tuned workgroup sizes from " + devicePath());
+    return sizes;
+}
+
+bool AsteroidBenchmark::save(const WorkgroupSizes &sizes) {
+    if (sizes.empty()) return false;
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::ofstream out(devicePath(), std::ios::trunc);
+    if (!out) {
+        spdlog::warn("Failed to write workgroup sizes " + devicePath());
+        return false;
+    }
+    out << "# " << deviceName() << "\n";
+    for (const auto &[kernel, localSize]: sizes) out << kernel << " " << localSize << "\n";
+    return true;
+}
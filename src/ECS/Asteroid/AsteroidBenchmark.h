@@ -0,0 +1,95 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_ASTEROIDBENCHMARK_H
+#define REASONABLEGL_ASTEROIDBENCHMARK_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "glad/glad.h"
+
+class AsteroidsSystem;
+
+// kernel name -> local_size_x
+using WorkgroupSizes = std::map<std::string, int>;
+
+// Runs every asteroid kernel on its own over a sweep of asteroid counts and workgroup sizes, timed with
+// GL_TIME_ELAPSED queries. The fastest size per kernel is stored per device (vendor, renderer and driver version),
+// AsteroidsSystem::Init compiles its kernels with it.
+class AsteroidBenchmark {
+public:
+    static constexpr const char *directory = "res/cache/workgroups/";
+
+    struct Result {
+        std::string kernel;
+        int count;
+        int localSize;
+        double milliseconds;
+    };
+
+    // A whole frame of the pipeline with the current sizes and gravity on. Neighbour reads come from a COLLISION_STATS
+    // build of the collision kernel, each one costs 16 bytes of global memory unless it came from the shared tile.
+    struct PipelineResult {
+        int count;
+        int dispatches;
+        double milliseconds;
+        // the gravity kernels' share of milliseconds, timed on their own
+        double gravityMilliseconds;
+        uint64_t neighbourReads;
+        uint64_t tileReads;
+        // chain statistics of the hash: reads of non-neighbour cells sharing a bucket, neighbour cells skipped
+        // because their bucket was already scanned, and the longest bucket any asteroid walked
+        uint64_t foreignReads;
+        uint64_t duplicateBuckets;
+        uint32_t longestChain;
+
+        // what the same reads cost before, an 8 byte cell entry to check the hash and the 96 byte AoS asteroid of then
+        uint64_t unfusedBytes() const { return neighbourReads * 104; }
+
+        uint64_t globalBytes() const { return (neighbourReads - tileReads) * 16; }
+    };
+
+    std::vector<int> counts = {1000, 3000, 10000, 30000};
+    // the whole pipeline is measured at these, its buffers sized for each count whatever the system's capacity
+    std::vector<int> pipelineCounts = {1000, 3000, 10000, 30000, 100000, 1000000};
+    std::vector<int> localSizes = {1, 32, 64, 128, 256, 512, 1024};
+    // timed dispatches per configuration, after one untimed warm-up
+    int repeats = 5;
+    // what the gravity kernels may take of a frame at gravityBudgetCount asteroids, run() warns past it
+    double gravityBudgetMilliseconds = 4.0;
+    int gravityBudgetCount = 100000;
+
+    // Blocks the GL thread for the whole sweep, which runs with gravity on so its kernels are tuned as well. The
+    // system's own buffers are bound again afterwards.
+    WorkgroupSizes run(AsteroidsSystem &system);
+
+    // every timing of the last run
+    const std::vector<Result> &results() const { return lastResults; }
+
+    const std::vector<PipelineResult> &pipelineResults() const { return lastPipelineResults; }
+
+    // the tuned sizes for this device, empty if it was never benchmarked
+    static WorkgroupSizes load();
+
+    static bool save(const WorkgroupSizes &sizes);
+
+private:
+    std::vector<Result> lastResults;
+    std::vector<PipelineResult> lastPipelineResults;
+
+    // Times one frame and its gravity stage and reads the collision statistics, the buffers of count asteroids are
+    // bound.
+    PipelineResult measurePipeline(AsteroidsSystem &system, int count, GLuint query);
+
+    static std::string devicePath();
+
+    // per kernel the size with the lowest summed time relative to the best at every count
+    WorkgroupSizes pickBest() const;
+};
+
+
+#endif //REASONABLEGL_ASTEROIDBENCHMARK_H
@@ -0,0 +1,318 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "AsteroidCpuSimulation.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define REASONABLEGL_ASTEROID_SSE
+#endif
+
+namespace {
+    glm::ivec3 cellCoord(glm::vec3 position, float radius) {
+        return glm::ivec3(glm::floor(position / radius));
+    }
+
+    const glm::ivec3 neighbourOffsets[27] = {
+            {-1, -1, -1}, {-1, -1, 0}, {-1, -1, 1}, {-1, 0, -1}, {-1, 0, 0}, {-1, 0, 1}, {-1, 1, -1}, {-1, 1, 0},
+            {-1, 1, 1}, {0, -1, -1}, {0, -1, 0}, {0, -1, 1}, {0, 0, -1}, {0, 0, 0}, {0, 0, 1}, {0, 1, -1},
+            {0, 1, 0}, {0, 1, 1}, {1, -1, -1}, {1, -1, 0}, {1, -1, 1}, {1, 0, -1}, {1, 0, 0}, {1, 0, 1},
+            {1, 1, -1}, {1, 1, 0}, {1, 1, 1}};
+
+    // MortonCode of asteroidGravitySort.glsl
+    uint32_t spreadBits(uint32_t x) {
+        x = (x | (x << 16)) & 0x030000FFu;
+        x = (x | (x << 8)) & 0x0300F00Fu;
+        x = (x | (x << 4)) & 0x030C30C3u;
+        x = (x | (x << 2)) & 0x09249249u;
+        return x;
+    }
+
+    uint32_t mortonCode(glm::vec3 position, float extent) {
+        auto cell = [extent](float x) {
+            return static_cast<uint32_t>(glm::clamp((x + extent) / (2.0f * extent) * 1024.0f, 0.0f, 1023.0f));
+        };
+        return spreadBits(cell(position.x)) | (spreadBits(cell(position.y)) << 1) |
+               (spreadBits(cell(position.z)) << 2);
+    }
+}
+
+uint32_t AsteroidCpuSimulation::hashCell(glm::ivec3 cell, uint32_t tableSize) {
+    uint32_t hash = (static_cast<uint32_t>(cell.x) * 73856093u) ^ (static_cast<uint32_t>(cell.y) * 19349663u) ^
+                    (static_cast<uint32_t>(cell.z) * 83492791u);
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    return hash & (tableSize - 1u);
+}
+
+void AsteroidCpuSimulation::step(std::vector<AsteroidData> &asteroids, float deltaTime) {
+    if (asteroids.empty()) return;
+    auto start = std::chrono::steady_clock::now();
+
+    buildGrid(asteroids);
+    size_t count = asteroids.size();
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+    if (gravity.enabled) {
+        buildTree(asteroids);
+        pool.parallelFor(chunks, [&](size_t chunk) {
+            size_t end = std::min(count, (chunk + 1) * chunkSize);
+            for (size_t i = chunk * chunkSize; i < end; ++i) {
+                glm::vec3 pull = attraction(glm::vec3(asteroids[i].position), static_cast<uint32_t>(i));
+                asteroids[i].velocity += glm::vec4(pull * deltaTime, 0.0f);
+            }
+        });
+    }
+    // every slot only writes its own asteroid and reads the body snapshot, chunks don't need to synchronize
+    pool.parallelFor(chunks, [&](size_t chunk) {
+        size_t end = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t slot = chunk * chunkSize; slot < end; ++slot) collide(asteroids, slot, deltaTime);
+    });
+
+    // survivors keep their order, like the survivor slots of the GPU's aliveScan
+    survivorSources.clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (dead[i]) continue;
+        asteroids[survivorSources.size()] = asteroids[i];
+        survivorSources.push_back(static_cast<uint32_t>(i));
+    }
+    asteroids.resize(survivorSources.size());
+
+    stepMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void AsteroidCpuSimulation::buildGrid(const std::vector<AsteroidData> &asteroids) {
+    size_t count = asteroids.size();
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+
+    hashes.resize(count);
+    dead.resize(count);
+    pool.parallelFor(chunks, [&](size_t chunk) {
+        size_t end = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i) {
+            glm::vec3 position(asteroids[i].position);
+            hashes[i] = hashCell(cellCoord(position, gridRadius), tableSize(count));
+            dead[i] = despawnRadius > 0.0f && glm::length(position) > despawnRadius;
+        }
+    });
+
+    // counting sort, stable so the result doesn't depend on the thread count
+    cellStart.assign(tableSize(count) + 1, 0);
+    for (uint32_t hash: hashes) cellStart[hash + 1]++;
+    for (size_t cell = 0; cell + 1 < cellStart.size(); ++cell) cellStart[cell + 1] += cellStart[cell];
+    std::vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+    keys.resize(count);
+    for (uint32_t i = 0; i < count; ++i) keys[cursor[hashes[i]]++] = i;
+
+    chainStats = ChainStats{tableSize(count)};
+    for (size_t bucket = 0; bucket + 1 < cellStart.size(); ++bucket) {
+        uint32_t begin = cellStart[bucket], end = cellStart[bucket + 1];
+        if (begin == end) continue;
+        chainStats.occupiedBuckets++;
+        chainStats.longestChain = std::max(chainStats.longestChain, end - begin);
+        glm::ivec3 first = cellCoord(glm::vec3(asteroids[keys[begin]].position), gridRadius);
+        for (uint32_t slot = begin + 1; slot < end; ++slot) {
+            if (cellCoord(glm::vec3(asteroids[keys[slot]].position), gridRadius) != first) {
+                chainStats.sharedBuckets++;
+                break;
+            }
+        }
+    }
+
+    bodyX.resize(count);
+    bodyY.resize(count);
+    bodyZ.resize(count);
+    bodyRadius.resize(count);
+    pool.parallelFor(chunks, [&](size_t chunk) {
+        size_t end = std::min(count, (chunk + 1) * chunkSize);
+        for (size_t slot = chunk * chunkSize; slot < end; ++slot) {
+            const AsteroidData &asteroid = asteroids[keys[slot]];
+            bodyX[slot] = asteroid.position.x;
+            bodyY[slot] = asteroid.position.y;
+            bodyZ[slot] = asteroid.position.z;
+            bodyRadius[slot] = collisionRadius * asteroid.position.w / 2;
+        }
+    });
+}
+
+void AsteroidCpuSimulation::buildTree(const std::vector<AsteroidData> &asteroids) {
+    const int count = static_cast<int>(asteroids.size());
+    gravityKeys.resize(count);
+    for (int i = 0; i < count; ++i)
+        gravityKeys[i] = {mortonCode(glm::vec3(asteroids[i].position), gravity.extent), static_cast<uint32_t>(i)};
+    // the GPU's radix sort is stable over the indices, which is the same as sorting by both
+    std::sort(gravityKeys.begin(), gravityKeys.end());
+
+    const uint32_t firstLeaf = static_cast<uint32_t>(count - 1);
+    gravityNodes.assign(2 * count - 1, GravityNode());
+    for (int i = 0; i < count; ++i) {
+        const AsteroidData &asteroid = asteroids[gravityKeys[i].second];
+        glm::vec3 position(asteroid.position);
+        float scale = asteroid.position.w;
+        GravityNode &leaf = gravityNodes[firstLeaf + i];
+        leaf.centerOfMass = glm::vec4(position, gravity.asteroidDensity * scale * scale * scale);
+        leaf.lower = position;
+        leaf.upper = position;
+    }
+
+    // Delta and BuildInternal of asteroidGravityBuild.glsl
+    auto delta = [&](int i, int j) {
+        if (j < 0 || j >= count) return -1;
+        uint32_t a = gravityKeys[i].first, b = gravityKeys[j].first;
+        if (a == b) return 32 + std::countl_zero(static_cast<uint32_t>(i) ^ static_cast<uint32_t>(j));
+        return std::countl_zero(a ^ b);
+    };
+    size_t internal = count - 1;
+    pool.parallelFor((internal + chunkSize - 1) / chunkSize, [&](size_t chunk) {
+        int end = static_cast<int>(std::min(internal, (chunk + 1) * chunkSize));
+        for (int i = static_cast<int>(chunk * chunkSize); i < end; ++i) {
+            int direction = delta(i, i + 1) - delta(i, i - 1) >= 0 ? 1 : -1;
+            int deltaMin = delta(i, i - direction);
+            int spanMax = 2;
+            while (delta(i, i + spanMax * direction) > deltaMin) spanMax *= 2;
+            int span = 0;
+            for (int step = spanMax / 2; step >= 1; step /= 2)
+                if (delta(i, i + (span + step) * direction) > deltaMin) span += step;
+            int j = i + span * direction;
+
+            int deltaNode = delta(i, j);
+            int split = 0;
+            for (int divisor = 2;; divisor *= 2) {
+                int step = (span + divisor - 1) / divisor;
+                if (delta(i, i + (split + step) * direction) > deltaNode) split += step;
+                if (step <= 1) break;
+            }
+            int gamma = i + split * direction + std::min(direction, 0);
+            gravityNodes[i].left = std::min(i, j) == gamma ? firstLeaf + gamma : gamma;
+            gravityNodes[i].right = std::max(i, j) == gamma + 1 ? firstLeaf + gamma + 1 : gamma + 1;
+        }
+    });
+    if (count > 1) sumNode(0);
+}
+
+void AsteroidCpuSimulation::sumNode(uint32_t node) {
+    GravityNode &parent = gravityNodes[node];
+    const uint32_t firstLeaf = static_cast<uint32_t>(gravityKeys.size() - 1);
+    for (uint32_t child: {parent.left, parent.right})
+        if (child < firstLeaf) sumNode(child);
+    const GravityNode &left = gravityNodes[parent.left];
+    const GravityNode &right = gravityNodes[parent.right];
+    float mass = left.centerOfMass.w + right.centerOfMass.w;
+    glm::vec3 center = mass > 0.0f
+                       ? (glm::vec3(left.centerOfMass) * left.centerOfMass.w +
+                          glm::vec3(right.centerOfMass) * right.centerOfMass.w) / mass
+                       : (glm::vec3(left.centerOfMass) + glm::vec3(right.centerOfMass)) * 0.5f;
+    parent.centerOfMass = glm::vec4(center, mass);
+    parent.lower = glm::min(left.lower, right.lower);
+    parent.upper = glm::max(left.upper, right.upper);
+}
+
+glm::vec3 AsteroidCpuSimulation::attraction(glm::vec3 position, uint32_t self) const {
+    const float softeningSquared = gravity.softening * gravity.softening;
+    auto pull = [&](glm::vec3 offset, float mass) {
+        float distanceSquared = glm::dot(offset, offset) + softeningSquared;
+        return offset * (gravity.gravitationalConstant * mass / (distanceSquared * std::sqrt(distanceSquared)));
+    };
+
+    glm::vec3 acceleration = pull(-position, gravity.centralMass);
+    const uint32_t firstLeaf = static_cast<uint32_t>(gravityKeys.size() - 1);
+    constexpr int stackSize = 64;
+    uint32_t stack[stackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        uint32_t node = stack[--top];
+        const GravityNode &data = gravityNodes[node];
+        glm::vec3 offset = glm::vec3(data.centerOfMass) - position;
+        if (node >= firstLeaf) {
+            if (gravityKeys[node - firstLeaf].second != self) acceleration += pull(offset, data.centerOfMass.w);
+            continue;
+        }
+        glm::vec3 size = data.upper - data.lower;
+        bool inside = position.x >= data.lower.x && position.y >= data.lower.y && position.z >= data.lower.z &&
+                      position.x <= data.upper.x && position.y <= data.upper.y && position.z <= data.upper.z;
+        bool far = std::max(size.x, std::max(size.y, size.z)) < gravity.openingAngle * glm::length(offset);
+        if ((!inside && far) || top + 2 > stackSize) {
+            acceleration += pull(offset, data.centerOfMass.w);
+            continue;
+        }
+        stack[top++] = data.right;
+        stack[top++] = data.left;
+    }
+    return acceleration;
+}
+
+void AsteroidCpuSimulation::accumulate(size_t self, uint32_t begin, uint32_t end, glm::vec3 &sum,
+                                       int &collisions) const {
+    const float x = bodyX[self], y = bodyY[self], z = bodyZ[self], radius = bodyRadius[self];
+    uint32_t other = begin;
+#ifdef REASONABLEGL_ASTEROID_SSE
+    const __m128 selfX = _mm_set1_ps(x), selfY = _mm_set1_ps(y), selfZ = _mm_set1_ps(z);
+    const __m128 selfRadius = _mm_set1_ps(radius);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 sumX = zero, sumY = zero, sumZ = zero;
+    for (; other + 4 <= end; other += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&bodyX[other]), selfX);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&bodyY[other]), selfY);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&bodyZ[other]), selfZ);
+        __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        __m128 reach = _mm_add_ps(_mm_loadu_ps(&bodyRadius[other]), selfRadius);
+        // the asteroid itself is at distance 0
+        __m128 hit = _mm_and_ps(_mm_cmpneq_ps(dist, zero), _mm_cmple_ps(dist, reach));
+        int mask = _mm_movemask_ps(hit);
+        if (mask == 0) continue;
+        // lanes at distance 0 divide by zero, the mask clears them
+        __m128 factor = _mm_and_ps(_mm_div_ps(_mm_sub_ps(reach, dist), dist), hit);
+        sumX = _mm_add_ps(sumX, _mm_mul_ps(dx, factor));
+        sumY = _mm_add_ps(sumY, _mm_mul_ps(dy, factor));
+        sumZ = _mm_add_ps(sumZ, _mm_mul_ps(dz, factor));
+        collisions += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+    }
+    alignas(16) float lanes[3][4];
+    _mm_store_ps(lanes[0], sumX);
+    _mm_store_ps(lanes[1], sumY);
+    _mm_store_ps(lanes[2], sumZ);
+    for (int lane = 0; lane < 4; ++lane) sum += glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+#endif
+    for (; other < end; ++other) {
+        glm::vec3 offset(bodyX[other] - x, bodyY[other] - y, bodyZ[other] - z);
+        float dist = glm::length(offset);
+        float reach = bodyRadius[other] + radius;
+        if (dist != 0 && dist <= reach) {
+            sum += offset / dist * (reach - dist);
+            collisions++;
+        }
+    }
+}
+
+void AsteroidCpuSimulation::collide(std::vector<AsteroidData> &asteroids, size_t slot, float deltaTime) {
+    // still a neighbour for the others this step, but not simulated any further
+    if (dead[keys[slot]]) return;
+    uint32_t cells = tableSize(asteroids.size());
+    glm::ivec3 cell = cellCoord(glm::vec3(bodyX[slot], bodyY[slot], bodyZ[slot]), gridRadius);
+
+    glm::vec3 sumOfCollisions(0.0f);
+    int amountOfCollisions = 0;
+    uint32_t scanned[27];
+    for (int neighbour = 0; neighbour < 27; ++neighbour) {
+        uint32_t hash = hashCell(cell + neighbourOffsets[neighbour], cells);
+        scanned[neighbour] = hash;
+        // two neighbour cells sharing a bucket would count everything in it twice
+        if (std::find(scanned, scanned + neighbour, hash) != scanned + neighbour) continue;
+        accumulate(slot, cellStart[hash], cellStart[hash + 1], sumOfCollisions, amountOfCollisions);
+    }
+
+    AsteroidData &asteroid = asteroids[keys[slot]];
+    glm::vec3 separation(0.0f);
+    if (amountOfCollisions != 0) separation = -sumOfCollisions / static_cast<float>(amountOfCollisions);
+    if (separation != glm::vec3(0.0f)) {
+        asteroid.position += glm::vec4(separation, 0.0f);
+        asteroid.velocity = glm::vec4(glm::normalize(separation) * asteroid.position.w, asteroid.velocity.w);
+    }
+    asteroid.position += glm::vec4(glm::vec3(asteroid.velocity) * deltaTime, 0.0f);
+}
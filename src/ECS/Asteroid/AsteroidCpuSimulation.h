@@ -0,0 +1,120 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_ASTEROIDCPUSIMULATION_H
+#define REASONABLEGL_ASTEROIDCPUSIMULATION_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AsteroidData.h"
+#include "modelLoading/ThreadPool.h"
+
+// The asteroid compute pipeline on the CPU, over the same AsteroidData. Same grid hash as asteroidGridCreation.glsl
+// and the same response as asteroidCollision.glsl, so it can stand in for the GPU (no GL needed) and serves as the
+// reference the kernels are checked against. Collision is SSE vectorized, four neighbours per test, and spread
+// over a shared thread pool in chunks of the sorted grid. Gravity builds and walks the same BVH as the
+// asteroidGravity kernels.
+class AsteroidCpuSimulation {
+public:
+    // pool is shared with the rest of the engine and has to outlive the simulation
+    explicit AsteroidCpuSimulation(ThreadPool &pool) : pool(pool) {}
+
+    float gridRadius = 0.0f;
+    float collisionRadius = 0.0f;
+    // hash table buckets, rounded up to a power of two, 0 uses one per asteroid. Match the GPU's table for identical
+    // neighbour lists.
+    uint32_t hashTableSize = 0;
+    // asteroids that start the step further out are removed at its end, 0 keeps all of them
+    float despawnRadius = 0.0f;
+
+    // N-body gravity on the velocities before collision, Barnes-Hut over the BVH of asteroid_gravity.glsl
+    struct Gravity {
+        bool enabled = false;
+        float gravitationalConstant = 1.0f;
+        // the body at the origin the asteroids orbit
+        float centralMass = 0.0f;
+        // asteroid mass per scale^3
+        float asteroidDensity = 1.0f;
+        // nodes smaller than this times their distance pull as one body
+        float openingAngle = 0.5f;
+        float softening = 1.0f;
+        // the Morton codes cover [-extent, extent]^3
+        float extent = 1000.0f;
+    } gravity;
+
+    // One frame: grid, gravity, collision and separation, integration, despawn. Same order as AsteroidsSystem::Update.
+    void step(std::vector<AsteroidData> &asteroids, float deltaTime);
+
+    double lastStepMilliseconds() const { return stepMilliseconds; }
+
+    // the index every survivor of the last step had before it, in the order step left the asteroids in
+    const std::vector<uint32_t> &lastSurvivors() const { return survivorSources; }
+
+    // how well the last step's grid hashed
+    struct ChainStats {
+        uint32_t buckets = 0;
+        uint32_t occupiedBuckets = 0;
+        // asteroids in the fullest bucket, every neighbour query of it walks them all
+        uint32_t longestChain = 0;
+        // buckets holding more than one cell, their asteroids are candidates for cells that aren't neighbours
+        uint32_t sharedBuckets = 0;
+    };
+
+    const ChainStats &lastChainStats() const { return chainStats; }
+
+    // HashCell of asteroid_grid.glsl, tableSize has to be a power of two
+    static uint32_t hashCell(glm::ivec3 cell, uint32_t tableSize);
+
+private:
+    // sorted slots per parallelFor index
+    static constexpr size_t chunkSize = 1024;
+
+    ThreadPool &pool;
+    double stepMilliseconds = 0.0;
+    ChainStats chainStats;
+
+    // per asteroid
+    std::vector<uint32_t> hashes;
+    std::vector<uint8_t> dead;
+    std::vector<uint32_t> survivorSources;
+    // per hash, one extra entry so cellStart[hash + 1] always ends the cell
+    std::vector<uint32_t> cellStart;
+    // per sorted slot: the asteroid and its collision body, SoA so four of them load at once
+    std::vector<uint32_t> keys;
+    std::vector<float> bodyX, bodyY, bodyZ, bodyRadius;
+    // the BVH, laid out like asteroid_gravity.glsl's: internal nodes first, then one leaf per sorted asteroid
+    struct GravityNode {
+        // w is the mass
+        glm::vec4 centerOfMass;
+        glm::vec3 lower, upper;
+        uint32_t left = 0, right = 0;
+    };
+    // Morton code and asteroid index
+    std::vector<std::pair<uint32_t, uint32_t>> gravityKeys;
+    std::vector<GravityNode> gravityNodes;
+
+    uint32_t tableSize(size_t count) const {
+        return hashTableBuckets(hashTableSize != 0 ? hashTableSize : static_cast<uint32_t>(count));
+    }
+
+    void buildGrid(const std::vector<AsteroidData> &asteroids);
+
+    void buildTree(const std::vector<AsteroidData> &asteroids);
+
+    // sums a subtree's children into it, left first like asteroidGravityBuild.glsl
+    void sumNode(uint32_t node);
+
+    // the pull of the central body and every other asteroid on asteroid self, at position
+    glm::vec3 attraction(glm::vec3 position, uint32_t self) const;
+
+    void collide(std::vector<AsteroidData> &asteroids, size_t slot, float deltaTime);
+
+    // separation summed over the sorted slots [begin, end)
+    void accumulate(size_t self, uint32_t begin, uint32_t end, glm::vec3 &sum, int &collisions) const;
+};
+
+
+#endif //REASONABLEGL_ASTEROIDCPUSIMULATION_H
@@ -0,0 +1,36 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "AsteroidData.h"
+#include <glm/mat3x3.hpp>
+
+AsteroidInstance AsteroidInstance::of(const AsteroidData &asteroid) {
+    // MODEL_BLEND of asteroid_instance.glsl
+    const float modelBlend = 0.835f;
+    glm::mat3 rotation = glm::mat3_cast(asteroid.orientation);
+    float scale = asteroid.position.w + modelBlend;
+    glm::vec3 translation = glm::vec3(asteroid.position) * asteroid.position.w;
+    AsteroidInstance instance{};
+    // glm is column-major, rotation[column][row]
+    for (int row = 0; row < 3; ++row)
+        instance.rows[row] = glm::vec4(glm::vec3(rotation[0][row], rotation[1][row], rotation[2][row]) * scale,
+                                       translation[row]);
+    return instance;
+}
+
+AsteroidCounters AsteroidCounters::forLiveCount(uint32_t liveCount) {
+    AsteroidCounters counters;
+    counters.liveCount = liveCount;
+    for (int size = 0; size < workgroupSizes; ++size) {
+        uint32_t localSize = 1u << size;
+        counters.dispatches[size] = {(liveCount + localSize - 1) / localSize, 1, 1};
+    }
+    return counters;
+}
+
+int AsteroidCounters::sizeIndex(int localSize) {
+    int index = 0;
+    while (index + 1 < workgroupSizes && (2 << index) <= localSize) index++;
+    return index;
+}
@@ -0,0 +1,84 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_ASTEROIDDATA_H
+#define REASONABLEGL_ASTEROIDDATA_H
+
+#include <cstdint>
+#include <glm/vec4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Layouts shared with the asteroid compute shaders (std430), kept free of GL so the CPU simulation can use them.
+
+// One asteroid as the CPU sees it. On the GPU every member is an array of its own (AsteroidState), so a kernel
+// only streams the members it touches.
+struct AsteroidData {
+    // w is the uniform scale
+    glm::vec4 position;
+    glm::quat orientation;
+    // w unused
+    glm::vec4 velocity;
+};
+
+// the three rows of a 3x4 affine transform, asteroid_instance.glsl's mat3x4
+struct AsteroidInstance {
+    glm::vec4 rows[3];
+
+    // what asteroidCollision writes for an asteroid
+    static AsteroidInstance of(const AsteroidData &asteroid);
+};
+
+static_assert(sizeof(glm::quat) == sizeof(glm::vec4), "orientations are uploaded as vec4, w last");
+
+// Buckets of the grid's hash table for a requested size, a power of two so hashes are masked instead of divided.
+inline uint32_t hashTableBuckets(uint32_t requested) {
+    uint32_t buckets = 1;
+    while (buckets < requested) buckets <<= 1;
+    return buckets;
+}
+
+struct CellData {
+    int key;
+    int cellHash;
+};
+
+struct Offsets {
+    int value;
+};
+
+// an asteroid's cell and its slot inside it, written by asteroidGridCreation
+struct CellRank {
+    int cellHash;
+    int rank;
+};
+
+
+struct DispatchIndirectCommand {
+    uint32_t x, y, z;
+};
+
+// Matches AsteroidCounterBuffer in res/shaders/include/asteroid_counters.glsl, the draw commands of the asteroid
+// model's meshes follow it in the same buffer.
+struct AsteroidCounters {
+    // one dispatch per power of two workgroup size, 1 to 1024
+    static constexpr int workgroupSizes = 11;
+
+    uint32_t liveCount = 0;
+    uint32_t deadCount = 0;
+    // float bits of the fastest survivor's speed in the last step
+    uint32_t maxSpeedBits = 0;
+    DispatchIndirectCommand dispatches[workgroupSizes]{};
+
+    // what asteroidCounters.glsl would write for this many asteroids
+    static AsteroidCounters forLiveCount(uint32_t liveCount);
+
+    // Entry of dispatches for a workgroup size. Sizes that aren't a power of two round down, the extra groups find
+    // no asteroid and return.
+    static int sizeIndex(int localSize);
+};
+
+static_assert(sizeof(AsteroidCounters) == 12 + AsteroidCounters::workgroupSizes * 12, "std430 layout");
+
+
+#endif //REASONABLEGL_ASTEROIDDATA_H
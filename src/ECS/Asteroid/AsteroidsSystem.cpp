@@ -3,27 +3,17 @@
 //
 
 #include "AsteroidsSystem.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 
 
-unsigned int nextPowerOfTwo(unsigned int n) {
-    // If n is already a power of two, return it
-    if (n && !(n & (n - 1)))
-        return n;
-
-    // Find the position of the most significant bit (MSB)
-    unsigned int count = 0;
-    while (n != 0) {
-        n >>= 1;
-        count++;
-    }
-
-    // The power of two will have only the MSB set, so left shift 1 to the left by count positions
-    return 1 << count;
-}
-
 void AsteroidsSystem::draw(Shader &regularShader,Shader &instancedShader) {
     instancedShader.use();
     instancedShader.setMatrix4("model", false, glm::value_ptr(transform.getModelMatrix()));
+    instancedShader.setFloat("stepLag", stepLag);
 
     textures[0]->use(GL_TEXTURE3);
     textures[1]->use(GL_TEXTURE4);
@@ -32,73 +22,356 @@ void AsteroidsSystem::draw(Shader &regularShader,Shader &instancedShader) {
     textures[4]->use(GL_TEXTURE7);
 
     for (unsigned int i = 0; i < asteroidModel.meshes.size(); i++) {
-        glBindVertexArray(asteroidModel.meshes[i].VAO);
-        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(asteroidModel.meshes[i].indices.size()),
-                                GL_UNSIGNED_INT, 0, asteroidsData.size());
+        asteroidModel.meshes[i]->bindVertexFormat(instancedShader);
+        glBindVertexArray(asteroidModel.meshes[i]->VAO);
+        // instanceCount is the live count asteroidCounters wrote
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers.counters);
+        glDrawElementsIndirect(GL_TRIANGLES, asteroidModel.meshes[i]->indexType,
+                               reinterpret_cast<const void *>(AsteroidBuffers::drawOffset(i)));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
         glBindVertexArray(0);
     }
 }
 
-void AsteroidsSystem::Init() {
-    asteroidModel.loadModel();
+std::vector<AsteroidData> AsteroidsSystem::Generate(int count) const {
     const float PI = 3.14159265359;
-    float radius = 300;
-    float span = 10;
+    float radius = ringRadius;
+    float span = ringSpan;
 
-    size = 3000;
-    std::vector<glm::vec3> positions(size);
-    std::vector<glm::vec3> rotations(size);
-    std::vector<glm::vec3> velocities(size);
-    std::vector<glm::vec3> angularVelocites(size);
-    std::vector<glm::vec3> scales(size);
-
-
-    for (int i = 0; i < size; ++i) {
+    std::vector<AsteroidData> generated;
+    generated.reserve(count);
+    for (int i = 0; i < count; ++i) {
         // Generate random positions
         float angle = glm::linearRand(0.0f, 2 * PI);
         float distance = glm::linearRand(radius, radius + span);
-        
+
         float asteroidX = distance * sin(angle);
         float asteroidZ = distance * cos(angle);
         float asteroidY = glm::linearRand(-span * 5, span * 5);
 
+        glm::vec3 position = glm::vec3(asteroidX, asteroidY, asteroidZ);
+        glm::vec3 rotation = glm::vec3(glm::linearRand(0.0f, 2 * PI));
+        float scale = glm::linearRand(minScale, maxScale);
+        glm::vec3 velocity = glm::linearRand(glm::vec3(-0.5f), glm::vec3(0.5f)) + OrbitalVelocity(position);
+        generated.push_back(AsteroidData(glm::vec4(position, scale), glm::quat(rotation), glm::vec4(velocity, 0)));
+    }
+    return generated;
+}
+
+std::vector<AsteroidsSystem::Kernel> AsteroidsSystem::Kernels() {
+    return {
+            {"gridCreation", "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridCreation.glsl",
+                    &cumputeShaderGridCreation},
+            {"gridScan",     "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridScan.glsl",
+                    &cumputeShaderGridScan, {{"SCAN_ENDS_BINDING", "27"}}},
+            // the same scan over the alive flags gives every survivor its slot in the next state
+            {"aliveScan",    "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridScan.glsl",
+                    &cumputeShaderAliveScan, {{"SCAN_COUNTS_BINDING", "19"}, {"SCAN_OFFSETS_BINDING", "20"}}},
+            {"gridScatter",  "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridScatter.glsl",
+                    &cumputeShaderGridScatter},
+            {"gridSortCells", "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridSortCells.glsl",
+                    &cumputeShaderGridSortCells},
+            // gravity from the current state into the next velocities, dispatched only while it's on
+            {"gravitySort",  "res/shaders/AsteroidSystem/ComputeShaders/asteroidGravitySort.glsl",
+                    &cumputeShaderGravitySort},
+            {"gravityBuild", "res/shaders/AsteroidSystem/ComputeShaders/asteroidGravityBuild.glsl",
+                    &cumputeShaderGravityBuild},
+            {"gravityForce", "res/shaders/AsteroidSystem/ComputeShaders/asteroidGravityForce.glsl",
+                    &cumputeShaderGravityForce},
+            // collision, separation and movement in one pass, into the next state
+            {"collision",    "res/shaders/AsteroidSystem/ComputeShaders/asteroidCollision.glsl",
+                    &cumputeShaderCollide},
+    };
+}
+
+int AsteroidsSystem::WorkgroupSize(const Kernel &kernel) const {
+    auto found = workgroupSizes.find(kernel.name);
+    return found != workgroupSizes.end() ? found->second : defaultWorkgroupSize;
+}
+
+void AsteroidsSystem::SetupKernel(const Kernel &kernel, ComputeShader &shader) const {
+    shader.use();
+    if (strcmp(kernel.name, "gridCreation") == 0) {
+        shader.setFloat("gridRadius", gridRadius);
+    } else if (strcmp(kernel.name, "gridScatter") == 0) {
+        shader.setFloat("collisionRadius", collisionRadius);
+    } else if (strcmp(kernel.name, "collision") == 0) {
+        shader.setFloat("gridRadius", gridRadius);
+    }
+}
+
+int AsteroidsSystem::RunKernel(const Kernel &kernel, ComputeShader &shader, int capacity, int localSize,
+                               float deltaTime) const {
+    auto indirect = [localSize]() {
+        GLintptr offset = offsetof(AsteroidCounters, dispatches) +
+                          AsteroidCounters::sizeIndex(localSize) * sizeof(DispatchIndirectCommand);
+        glDispatchComputeIndirect(offset);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    };
+    if (strncmp(kernel.name, "gravity", 7) == 0 && !gravity) return 0;
+    shader.use();
+    if (strcmp(kernel.name, "collision") == 0) {
+        shader.setFloat("deltaTime", deltaTime);
+        shader.setInt("startsFixedStep", startsFixedStep);
+        shader.setInt("gravity", gravity);
+        shader.setFloat("despawnRadius", despawnRadius);
+    } else if (strcmp(kernel.name, "gravitySort") == 0) {
+        shader.setFloat("gravityExtent", gravityExtent);
+        shader.setInt("sortPass", 0);
+        indirect();
+        // the 30 bit Morton codes, asteroidGravitySort.glsl's DIGIT_BITS per round
+        for (int shift = 0; shift < 30; shift += 3) {
+            shader.setInt("digitShift", shift);
+            shader.setInt("sortPass", 1);
+            indirect();
+            shader.setInt("sortPass", 2);
+            glDispatchCompute(1, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            shader.setInt("sortPass", 3);
+            indirect();
+        }
+        return 31;
+    } else if (strcmp(kernel.name, "gravityBuild") == 0) {
+        shader.setFloat("asteroidDensity", asteroidDensity);
+        for (int pass = 0; pass < 2; ++pass) {
+            shader.setInt("buildPass", pass);
+            indirect();
+        }
+        return 2;
+    } else if (strcmp(kernel.name, "gravityForce") == 0) {
+        shader.setFloat("deltaTime", deltaTime);
+        shader.setFloat("gravitationalConstant", gravitationalConstant);
+        shader.setFloat("centralMass", centralMass);
+        shader.setFloat("openingAngle", openingAngle);
+        shader.setFloat("softening", softening);
+        shader.setFloat("despawnRadius", despawnRadius);
+    } else if (strcmp(kernel.name, "gridCreation") == 0) {
+        shader.setFloat("despawnRadius", despawnRadius);
+    } else if (strcmp(kernel.name, "gridScan") == 0 || strcmp(kernel.name, "aliveScan") == 0) {
+        // counting sort: gridCreation counted the buckets, this turns the counts into start and end, gridScatter
+        // places every asteroid. One bucket per invocation over the whole table, one alive flag per invocation over
+        // the whole capacity. The benchmark's buffers have the system's table size as well.
+        int elements = strcmp(kernel.name, "gridScan") == 0
+                       ? static_cast<int>(hashTableBuckets(static_cast<uint32_t>(std::max(hashTableSize, 1))))
+                       : capacity;
+        int blockCount = (elements + localSize - 1) / localSize;
+        shader.setInt("blockCount", blockCount);
+        for (int pass = 0; pass < 3; ++pass) {
+            shader.setInt("scanPass", pass);
+            glDispatchCompute(pass == 1 ? 1 : blockCount, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        return 3;
+    }
+    indirect();
+    return 1;
+}
+
+void AsteroidsSystem::RunCounters(int stage, int spawned) const {
+    cumputeShaderCounters.use();
+    cumputeShaderCounters.setInt("stage", stage);
+    cumputeShaderCounters.setGLuint("spawned", static_cast<GLuint>(spawned));
+    cumputeShaderCounters.setGLuint("capacity", static_cast<GLuint>(buffers.capacity));
+    glDispatchCompute(1, 1, 1);
+    // the next dispatch or draw takes its size from what this wrote
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void AsteroidsSystem::Emit(int count) {
+    cumputeShaderEmit.use();
+    cumputeShaderEmit.setGLuint("spawnCount", static_cast<GLuint>(count));
+    cumputeShaderEmit.setGLuint("seed", spawnSeed++);
+    cumputeShaderEmit.setFloat("ringRadius", ringRadius);
+    cumputeShaderEmit.setFloat("ringSpan", ringSpan);
+    cumputeShaderEmit.setFloat("minScale", minScale);
+    cumputeShaderEmit.setFloat("maxScale", maxScale);
+    cumputeShaderEmit.setFloat("orbitalGravity", gravity ? gravitationalConstant * centralMass : 0.0f);
+    glDispatchCompute((count + emitWorkgroupSize - 1) / emitWorkgroupSize, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void AsteroidsSystem::StepGPU(float deltaTime, int spawned, bool startsFixedStep) {
+    this->startsFixedStep = startsFixedStep;
+    if (spawned > 0) Emit(spawned);
+    RunCounters(0, spawned);
+    for (const Kernel &kernel: Kernels())
+        RunKernel(kernel, *kernel.shader, buffers.capacity, WorkgroupSize(kernel), deltaTime);
+    RunCounters(1);
+    buffers.swap();
+}
 
-        positions[i] = glm::vec3(asteroidX, asteroidY, asteroidZ);
-        rotations[i] = glm::vec3(glm::linearRand(0.0f, 2 * PI));
-        scales[i] = glm::vec3(glm::linearRand(minScale, maxScale));
-        velocities[i] = glm::linearRand(glm::vec3(-0.5f), glm::vec3(0.5f));
-        angularVelocites[i] = glm::linearRand(glm::vec3(-1), glm::vec3(1));
+void AsteroidsSystem::Spawn(int count) {
+    if (count <= 0) return;
+    if (backend == AsteroidBackend::GPU) {
+        pendingSpawn += count;
+        return;
+    }
+    count = std::min(count, buffers.capacity - static_cast<int>(asteroidsData.size()));
+    if (count <= 0) return;
+    std::vector<AsteroidData> spawned = Generate(count);
+    asteroidsData.insert(asteroidsData.end(), spawned.begin(), spawned.end());
+}
 
+void AsteroidBuffers::create(const std::vector<AsteroidData> &data, int capacity, int tableSize,
+                             const std::vector<GLuint> &indexCounts) {
+    auto allocate = [](GLuint &buffer, GLsizeiptr bytes, const void *contents, GLenum usage) {
+        if (buffer == 0) glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, contents, usage);
+    };
+    this->capacity = std::max(capacity, static_cast<int>(data.size()));
+    this->tableSize = static_cast<int>(hashTableBuckets(static_cast<uint32_t>(std::max(tableSize, 1))));
+    meshIndexCounts = indexCounts;
+    GLsizeiptr slots = this->capacity;
+    GLsizeiptr buckets = this->tableSize;
+    for (AsteroidState *state: {&current, &next}) {
+        allocate(state->positions, slots * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+        allocate(state->orientations, slots * sizeof(glm::quat), nullptr, GL_DYNAMIC_DRAW);
+        allocate(state->velocities, slots * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+        allocate(state->instances, slots * sizeof(AsteroidInstance), nullptr, GL_DYNAMIC_DRAW);
+        allocate(state->previousInstances, slots * sizeof(AsteroidInstance), nullptr, GL_DYNAMIC_DRAW);
     }
+    allocate(cells, slots * sizeof(CellData), nullptr, GL_DYNAMIC_DRAW);
+    allocate(cellStarts, buckets * sizeof(Offsets), nullptr, GL_DYNAMIC_DRAW);
+    allocate(cellEnds, buckets * sizeof(Offsets), nullptr, GL_DYNAMIC_DRAW);
+    allocate(cellRanks, slots * sizeof(CellRank), nullptr, GL_DYNAMIC_DRAW);
+    // one block per element covers the smallest workgroup size, for both the table and the alive flags
+    allocate(blockSums, std::max(slots, buckets) * sizeof(GLint), nullptr, GL_DYNAMIC_DRAW);
+    allocate(cellBodies, slots * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    allocate(survivorSlots, slots * sizeof(GLint), nullptr, GL_DYNAMIC_DRAW);
+    allocate(gravityKeys, slots * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    allocate(gravityScratchKeys, slots * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    // eight digits per block, one block per asteroid at the smallest workgroup size
+    allocate(gravityDigits, slots * 8 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    // internal nodes and leaves, one short of two per asteroid
+    allocate(gravityLinks, slots * 2 * 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    allocate(gravityNodes, slots * 2 * 3 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+    allocate(counters, drawOffset(meshIndexCounts.size()), nullptr, GL_DYNAMIC_DRAW);
+    // the scans zero the counts and flags after reading them, they only have to start out zeroed
+    allocate(cellCounts, buckets * sizeof(GLint), nullptr, GL_DYNAMIC_DRAW);
+    allocate(aliveFlags, slots * sizeof(GLint), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    clearCounts();
+    upload(data);
+    writeCounters(static_cast<uint32_t>(data.size()));
+}
 
-    // Display generated positions and velocities
-    for (int i = 0; i < size; ++i) {
-        asteroidsData.push_back(
-                AsteroidData(glm::vec4(positions[i], 1), glm::vec4(rotations[i], 1), glm::vec4(scales[i], 1),
-                             glm::vec4(velocities[i], 1), glm::vec4(angularVelocites[i], 1), glm::vec4(0)));
+void AsteroidBuffers::upload(const std::vector<AsteroidData> &data, const std::vector<AsteroidData> &previous) const {
+    std::vector<glm::vec4> positions(data.size()), velocities(data.size());
+    std::vector<glm::quat> orientations(data.size());
+    std::vector<AsteroidInstance> instanceData(data.size()), previousData(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        positions[i] = data[i].position;
+        orientations[i] = data[i].orientation;
+        velocities[i] = data[i].velocity;
+        instanceData[i] = AsteroidInstance::of(data[i]);
+        previousData[i] = i < previous.size() ? AsteroidInstance::of(previous[i]) : instanceData[i];
     }
+    auto write = [](GLuint buffer, const auto &values) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, values.size() * sizeof(values[0]), values.data());
+    };
+    write(current.positions, positions);
+    write(current.orientations, orientations);
+    write(current.velocities, velocities);
+    write(current.instances, instanceData);
+    write(current.previousInstances, previousData);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
 
-    GLuint currentId;
-    glGenBuffers(1, &currentId);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, currentId);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, asteroidsData.size() * sizeof(AsteroidData), asteroidsData.data(),
-                 GL_STREAM_DRAW);
-    GLuint bindingPoint = 0; // Choose a binding point
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, currentId);
+std::vector<AsteroidData> AsteroidBuffers::read(uint32_t count) const {
+    std::vector<glm::vec4> positions(count), velocities(count);
+    std::vector<glm::quat> orientations(count);
+    auto fetch = [](GLuint buffer, auto &values) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, values.size() * sizeof(values[0]), values.data());
+    };
+    fetch(current.positions, positions);
+    fetch(current.orientations, orientations);
+    fetch(current.velocities, velocities);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::vector<AsteroidData> data(count);
+    for (uint32_t i = 0; i < count; ++i) data[i] = {positions[i], orientations[i], velocities[i]};
+    return data;
+}
 
-    glGenBuffers(1, &currentId);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, currentId);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, asteroidsData.size() * sizeof(CellData), nullptr,
-                 GL_DYNAMIC_DRAW);
-    bindingPoint = 1; // Choose a binding point
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, currentId);
+void AsteroidBuffers::writeCounters(uint32_t liveCount) const {
+    AsteroidCounters header = AsteroidCounters::forLiveCount(liveCount);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+    for (size_t mesh = 0; mesh < meshIndexCounts.size(); ++mesh) {
+        // count, instanceCount, firstIndex, baseVertex, baseInstance
+        GLuint command[5] = {meshIndexCounts[mesh], liveCount, 0, 0, 0};
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, drawOffset(mesh), sizeof(command), command);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
 
-    glGenBuffers(1, &currentId);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, currentId);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, asteroidsData.size() * sizeof(Offsets), nullptr,
-                 GL_STREAM_DRAW);
-    bindingPoint = 2; // Choose a binding point
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, currentId);
+void AsteroidBuffers::clearCounts() const {
+    for (GLuint buffer: {cellCounts, aliveFlags}) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, nullptr);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void AsteroidState::bind(GLuint positionBinding, GLuint orientationBinding, GLuint velocityBinding,
+                         GLuint instanceBinding, GLuint previousInstanceBinding) const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, positionBinding, positions);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, orientationBinding, orientations);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, velocityBinding, velocities);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceBinding, instances);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, previousInstanceBinding, previousInstances);
+}
+
+void AsteroidBuffers::swap() {
+    std::swap(current, next);
+    current.bind(0, 21, 22, 25, 26);
+    next.bind(18, 23, 24, 33, 34);
+}
+
+void AsteroidBuffers::bind() const {
+    current.bind(0, 21, 22, 25, 26);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cells);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cellStarts);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, cellCounts);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, cellRanks);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, blockSums);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, cellBodies);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, counters);
+    next.bind(18, 23, 24, 33, 34);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, aliveFlags);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 20, survivorSlots);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 27, cellEnds);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 28, gravityKeys);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 29, gravityScratchKeys);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 30, gravityDigits);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 31, gravityLinks);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 32, gravityNodes);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counters);
+}
+
+void AsteroidBuffers::release() {
+    GLuint all[] = {current.positions, current.orientations, current.velocities, current.instances,
+                    current.previousInstances, cells, cellStarts, cellEnds, cellCounts, cellRanks, blockSums,
+                    cellBodies, counters, next.positions, next.orientations, next.velocities, next.instances,
+                    next.previousInstances,
+                    aliveFlags, survivorSlots, gravityKeys, gravityScratchKeys, gravityDigits, gravityLinks,
+                    gravityNodes};
+    glDeleteBuffers(sizeof(all) / sizeof(all[0]), all);
+    *this = AsteroidBuffers();
+}
+
+void AsteroidsSystem::Init(ThreadPool &workers) {
+    this->workers = &workers;
+    asteroidModel.loadModel();
+
+    asteroidsData = Generate(initialCount);
+    std::vector<GLuint> indexCounts;
+    for (const auto &mesh: asteroidModel.meshes) indexCounts.push_back(mesh->indexCount);
+    buffers.create(asteroidsData, capacity, hashTableSize, indexCounts);
+    BindBuffers();
 
     /*
     shared_ptr<Texture> albedoMap = std::make_shared<Texture>("ocean-rock_albedo.png", "res/textures/ocean-rock-bl",
@@ -128,66 +401,276 @@ void AsteroidsSystem::Init() {
     textures[4]->use(GL_TEXTURE7);
 */
 
-    cumputeShaderMovment.init();
-    cumputeShaderGridCreation.init();
-    cumputeShaderGridCreation.use();
     float furthestPoint = (asteroidModel.futhestLenghtsFromCenter.x + asteroidModel.futhestLenghtsFromCenter.y +
                            asteroidModel.futhestLenghtsFromCenter.z) / 3;
-    cumputeShaderGridCreation.setFloat("gridRadius", maxScale * furthestPoint * 2.0f);
+    gridRadius = maxScale * furthestPoint * 2.0f;
+    collisionRadius = furthestPoint;
+
+    // workgroup sizes from the last benchmark on this device
+    workgroupSizes = AsteroidBenchmark::load();
+    for (const Kernel &kernel: Kernels()) {
+        kernel.shader->defines.insert(kernel.defines.begin(), kernel.defines.end());
+        kernel.shader->setLayout(WorkgroupSize(kernel), 1, 1);
+        kernel.shader->init();
+        SetupKernel(kernel, *kernel.shader);
+    }
+    cumputeShaderCounters.init();
+    cumputeShaderEmit.setLayout(emitWorkgroupSize, 1, 1);
+    cumputeShaderEmit.init();
+
+    if (parityCheckSteps > 0) {
+        // the check steps the initial asteroids, the simulation still starts from them
+        std::vector<AsteroidData> initial = asteroidsData;
+        lastParity = CheckParity(fixedStep, parityCheckSteps);
+        asteroidsData = initial;
+        Upload();
+    }
+}
 
-    cumputeShaderGridSort.init();
-    cumputeShaderGridSort.use();
+void AsteroidsSystem::Update(double deltaTime) {
+    accumulator = std::min(accumulator + deltaTime, static_cast<double>(fixedStep) * maxStepsPerFrame);
+    int steps = static_cast<int>(accumulator / fixedStep);
+    accumulator -= steps * static_cast<double>(fixedStep);
+    if (steps > 0) {
+        lastSubsteps = SubstepCount();
+        float substepTime = fixedStep / static_cast<float>(lastSubsteps);
+        // the CPU's asteroids at the start of the current fixed step, following them through the despawns
+        std::vector<AsteroidData> previous;
+        for (int step = 0; step < steps * lastSubsteps; ++step) {
+            bool startsFixedStep = step % lastSubsteps == 0;
+            if (backend == AsteroidBackend::CPU) {
+                if (startsFixedStep) previous = asteroidsData;
+                CpuSimulation().step(asteroidsData, substepTime);
+                // survivors keep their order, every source is at or after its new index
+                const std::vector<uint32_t> &sources = CpuSimulation().lastSurvivors();
+                for (size_t i = 0; i < sources.size(); ++i) previous[i] = previous[sources[i]];
+                previous.resize(sources.size());
+            } else {
+                StepGPU(substepTime, pendingSpawn, startsFixedStep);
+                pendingSpawn = 0;
+            }
+        }
+        if (backend == AsteroidBackend::CPU) Upload(previous);
+        else RequestMaxSpeed();
+    }
+    // The newest state is up to a fixed step ahead of the frame. Drawing a fixed step behind it, between the last
+    // step's start and end, puts the asteroids where they were at frame time without ever extrapolating, so the
+    // fixed rate doesn't show as stutter.
+    stepLag = static_cast<float>(1.0 - accumulator / fixedStep);
+}
 
-    cumputeShaderGridCalculateOffset.init();
-    cumputeShaderGridSort.use();
+int AsteroidsSystem::SubstepCount() {
+    int count = std::max(substeps, 1);
+    if (!adaptiveSubsteps) return count;
+    if (backend == AsteroidBackend::CPU) {
+        maxSpeed = 0.0f;
+        for (const AsteroidData &asteroid: asteroidsData)
+            maxSpeed = std::max(maxSpeed, glm::length(glm::vec3(asteroid.velocity)));
+    } else if (speedFence != nullptr) {
+        GLenum status = glClientWaitSync(speedFence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            GLuint bits = 0;
+            glBindBuffer(GL_COPY_READ_BUFFER, speedReadback);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(bits), &bits);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            std::memcpy(&maxSpeed, &bits, sizeof(maxSpeed));
+            glDeleteSync(speedFence);
+            speedFence = nullptr;
+        }
+    }
+    float smallestBody = collisionRadius * minScale / 2;
+    if (smallestBody > 0.0f)
+        count = std::max(count, static_cast<int>(std::ceil(maxSpeed * fixedStep / smallestBody)));
+    return std::min(count, std::max(maxSubsteps, substeps));
+}
 
-    cumputeShaderCollide.init();
-    cumputeShaderCollide.use();
-    cumputeShaderCollide.setFloat("collisionRadius", furthestPoint);
-    cumputeShaderCollide.setFloat("gridRadius", maxScale * furthestPoint * 2.0f);
+void AsteroidsSystem::RequestMaxSpeed() {
+    // the last copy hasn't arrived yet
+    if (speedFence != nullptr) return;
+    if (speedReadback == 0) {
+        glGenBuffers(1, &speedReadback);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, speedReadback);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffers.counters);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, speedReadback);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offsetof(AsteroidCounters, maxSpeedBits), 0,
+                        sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    speedFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
 
-    cumputeShaderSeperation.init();
-    cumputeShaderSeperation.use();
+AsteroidCpuSimulation &AsteroidsSystem::CpuSimulation() {
+    if (cpuSimulation == nullptr) cpuSimulation = std::make_unique<AsteroidCpuSimulation>(*workers);
+    cpuSimulation->gridRadius = gridRadius;
+    cpuSimulation->collisionRadius = collisionRadius;
+    cpuSimulation->hashTableSize = static_cast<uint32_t>(buffers.tableSize);
+    cpuSimulation->despawnRadius = despawnRadius;
+    AsteroidCpuSimulation::Gravity &cpuGravity = cpuSimulation->gravity;
+    cpuGravity.enabled = gravity;
+    cpuGravity.gravitationalConstant = gravitationalConstant;
+    cpuGravity.centralMass = centralMass;
+    cpuGravity.asteroidDensity = asteroidDensity;
+    cpuGravity.openingAngle = openingAngle;
+    cpuGravity.softening = softening;
+    cpuGravity.extent = gravityExtent;
+    return *cpuSimulation;
 }
 
-void AsteroidsSystem::Update(double deltaTime) {
-    cumputeShaderMovment.use();
-    cumputeShaderMovment.setFloat("deltaTime", deltaTime);
-    glDispatchCompute(asteroidsData.size(), 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+void AsteroidsSystem::Upload(const std::vector<AsteroidData> &previous) const {
+    buffers.upload(asteroidsData, previous);
+    buffers.writeCounters(static_cast<uint32_t>(asteroidsData.size()));
+}
 
-    cumputeShaderGridCreation.use();
-    glDispatchCompute(asteroidsData.size(), 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+std::vector<AsteroidData> AsteroidsSystem::ReadBack() const {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    GLuint liveCount = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.counters);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(liveCount), &liveCount);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffers.read(liveCount);
+}
 
-    cumputeShaderGridSort.use();
-    int numPairs = nextPowerOfTwo(asteroidsData.size()) / 2;
-    int numStages = (int) glm::log2((float) numPairs * 2);
-    for (int stageIndex = 0; stageIndex < numStages; stageIndex++) {
-        for (int stepIndex = 0; stepIndex < stageIndex + 1; stepIndex++) {
-            // Calculate some pattern stuff
-            int groupWidth = 1 << (stageIndex - stepIndex);
-            int groupHeight = 2 * groupWidth - 1;
-            cumputeShaderGridSort.setInt("groupWidth", groupWidth);
-            cumputeShaderGridSort.setInt("groupHeight", groupHeight);
-            cumputeShaderGridSort.setInt("stepIndex", stepIndex);
-            // Run the sorting step on the GPU
-            glDispatchCompute(numPairs, 1, 1);
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-        }
-    }
+glm::vec3 AsteroidsSystem::OrbitalVelocity(glm::vec3 position) const {
+    float radius = std::sqrt(position.x * position.x + position.z * position.z);
+    if (!gravity || radius <= 0.0f) return glm::vec3(0.0f);
+    // around the y axis, the same way round as asteroidEmit
+    return glm::vec3(position.z, 0.0f, -position.x) / radius * std::sqrt(gravitationalConstant * centralMass / radius);
+}
 
-    cumputeShaderGridCalculateOffset.use();
-    glDispatchCompute(asteroidsData.size(), 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+void AsteroidsSystem::Circularize() {
+    if (backend == AsteroidBackend::GPU) asteroidsData = ReadBack();
+    for (AsteroidData &asteroid: asteroidsData)
+        asteroid.velocity = glm::vec4(OrbitalVelocity(glm::vec3(asteroid.position)), asteroid.velocity.w);
+    Upload();
+}
 
+void AsteroidsSystem::SetBackend(AsteroidBackend newBackend) {
+    if (newBackend == backend) return;
+    // asteroidsData only follows the simulation while the CPU runs it
+    if (newBackend == AsteroidBackend::CPU) {
+        asteroidsData = ReadBack();
+        // spawns the GPU didn't get to yet
+        Spawn(pendingSpawn);
+        pendingSpawn = 0;
+    } else {
+        Upload();
+    }
+    backend = newBackend;
+}
 
-    cumputeShaderCollide.use();
-    glDispatchCompute(asteroidsData.size(), 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+AsteroidsSystem::ParityResult AsteroidsSystem::CheckParity(float deltaTime, int steps, float tolerance) {
+    steps = std::max(steps, 1);
+    std::vector<AsteroidData> start = backend == AsteroidBackend::CPU ? asteroidsData : ReadBack();
+    asteroidsData = start;
+    Upload();
+
+    GLuint query;
+    glGenQueries(1, &query);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int step = 0; step < steps; ++step) StepGPU(deltaTime);
+    glEndQuery(GL_TIME_ELAPSED);
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    glDeleteQueries(1, &query);
+    std::vector<AsteroidData> gpu = ReadBack();
+
+    std::vector<AsteroidData> cpu = start;
+    double cpuMilliseconds = 0.0;
+    for (int step = 0; step < steps; ++step) {
+        CpuSimulation().step(cpu, deltaTime);
+        cpuMilliseconds += CpuSimulation().lastStepMilliseconds();
+    }
 
-    cumputeShaderSeperation.use();
-    glDispatchCompute(asteroidsData.size(), 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    ParityResult result;
+    result.count = static_cast<int>(cpu.size());
+    result.gpuMilliseconds = static_cast<double>(elapsed) / 1e6 / steps;
+    result.cpuMilliseconds = cpuMilliseconds / steps;
+    // a different despawn count shifts every survivor after it, they all count as mismatches
+    size_t compared = std::min(cpu.size(), gpu.size());
+    result.mismatches = static_cast<int>(std::max(cpu.size(), gpu.size()) - compared);
+    auto error = [](glm::vec3 a, glm::vec3 b) {
+        return glm::length(a - b) / glm::max(1.0f, glm::max(glm::length(a), glm::length(b)));
+    };
+    for (size_t i = 0; i < compared; ++i) {
+        float positionError = error(glm::vec3(gpu[i].position), glm::vec3(cpu[i].position));
+        float velocityError = error(glm::vec3(gpu[i].velocity), glm::vec3(cpu[i].velocity));
+        result.maxPositionError = glm::max(result.maxPositionError, positionError);
+        result.maxVelocityError = glm::max(result.maxVelocityError, velocityError);
+        if (!(positionError <= tolerance && velocityError <= tolerance)) result.mismatches++;
+    }
+    // both stepped from the same state, keep going from the GPU result
+    if (backend == AsteroidBackend::CPU) {
+        asteroidsData = gpu;
+    }
+    if (result.passed())
+        spdlog::info("Asteroid parity N={} after {} steps: max position error {}, velocity error {}, GPU {:.3f} ms, "
+                     "CPU {:.3f} ms per step", result.count, steps, result.maxPositionError, result.maxVelocityError,
+                     result.gpuMilliseconds, result.cpuMilliseconds);
+    else
+        spdlog::error("Asteroid parity N={} after {} steps: {} asteroids differ by more than {}, max position error "
+                      "{}, velocity error {}", result.count, steps, result.mismatches, tolerance,
+                      result.maxPositionError, result.maxVelocityError);
+    return result;
 }
 
+void AsteroidsSystem::showImguiOptions() {
+    ImGui::Begin("Asteroids");
+    ImGui::Text("Capacity: %d asteroids", buffers.capacity);
+    if (backend == AsteroidBackend::CPU) ImGui::Text("Live: %d", static_cast<int>(asteroidsData.size()));
+    ImGui::InputInt("##spawnCount", &spawnCount);
+    ImGui::SameLine();
+    if (ImGui::Button("Spawn")) Spawn(spawnCount);
+    ImGui::SliderFloat("Despawn radius", &despawnRadius, 0.0f, 5000.0f);
+    float stepRate = 1.0f / fixedStep;
+    if (ImGui::SliderFloat("Steps per second", &stepRate, 30.0f, 480.0f)) fixedStep = 1.0f / stepRate;
+    ImGui::SliderInt("Max steps per frame", &maxStepsPerFrame, 1, 16);
+    ImGui::SliderInt("Substeps", &substeps, 1, 16);
+    ImGui::Checkbox("Adaptive substeps", &adaptiveSubsteps);
+    if (adaptiveSubsteps) ImGui::SliderInt("Max substeps", &maxSubsteps, 1, 32);
+    ImGui::Text("Last step: %d substeps, max speed %.2f", lastSubsteps, maxSpeed);
+    ImGui::Checkbox("Gravity", &gravity);
+    if (gravity) {
+        ImGui::SliderFloat("Gravitational constant", &gravitationalConstant, 0.0f, 10.0f);
+        ImGui::SliderFloat("Central mass", &centralMass, 0.0f, 100000.0f);
+        ImGui::SliderFloat("Asteroid density", &asteroidDensity, 0.0f, 1000.0f);
+        ImGui::SliderFloat("Opening angle", &openingAngle, 0.0f, 1.5f);
+        ImGui::SliderFloat("Softening", &softening, 0.01f, 10.0f);
+        ImGui::SliderFloat("Gravity extent", &gravityExtent, 100.0f, 5000.0f);
+        if (ImGui::Button("Circular orbits")) Circularize();
+    }
+    bool onCpu = backend == AsteroidBackend::CPU;
+    if (ImGui::Checkbox("Simulate on the CPU", &onCpu))
+        SetBackend(onCpu ? AsteroidBackend::CPU : AsteroidBackend::GPU);
+    if (onCpu) {
+        const AsteroidCpuSimulation::ChainStats &chains = CpuSimulation().lastChainStats();
+        ImGui::Text("CPU step: %.3f ms", CpuSimulation().lastStepMilliseconds());
+        ImGui::Text("Hash: %u of %u buckets used, longest chain %u, %u shared by several cells",
+                    chains.occupiedBuckets, chains.buckets, chains.longestChain, chains.sharedBuckets);
+    }
+    ImGui::SliderInt("Parity steps", &parityCheckSteps, 1, 64);
+    if (ImGui::Button("Check CPU/GPU parity")) lastParity = CheckParity(1.0f / 60.0f, parityCheckSteps);
+    if (lastParity.count > 0)
+        ImGui::Text("%s: %d of %d differ, max error %.2e / %.2e, GPU %.3f ms, CPU %.3f ms",
+                    lastParity.passed() ? "Parity passed" : "Parity FAILED", lastParity.mismatches,
+                    lastParity.count, lastParity.maxPositionError, lastParity.maxVelocityError,
+                    lastParity.gpuMilliseconds, lastParity.cpuMilliseconds);
+    for (const Kernel &kernel: Kernels())
+        ImGui::Text("%s: %d invocations per workgroup", kernel.name, WorkgroupSize(kernel));
+    if (ImGui::Button("Run workgroup benchmark")) {
+        // the kernels are compiled once, the new sizes apply from the next start
+        AsteroidBenchmark::save(benchmark.run(*this));
+    }
+    for (const AsteroidBenchmark::Result &result: benchmark.results())
+        ImGui::Text("%s N=%d local=%d: %.3f ms", result.kernel.c_str(), result.count, result.localSize,
+                    result.milliseconds);
+    for (const AsteroidBenchmark::PipelineResult &result: benchmark.pipelineResults())
+        ImGui::Text("frame N=%d: %.3f ms (gravity %.3f ms), %d dispatches, neighbours %.2f MB global "
+                    "(%.2f MB unfused), %llu foreign reads, longest chain %u", result.count, result.milliseconds,
+                    result.gravityMilliseconds, result.dispatches, result.globalBytes() / 1e6,
+                    result.unfusedBytes() / 1e6,
+                    static_cast<unsigned long long>(result.foreignReads), result.longestChain);
+    ImGui::End();
+}
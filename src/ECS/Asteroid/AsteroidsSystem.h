@@ -16,30 +16,95 @@
 #include "glm/gtc/random.hpp"
 #include "modelLoading/Model.h"
 #include "ECS/Entity.h"
+#include "AsteroidBenchmark.h"
+#include "AsteroidData.h"
+#include "AsteroidCpuSimulation.h"
 #include <random>
 
 
-struct AsteroidData {
-    glm::vec4 position;
-    glm::vec4 rotation;
-    glm::vec4 scale;
-    glm::vec4 velocity;
-    glm::vec4 angularVelocity;
-    glm::vec4 separationVector;
-};
+// The asteroid state on the GPU, one SSBO per member of AsteroidData, and the render transforms collision derived
+// from it in the same step
+struct AsteroidState {
+    GLuint positions = 0;
+    GLuint orientations = 0;
+    GLuint velocities = 0;
+    GLuint instances = 0; // AsteroidInstance per live asteroid, all the vertex shaders read the current ones
+    // every live asteroid's AsteroidInstance when the fixed step that wrote instances began, drawing blends the two
+    GLuint previousInstances = 0;
 
-struct CellData {
-    int key;
-    int cellHash;
+    // current and next sit on different binding points
+    void bind(GLuint positionBinding, GLuint orientationBinding, GLuint velocityBinding, GLuint instanceBinding,
+              GLuint previousInstanceBinding) const;
 };
 
-struct Offsets {
-    int value;
+// Every SSBO of the compute pipeline, the benchmark creates its own set per asteroid count. Everything is sized for
+// the capacity, how many asteroids are alive only the GPU knows.
+struct AsteroidBuffers {
+    AsteroidState current; // bindings 0, 21, 22, 25, 26
+    GLuint cells = 0;      // binding 1, sorted by cell hash
+    GLuint cellStarts = 0; // binding 2, first entry of every bucket in cells
+    GLuint cellEnds = 0;   // binding 27, one past its last entry
+    GLuint cellCounts = 0; // binding 6
+    GLuint cellRanks = 0;  // binding 7
+    GLuint blockSums = 0;  // binding 8, per workgroup totals of the scans
+    GLuint cellBodies = 0; // binding 9, position and collision radius in cells order
+    GLuint counters = 0;   // binding 17, AsteroidCounters and the model's draw commands
+    // bindings 18, 23, 24, 33, 34, what collision writes, swapped with current after every step. Drawing only reads
+    // current, so the step after it never writes what a draw still reads.
+    AsteroidState next;
+    GLuint aliveFlags = 0; // binding 19
+    GLuint survivorSlots = 0; // binding 20, scan of aliveFlags
+    // the gravity BVH, allocated even while gravity is off so toggling it never reallocates
+    GLuint gravityKeys = 0;        // binding 28, Morton code and asteroid index, sorted
+    GLuint gravityScratchKeys = 0; // binding 29, the radix sort's other half
+    GLuint gravityDigits = 0;      // binding 30, per block digit counts and offsets of the radix sort
+    GLuint gravityLinks = 0;       // binding 31, children and parent per node
+    GLuint gravityNodes = 0;       // binding 32, center of mass, mass and bounds per node
+
+    int capacity = 0;
+    // buckets of the hash table, a power of two
+    int tableSize = 0;
+    // index count per mesh of the asteroid model, one draw command each
+    std::vector<GLuint> meshIndexCounts;
+
+    // data becomes the live asteroids, the hash table gets hashTableBuckets(tableSize) buckets
+    void create(const std::vector<AsteroidData> &data, int capacity, int tableSize,
+                const std::vector<GLuint> &indexCounts);
+
+    // Binds the SSBOs and the counters as GL_DISPATCH_INDIRECT_BUFFER, RunKernel dispatches from whatever is bound.
+    void bind() const;
+
+    // overwrites the GPU's live count, the asteroids themselves have to be uploaded separately
+    void writeCounters(uint32_t liveCount) const;
+
+    // The live asteroids and their instance matrices, the counters aren't touched. previous is where they were when
+    // the fixed step began, asteroids past its end didn't move.
+    void upload(const std::vector<AsteroidData> &data, const std::vector<AsteroidData> &previous = {}) const;
+
+    // the first count asteroids of the current state, blocks until the GPU is done with them
+    std::vector<AsteroidData> read(uint32_t count) const;
+
+    // the state collision just wrote becomes the one the next step reads and draw() renders
+    void swap();
+
+    // byte offset of a mesh's DrawElementsIndirectCommand in counters
+    static GLintptr drawOffset(size_t mesh) { return sizeof(AsteroidCounters) + mesh * 5 * sizeof(GLuint); }
+
+    // asteroidGridCreation counts into cellCounts and the scan zeroes them, only needed when that cycle was broken
+    void clearCounts() const;
+
+    void release();
 };
 
 
 static string asteroidModelPath = "res/models/Sphere/Sphere.obj";
 
+enum class AsteroidBackend {
+    GPU,
+    // AsteroidCpuSimulation steps asteroidsData and uploads it for drawing
+    CPU
+};
+
 class AsteroidsSystem : public Entity {
 public:
 
@@ -50,33 +115,195 @@ public:
 
     AsteroidsSystem() = default;
 
-    void Init();
+    // workers is where the CPU backend runs, e.g. the AssetLoader's, it has to outlive the system. The initial
+    // asteroids go through a parity check of parityCheckSteps steps.
+    void Init(ThreadPool &workers);
 
+    // Runs as many fixed steps as the accumulated frame time covers, each split into substeps.
     void Update(double deltaTime);
 
+    // Appends count new asteroids on the ring at the start of the next update, past the capacity they are dropped.
+    void Spawn(int count);
+
 
     void draw(Shader &regularShader,Shader &instancedShader);
+
+    void showImguiOptions();
+
+    // count asteroids scattered over the ring
+    std::vector<AsteroidData> Generate(int count) const;
+
+    // the compute pipeline in dispatch order, name is what AsteroidBenchmark stores the sizes under
+    struct Kernel {
+        const char *name;
+        const char *path;
+        ComputeShader *shader;
+        // on top of the workgroup size, for kernels sharing a source
+        ShaderDefines defines = {};
+    };
+
+    std::vector<Kernel> Kernels();
+
+    // Uniforms that stay the same every frame, Init and the benchmark's copies of the kernels use it.
+    void SetupKernel(const Kernel &kernel, ComputeShader &shader) const;
+
+    // One frame's work of a kernel, barrier included. Per asteroid kernels dispatch indirectly from the bound
+    // counters, only the table-sized scan needs the capacity. Returns the number of dispatches.
+    int RunKernel(const Kernel &kernel, ComputeShader &shader, int capacity, int localSize, float deltaTime) const;
+
+    // asteroidCounters.glsl, stage 0 before the grid and stage 1 after collision
+    void RunCounters(int stage, int spawned = 0) const;
+
+    // A whole frame on the GPU: appends spawned asteroids, reads buffers.current and writes buffers.next, then
+    // swaps them. Drawing only ever reads the completed state, so it doesn't wait on the step after it. The first
+    // substep of a fixed step records the transforms drawing blends from, later ones carry them along.
+    void StepGPU(float deltaTime, int spawned = 0, bool startsFixedStep = true);
+
+    int WorkgroupSize(const Kernel &kernel) const;
+
+    // binds the system's buffers to the kernels' binding points again
+    void BindBuffers() const { buffers.bind(); }
+
+    // the velocity of a circular orbit around the central body at position, zero while gravity is off
+    glm::vec3 OrbitalVelocity(glm::vec3 position) const;
+
+    // puts every live asteroid on its circular orbit, the GPU state goes through the CPU for it
+    void Circularize();
+
+    // Switching to the CPU reads the GPU state back once, switching back uploads the CPU state.
+    void SetBackend(AsteroidBackend newBackend);
+
+    AsteroidBackend Backend() const { return backend; }
+
+    // the live asteroids as the GPU has them right now, blocks until the GPU is done with them
+    std::vector<AsteroidData> ReadBack() const;
+
+    struct ParityResult {
+        int count = 0;
+        // asteroids whose position or velocity differ by more than the tolerance
+        int mismatches = 0;
+        float maxPositionError = 0.0f;
+        float maxVelocityError = 0.0f;
+        double gpuMilliseconds = 0.0;
+        double cpuMilliseconds = 0.0;
+
+        bool passed() const { return count > 0 && mismatches == 0; }
+    };
+
+    // Steps the current state steps times on both backends and compares the results, despawn included. The error
+    // is relative to the value for values above 1, float sums still differ between the compilers. The timings are
+    // per step.
+    ParityResult CheckParity(float deltaTime, int steps = 1, float tolerance = 1e-3f);
+
+    // untuned kernels run with this many invocations per workgroup
+    static constexpr int defaultWorkgroupSize = 64;
+    // tuned sizes for this device, loaded in Init
+    WorkgroupSizes workgroupSizes;
+    AsteroidBenchmark benchmark;
+    ParityResult lastParity;
+    // steps of the parity check Init runs and the ImGui button repeats, 0 skips the one in Init
+    int parityCheckSteps = 8;
     
     
+    // live asteroids on the CPU: the initial ones, and the simulation state while the CPU backend runs
     std::vector<AsteroidData> asteroidsData;
+    // slots in every buffer, the live count can grow up to it without reallocating
+    int capacity = 1 << 16;
+    int initialCount = 3000;
+    float ringRadius = 300.0f;
+    float ringSpan = 10.0f;
+    // Buckets of the grid's hash table, rounded up to a power of two. Independent of the asteroid count: more
+    // asteroids than buckets only makes the chains longer, applies from the next Init.
+    int hashTableSize = 1 << 16;
+    // asteroids drifting further out from the center are removed, 0 keeps them forever
+    float despawnRadius = 1000.0f;
+    // what the ImGui spawn button appends
+    int spawnCount = 1000;
+    // simulated time per step, independent of the frame rate
+    float fixedStep = 1.0f / 120.0f;
+    // a hitch costs at most this many steps, the time beyond them is dropped instead of simulated
+    int maxStepsPerFrame = 4;
+    // every fixed step runs at least this many substeps
+    int substeps = 1;
+    // More substeps while the fastest asteroid would move further than the smallest collision body's radius in one,
+    // so nothing passes through another one between two collision tests.
+    bool adaptiveSubsteps = true;
+    int maxSubsteps = 8;
+    // N-body gravity: the asteroids pull on each other and on the way orbit a central body at the origin. Barnes-Hut
+    // over a linear BVH of the Morton sorted asteroids, the gravity kernels or AsteroidCpuSimulation.
+    bool gravity = false;
+    float gravitationalConstant = 1.0f;
+    float centralMass = 5000.0f;
+    // asteroid mass per scale^3
+    float asteroidDensity = 10.0f;
+    // Nodes smaller than this times their distance pull as one body. 0 sums every pair, larger is faster and rougher.
+    float openingAngle = 0.5f;
+    // keeps the pull of close asteroids finite
+    float softening = 1.0f;
+    // the Morton codes cover [-gravityExtent, gravityExtent]^3, the tree just gets looser outside it
+    float gravityExtent = 1000.0f;
+
     std::vector<std::shared_ptr<Texture>> textures;
-    Model asteroidModel = Model(&asteroidModelPath);
+    Model asteroidModel = Model(&asteroidModelPath, false, VertexLayout::Compact());
     Shader *asteroidShader;
 
-    ComputeShader cumputeShaderMovment = ComputeShader(
-            "res/shaders/AsteroidSystem/ComputeShaders/asteroidMovment.glsl");
     ComputeShader cumputeShaderGridCreation = ComputeShader(
             "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridCreation.glsl");
-    ComputeShader cumputeShaderGridSort = ComputeShader(
-            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridSort.glsl");
-    ComputeShader cumputeShaderGridCalculateOffset = ComputeShader(
-            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridCalculateOffset.glsl");
+    ComputeShader cumputeShaderGridScan = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridScan.glsl");
+    ComputeShader cumputeShaderGridScatter = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridScatter.glsl");
     ComputeShader cumputeShaderCollide = ComputeShader(
             "res/shaders/AsteroidSystem/ComputeShaders/asteroidCollision.glsl");
-    ComputeShader cumputeShaderSeperation = ComputeShader(
-            "res/shaders/AsteroidSystem/ComputeShaders/asteroidSeperation.glsl");
+    ComputeShader cumputeShaderAliveScan = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridScan.glsl");
+    ComputeShader cumputeShaderGridSortCells = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGridSortCells.glsl");
+    ComputeShader cumputeShaderCounters = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidCounters.glsl");
+    ComputeShader cumputeShaderEmit = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidEmit.glsl");
+    ComputeShader cumputeShaderGravitySort = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGravitySort.glsl");
+    ComputeShader cumputeShaderGravityBuild = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGravityBuild.glsl");
+    ComputeShader cumputeShaderGravityForce = ComputeShader(
+            "res/shaders/AsteroidSystem/ComputeShaders/asteroidGravityForce.glsl");
 private:
-    int size;
+    float gridRadius = 0.0f;
+    float collisionRadius = 0.0f;
+    AsteroidBuffers buffers;
+    AsteroidBackend backend = AsteroidBackend::GPU;
+    // asteroids asteroidEmit appends at the next GPU update
+    int pendingSpawn = 0;
+    // frame time not simulated yet, less than a fixed step after Update
+    double accumulator = 0.0;
+    int lastSubsteps = 1;
+    // how far back towards the last fixed step's start draw() renders, asteroid_instance.glsl's stepLag
+    float stepLag = 0.0f;
+    // what the next collision dispatch tells the kernel, set by StepGPU
+    bool startsFixedStep = true;
+    // the speed counter of the last step, copied out behind a fence and read once it arrived, never stalls
+    GLuint speedReadback = 0;
+    GLsync speedFence = nullptr;
+    float maxSpeed = 0.0f;
+    uint32_t spawnSeed = 1;
+    static constexpr int emitWorkgroupSize = 64;
+
+    void Emit(int count);
+    // the pool Init got
+    ThreadPool *workers = nullptr;
+    // created the first time it is needed, on workers
+    std::unique_ptr<AsteroidCpuSimulation> cpuSimulation;
+
+    AsteroidCpuSimulation &CpuSimulation();
+
+    // substeps for the next fixed step, from the latest max speed there is
+    int SubstepCount();
+
+    void RequestMaxSpeed();
+
+    void Upload(const std::vector<AsteroidData> &previous = {}) const;
 };
 
 
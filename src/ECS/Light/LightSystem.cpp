@@ -4,6 +4,7 @@
 
 
 #include "LightSystem.h"
+#include <algorithm>
 
 void LightSystem::PushToSSBO() {
 
@@ -81,6 +82,13 @@ void LightSystem::GenerateShadowBuffers() {
     }
 }
 
+void LightSystem::SubmitShaders(ShaderBatch &batch) {
+    batch.add(planeDepthShader);
+    batch.add(cubeDepthShader);
+    batch.add(instancePlaneDepthShader);
+    batch.add(instanceCubeDepthShader);
+}
+
 void LightSystem::Init() {
     planeDepthShader.init();
     cubeDepthShader.init();
@@ -92,32 +100,39 @@ void LightSystem::Init() {
 
 
 int TEXTURE_UNITS_OFFSET = 8;
-int POINT_SHADOW_OFFSET = TEXTURE_UNITS_OFFSET + 5;
+int POINT_SHADOW_OFFSET = TEXTURE_UNITS_OFFSET + LightSystem::maxShadowMaps;
 
 void LightSystem::PushDepthMapsToShader(Shader *shader) { //TODO this should be done throught ILight
     int planeShadowIndex = 0, cubeShadowIndex = 0;
     for (auto &light: lights) {
         if (light->lightType == Point) {
+            // the shaders only have samplers for maxShadowMaps of each kind
+            if (cubeShadowIndex >= maxShadowMaps) continue;
             std::string number = std::to_string(cubeShadowIndex);
             glActiveTexture(GL_TEXTURE0 + TEXTURE_UNITS_OFFSET +
                             cubeShadowIndex); // TEXTURE_UNITS_OFFSET is the number of non-shadow map textures you have
             glBindTexture(GL_TEXTURE_CUBE_MAP, light->depthMap);
-            glUniform1i(glGetUniformLocation(shader->ID, ("cubeShadowMaps[" + number + "]").c_str()),
-                        TEXTURE_UNITS_OFFSET + cubeShadowIndex);
+            glProgramUniform1i(shader->ID, glGetUniformLocation(shader->ID, ("cubeShadowMaps[" + number + "]").c_str()),
+                               TEXTURE_UNITS_OFFSET + cubeShadowIndex);
             cubeShadowIndex++;
         } else {
+            if (planeShadowIndex >= maxShadowMaps) continue;
             std::string number = std::to_string(planeShadowIndex);
             glActiveTexture(GL_TEXTURE0 + POINT_SHADOW_OFFSET +
                             planeShadowIndex); // TEXTURE_UNITS_OFFSET is the number of non-shadow map textures you have
             glBindTexture(GL_TEXTURE_2D, light->depthMap);
-            glUniform1i(glGetUniformLocation(shader->ID, ("planeShadowMaps[" + number + "]").c_str()),
-                        POINT_SHADOW_OFFSET + planeShadowIndex);
+            glProgramUniform1i(shader->ID, glGetUniformLocation(shader->ID, ("planeShadowMaps[" + number + "]").c_str()),
+                               POINT_SHADOW_OFFSET + planeShadowIndex);
             planeShadowIndex++;
         }
 
     }
 }
 
+int LightSystem::MaxLightsPerKind() const {
+    return static_cast<int>(std::max({dirLights.size(), pointLights.size(), spotLights.size()}));
+}
+
 void LightSystem::Update(double deltaTime) {
     int offset = 0;
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, dirLightBufferId);
@@ -18,6 +18,7 @@
 #include "Components/SpotLight.h"
 #include "Camera.h"
 #include "modelLoading/Texture.h"
+#include "modelLoading/ShaderBatch.h"
 #include "../System.h"
 #include "../Component.h"
 
@@ -29,6 +30,9 @@ public:
 
     ~LightSystem();
 
+    // Starts compiling the depth shaders, Init() then only waits for what is still unfinished.
+    void SubmitShaders(ShaderBatch &batch);
+
     void Init();
 
     void PushToSSBO();
@@ -48,6 +52,12 @@ public:
     
     void PushDepthMapsToShader(Shader *shader);
 
+    // lights of the kind with the most of them, what the lighting shaders loop over at most
+    int MaxLightsPerKind() const;
+
+    // shadow maps per kind (cube and plane) the lighting shaders have samplers for, their MAX_LIGHTS
+    static constexpr int maxShadowMaps = 5;
+
     Shader instanceCubeDepthShader = Shader("res/shaders/Shadows/instance_point_shadows_depth.vert",
                                             "res/shaders/Shadows/point_shadows_depth.frag",
                                             "res/shaders/Shadows/point_shadows_depth.geom");
@@ -9,7 +9,11 @@ Render::Render(Model *pModel):pModel(pModel) {
 
 }
 
-void Render::draw(Shader &regularShader) {
-    regularShader.setMatrix4("model", false, glm::value_ptr(getEntity()->transform.getModelMatrix()));
-    pModel->Draw(regularShader);
+void Render::draw(Shader &regularShader, MeshletCuller *culler) {
+    const glm::mat4 &model = getEntity()->transform.getModelMatrix();
+    regularShader.setMatrix4("model", false, glm::value_ptr(model));
+    if (culler != nullptr)
+        pModel->DrawCulled(regularShader, *culler, model, this);
+    else
+        pModel->Draw(regularShader);
 }
\ No newline at end of file
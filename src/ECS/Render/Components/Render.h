@@ -8,11 +8,14 @@
 #include "ECS/Component.h"
 #include "modelLoading/Model.h"
 #include "modelLoading/Shader.h"
+#include "Systems/RenderSystem/Culling/MeshletCuller.h"
 
 class Render : public Component {
 public:
     explicit Render(Model *pModel);
-    void draw(Shader &regularShader);
+    void draw(Shader &regularShader, MeshletCuller *culler = nullptr);
+
+    Model *getModel() const { return pModel; }
 private:
     Model *pModel{};
 };
@@ -3,13 +3,38 @@
 //
 
 #include "RenderSystem.h"
+#include "ECS/Entity.h"
+#include "Systems/RenderSystem/Streaming/TextureStreamer.h"
+#include <cmath>
 
 void RenderSystem::addComponent(void *component) {
     renderComponents.push_back(reinterpret_cast<Render *const>(component));
 }
 
-void RenderSystem::DrawScene(Shader *regularShader) {
+void RenderSystem::DrawScene(Shader *regularShader, MeshletCuller *culler) {
     for (auto &renderComponent: renderComponents) {
-        renderComponent->draw(*regularShader);
+        renderComponent->draw(*regularShader, culler);
+    }
+}
+
+void RenderSystem::RequestTextures(Camera *camera, TextureStreamer &streamer) {
+    // pixels one world unit covers at distance 1
+    float pixelsAtUnitDistance =
+            static_cast<float>(camera->saved_display_h) / (2.0f * std::tan(glm::radians(camera->Zoom) * 0.5f));
+    for (auto &renderComponent: renderComponents) {
+        Model *model = renderComponent->getModel();
+        const glm::mat4 &matrix = renderComponent->getEntity()->transform.getModelMatrix();
+        float scale = glm::max(glm::length(glm::vec3(matrix[0])),
+                               glm::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+        for (const shared_ptr<Mesh> &mesh: model->meshes) {
+            if (mesh->uvDensity <= 0.0f) continue;
+            glm::vec3 center = glm::vec3(matrix * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.0f));
+            float radius = glm::length(mesh->boundsMax - mesh->boundsMin) * 0.5f * scale;
+            // the nearest point of the bounds is where the finest detail is needed
+            float distance = glm::max(glm::length(center - camera->Position) - radius, camera->nearClip);
+            float pixelsPerMeshUnit = pixelsAtUnitDistance * scale / distance;
+            for (const shared_ptr<Texture> &texture: mesh->textures)
+                streamer.Request(texture, mesh->uvDensity / pixelsPerMeshUnit);
+        }
     }
 }
@@ -8,6 +8,9 @@
 
 #include "ECS/System.h"
 #include "Components/Render.h"
+#include "Camera.h"
+
+class TextureStreamer;
 
 class RenderSystem : public System  {
 
@@ -18,7 +21,12 @@ public:
     int getNumComponentTypes() override { return 1;};
     void addComponent(void* component) override;
     
-    void DrawScene(Shader* regularShader);
+    // with a culler every model goes through GPU meshlet culling first, once per MeshletCuller pass
+    void DrawScene(Shader* regularShader, MeshletCuller* culler = nullptr);
+
+    // Texture streaming feedback: how much texture every drawn mesh covers per screen pixel, from its UV density,
+    // its scale and how close its bounds come to the camera.
+    void RequestTextures(Camera* camera, TextureStreamer& streamer);
 
 private:
     std::vector<Render *> renderComponents;
@@ -0,0 +1,172 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "MeshletCuller.h"
+#include "imgui.h"
+#include "glm/gtc/type_ptr.hpp"
+#include <cmath>
+#include <vector>
+
+MeshletCuller::~MeshletCuller() {
+    glDeleteTextures(1, &hiZTexture);
+    for (auto &[key, entry]: visibility) glDeleteBuffers(1, &entry.buffer);
+}
+
+void MeshletCuller::Init() {
+    cullShader.submit();
+    hiZShader.submit();
+}
+
+bool MeshletCuller::Ready() {
+    if (shadersReady) return true;
+    if (!cullShader.ready() || !hiZShader.ready()) return false;
+    cullShader.finish();
+    hiZShader.finish();
+    shadersReady = true;
+    return true;
+}
+
+void MeshletCuller::SetView(Camera *camera) {
+    pass = Pass::Early;
+    frame++;
+    // draws that stopped happening, a few seconds later they start over as if never seen
+    for (auto it = visibility.begin(); it != visibility.end();) {
+        if (frame - it->second.lastUsed > 300) {
+            glDeleteBuffers(1, &it->second.buffer);
+            it = visibility.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    viewProjection = camera->GetProjectionMatrix() * camera->GetViewMatrix();
+    cameraPosition = camera->Position;
+
+    // Gribb-Hartmann: left, right, bottom, top, near, far from the rows of the view projection matrix
+    glm::mat4 m = glm::transpose(viewProjection);
+    frustumPlanes[0] = m[3] + m[0];
+    frustumPlanes[1] = m[3] - m[0];
+    frustumPlanes[2] = m[3] + m[1];
+    frustumPlanes[3] = m[3] - m[1];
+    frustumPlanes[4] = m[3] + m[2];
+    frustumPlanes[5] = m[3] - m[2];
+    for (glm::vec4 &plane: frustumPlanes) plane /= glm::length(glm::vec3(plane));
+}
+
+GLuint MeshletCuller::VisibilityBuffer(const Mesh &mesh, const void *instance) {
+    Visibility &entry = visibility[{instance, &mesh}];
+    entry.lastUsed = frame;
+    if (entry.buffer == 0) {
+        // nothing was visible before the first frame, the late pass tests all of it
+        std::vector<GLuint> zeros(mesh.meshletData.meshlets.size(), 0);
+        glGenBuffers(1, &entry.buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, entry.buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(zeros.size() * sizeof(GLuint)), zeros.data(),
+                     GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    return entry.buffer;
+}
+
+bool MeshletCuller::Cull(Mesh &mesh, const glm::mat4 &model, const void *instance) {
+    // meshes without meshlets are drawn whole in the early pass
+    if (mesh.culledVAO == 0) return pass == Pass::Early;
+    // without occlusion culling the early pass already drew everything
+    if (pass == Pass::Late && !occlusionCulling) return false;
+
+    // count, instanceCount, firstIndex, baseVertex, baseInstance
+    GLuint command[5] = {0, 1, 0, 0, 0};
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mesh.drawCommandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), command);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    float maxScale = glm::max(glm::length(glm::vec3(model[0])),
+                              glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    // cone axes are normals, non-uniform scale bends them the other way than positions
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    auto meshletCount = static_cast<GLuint>(mesh.meshletData.meshlets.size());
+
+    cullShader.use();
+    cullShader.setMatrix4("model", false, glm::value_ptr(model));
+    glUniformMatrix3fv(glGetUniformLocation(cullShader.ID, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    cullShader.setMatrix4("viewProjection", false, glm::value_ptr(viewProjection));
+    glUniform4fv(glGetUniformLocation(cullShader.ID, "frustumPlanes"), 6, glm::value_ptr(frustumPlanes[0]));
+    cullShader.setVec3("cameraPosition", cameraPosition);
+    cullShader.setFloat("maxScale", maxScale);
+    cullShader.setGLuint("meshletCount", meshletCount);
+    cullShader.setBool("frustumCulling", frustumCulling);
+    cullShader.setBool("coneCulling", coneCulling);
+    cullShader.setBool("occlusionCulling", occlusionCulling);
+    cullShader.setBool("latePass", pass == Pass::Late);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    cullShader.setInt("hiZ", 0);
+    glUniform2f(glGetUniformLocation(cullShader.ID, "hiZSize"), (float) hiZWidth, (float) hiZHeight);
+    cullShader.setInt("hiZLevels", hiZLevels);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, mesh.meshletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, mesh.meshletVertexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, mesh.meshletTriangleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, mesh.culledIndexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, mesh.drawCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, VisibilityBuffer(mesh, instance));
+
+    glDispatchCompute(meshletCount, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    return true;
+}
+
+void MeshletCuller::SetUpHiZ(int width, int height) {
+    glDeleteTextures(1, &hiZTexture);
+    hiZWidth = width;
+    hiZHeight = height;
+    hiZLevels = 1 + (int) std::floor(std::log2((float) glm::max(width, height)));
+
+    glGenTextures(1, &hiZTexture);
+    glBindTexture(GL_TEXTURE_2D, hiZTexture);
+    glTexStorage2D(GL_TEXTURE_2D, hiZLevels, GL_R32F, width, height);
+    // never blend depths between texels or levels, the max reduction would be lost
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool MeshletCuller::BuildHiZ(unsigned int depthTexture, int width, int height) {
+    pass = Pass::Late;
+    if (width <= 0 || height <= 0 || !occlusionCulling || !shadersReady) return false;
+    if (hiZTexture == 0 || width != hiZWidth || height != hiZHeight) SetUpHiZ(width, height);
+
+    hiZShader.use();
+    hiZShader.setInt("source", 0);
+    int levelWidth = width, levelHeight = height;
+    for (int level = 0; level < hiZLevels; ++level) {
+        bool firstLevel = level == 0;
+        // level 0 reads the depth buffer, the others the previous pyramid level
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, firstLevel ? depthTexture : hiZTexture);
+        hiZShader.setInt("sourceLevel", firstLevel ? 0 : level - 1);
+        glUniform2i(glGetUniformLocation(hiZShader.ID, "sourceSize"), levelWidth, levelHeight);
+        hiZShader.setBool("firstLevel", firstLevel);
+        if (!firstLevel) {
+            levelWidth = glm::max(1, levelWidth / 2);
+            levelHeight = glm::max(1, levelHeight / 2);
+        }
+        glBindImageTexture(0, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+void MeshletCuller::showImguiOptions() {
+    ImGui::Begin("Meshlet culling");
+    ImGui::Checkbox("Frustum culling", &frustumCulling);
+    ImGui::Checkbox("Cone culling", &coneCulling);
+    ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+    ImGui::End();
+}
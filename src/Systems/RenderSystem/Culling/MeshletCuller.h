@@ -0,0 +1,80 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_MESHLETCULLER_H
+#define REASONABLEGL_MESHLETCULLER_H
+
+
+#include "modelLoading/ComputeShader.h"
+#include "modelLoading/Mesh.h"
+#include "Camera.h"
+#include "glm/glm.hpp"
+#include <map>
+
+// GPU cluster culling: one workgroup per meshlet tests frustum, normal cone and Hi-Z occlusion
+// and appends the surviving triangles into the mesh's culled index buffer + indirect draw command.
+// Occlusion culling takes two passes over the scene every frame. The early pass draws the meshlets that were visible
+// at the end of the last frame, BuildHiZ turns their depth into the pyramid, and the late pass tests every other
+// meshlet against it with this frame's camera and draws the ones that turn out visible. Nothing is tested against
+// another frame's depth, so camera moves don't cull visible meshlets.
+class MeshletCuller {
+public:
+    enum class Pass {
+        Early,
+        Late
+    };
+
+    ~MeshletCuller();
+
+    // Only submits the compute programs, culling stays off until Ready().
+    void Init();
+
+    // Polls the programs and finishes them once the driver is done, never blocks.
+    bool Ready();
+
+    // call once per frame before any Cull, starts the early pass
+    void SetView(Camera *camera);
+
+    // False when the mesh has nothing to draw in the current pass. instance tells apart the draws of one mesh with
+    // different transforms, each keeps its own visibility from the last frame.
+    bool Cull(Mesh &mesh, const glm::mat4 &model, const void *instance);
+
+    // Builds the max depth pyramid from the early pass' depth and starts the late pass. False when there is no late
+    // pass to draw this frame.
+    bool BuildHiZ(unsigned int depthTexture, int width, int height);
+
+    void showImguiOptions();
+
+    ComputeShader cullShader = ComputeShader("res/shaders/Culling/meshletCull.glsl");
+    ComputeShader hiZShader = ComputeShader("res/shaders/Culling/hiZBuild.glsl");
+
+    bool frustumCulling = true;
+    bool coneCulling = true;
+    bool occlusionCulling = true;
+
+private:
+    struct Visibility {
+        GLuint buffer = 0; // one uint per meshlet, 1 if it was visible at the end of the last frame
+        uint64_t lastUsed = 0;
+    };
+
+    void SetUpHiZ(int width, int height);
+
+    GLuint VisibilityBuffer(const Mesh &mesh, const void *instance);
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::vec4 frustumPlanes[6];
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    Pass pass = Pass::Early;
+    uint64_t frame = 0;
+
+    std::map<std::pair<const void *, const Mesh *>, Visibility> visibility;
+
+    unsigned int hiZTexture = 0;
+    int hiZWidth = 0, hiZHeight = 0, hiZLevels = 0;
+    bool shadersReady = false;
+};
+
+
+#endif //REASONABLEGL_MESHLETCULLER_H
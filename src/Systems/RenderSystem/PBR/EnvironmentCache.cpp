@@ -0,0 +1,285 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "EnvironmentCache.h"
+#include "modelLoading/AssetRegistry.h"
+#include "modelLoading/MappedFile.h"
+#include "glad/glad.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    constexpr char magic[4] = {'R', 'G', 'L', 'E'};
+    constexpr uint32_t cacheVersion = 1;
+
+    struct EnvironmentHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t environmentFormat; // GL_RGB16F or the BC6H format
+        uint32_t imageCount;
+    };
+
+    // every face of every level follows as a size and its texels, environment, irradiance, prefilter, BRDF LUT,
+    // the irradiance faces are left out when the bake didn't convolve them
+    struct ImageHeader {
+        uint32_t size;
+        uint32_t padding;
+    };
+
+    constexpr uint32_t halfRGBSize = 3 * 2;
+    constexpr uint32_t halfRGSize = 2 * 2;
+
+    int levelSize(int size, int level) {
+        return std::max(1, size >> level);
+    }
+
+    // the same sampler state BakeEnvironment sets up
+    GLuint createCubemap(int size, int levels, GLenum format, bool mipmapped) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, format, size, size);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    // tightly packed rows in both directions, a 1 texel wide RGB16F level is 6 bytes
+    struct PixelAlignment {
+        GLint pack = 4, unpack = 4;
+
+        PixelAlignment() {
+            glGetIntegerv(GL_PACK_ALIGNMENT, &pack);
+            glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        }
+
+        ~PixelAlignment() {
+            glPixelStorei(GL_PACK_ALIGNMENT, pack);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, unpack);
+        }
+    };
+}
+
+int EnvironmentCache::levelCount(int size) {
+    int levels = 1;
+    while ((size >>= 1) > 0) levels++;
+    return levels;
+}
+
+std::string EnvironmentCache::cachePath(const std::string &hdrPath) {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(AssetRegistry::hash(hdrPath)));
+    return std::string(directory) + name + ".rgle";
+}
+
+uint64_t EnvironmentCache::key(const std::string &hdrPath, const EnvironmentLayout &layout) {
+    MappedFile source(hdrPath);
+    if (!source.valid()) return 0;
+    uint64_t value = AssetRegistry::hash(source.data, source.size);
+    return AssetRegistry::hash(&layout, sizeof(layout), value);
+}
+
+std::shared_ptr<MappedFile> EnvironmentCache::open(const std::string &hdrPath, uint64_t key) {
+    if (key == 0) return nullptr;
+    auto file = std::make_shared<MappedFile>(cachePath(hdrPath));
+    if (!file->valid() || file->size < sizeof(EnvironmentHeader)) return nullptr;
+    EnvironmentHeader header{};
+    memcpy(&header, file->data, sizeof(header));
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != cacheVersion || header.key != key)
+        return nullptr;
+    return file;
+}
+
+bool EnvironmentCache::upload(const MappedFile &file, const EnvironmentLayout &layout, EnvironmentMaps &maps) {
+    EnvironmentHeader header{};
+    memcpy(&header, file.data, sizeof(header));
+    int environmentLevels = levelCount(layout.environmentSize);
+    // the irradiance faces are only there if the bake convolved them
+    uint32_t withoutIrradiance = (environmentLevels + layout.prefilterLevels) * 6 + 1;
+    bool irradiance = header.imageCount == withoutIrradiance + 6;
+    if (!irradiance && header.imageCount != withoutIrradiance) return false;
+
+    // walk the images once up front, a truncated file must not create half the maps
+    std::vector<const uint8_t *> images;
+    std::vector<uint32_t> sizes;
+    size_t cursor = sizeof(EnvironmentHeader);
+    for (uint32_t i = 0; i < header.imageCount; ++i) {
+        ImageHeader image{};
+        if (file.size - cursor < sizeof(image)) return false;
+        memcpy(&image, file.data + cursor, sizeof(image));
+        cursor += sizeof(image);
+        if (file.size - cursor < image.size) return false;
+        images.push_back(file.data + cursor);
+        sizes.push_back(image.size);
+        cursor += image.size;
+    }
+
+    PixelAlignment alignment;
+    bool compressed = header.environmentFormat != GL_RGB16F;
+    size_t image = 0;
+    maps.environment = createCubemap(layout.environmentSize, environmentLevels, header.environmentFormat, true);
+    for (int level = 0; level < environmentLevels; ++level) {
+        int size = levelSize(layout.environmentSize, level);
+        for (int face = 0; face < 6; ++face, ++image) {
+            if (compressed)
+                glCompressedTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size,
+                                          header.environmentFormat, static_cast<GLsizei>(sizes[image]), images[image]);
+            else
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size, GL_RGB, GL_HALF_FLOAT,
+                                images[image]);
+        }
+    }
+
+    if (irradiance) maps.irradiance = createCubemap(layout.irradianceSize, 1, GL_RGB16F, false);
+    for (int face = 0; face < (irradiance ? 6 : 0); ++face, ++image) {
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, layout.irradianceSize, layout.irradianceSize,
+                        GL_RGB, GL_HALF_FLOAT, images[image]);
+    }
+
+    maps.prefilter = createCubemap(layout.prefilterSize, layout.prefilterLevels, GL_RGB16F, true);
+    for (int level = 0; level < layout.prefilterLevels; ++level) {
+        int size = levelSize(layout.prefilterSize, level);
+        for (int face = 0; face < 6; ++face, ++image) {
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size, GL_RGB, GL_HALF_FLOAT,
+                            images[image]);
+        }
+    }
+
+    glGenTextures(1, &maps.brdfLUT);
+    glBindTexture(GL_TEXTURE_2D, maps.brdfLUT);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, layout.brdfLUTSize, layout.brdfLUTSize);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, layout.brdfLUTSize, layout.brdfLUTSize, GL_RG, GL_HALF_FLOAT,
+                    images[image]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+std::vector<uint8_t> EnvironmentCache::capture(EnvironmentMaps &maps, const EnvironmentLayout &layout, uint64_t key) {
+    PixelAlignment alignment;
+    std::vector<uint8_t> bytes(sizeof(EnvironmentHeader));
+    EnvironmentHeader header{};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = cacheVersion;
+    header.key = key;
+    header.environmentFormat = GL_RGB16F;
+
+    auto append = [&](GLenum target, int level, int size, GLenum format, uint32_t texelSize) {
+        ImageHeader image{static_cast<uint32_t>(size) * size * texelSize, 0};
+        size_t offset = bytes.size();
+        bytes.resize(offset + sizeof(image) + image.size);
+        memcpy(bytes.data() + offset, &image, sizeof(image));
+        glGetTexImage(target, level, format, GL_HALF_FLOAT, bytes.data() + offset + sizeof(image));
+        header.imageCount++;
+    };
+
+    int environmentLevels = levelCount(layout.environmentSize);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, maps.environment);
+    for (int level = 0; level < environmentLevels; ++level) {
+        for (int face = 0; face < 6; ++face) {
+            append(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, levelSize(layout.environmentSize, level), GL_RGB,
+                   halfRGBSize);
+        }
+    }
+
+    if (compressEnvironment) {
+        // the driver encodes BC6H while the half float levels are specified, then the encoded blocks replace them
+        GLuint compressed;
+        glGenTextures(1, &compressed);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, compressed);
+        size_t cursor = sizeof(EnvironmentHeader);
+        for (int level = 0; level < environmentLevels; ++level) {
+            int size = levelSize(layout.environmentSize, level);
+            for (int face = 0; face < 6; ++face) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, size,
+                             size, 0, GL_RGB, GL_HALF_FLOAT, bytes.data() + cursor + sizeof(ImageHeader));
+                cursor += sizeof(ImageHeader) + static_cast<size_t>(size) * size * halfRGBSize;
+            }
+        }
+        GLint isCompressed = GL_FALSE;
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_COMPRESSED, &isCompressed);
+        if (isCompressed == GL_TRUE) {
+            std::vector<uint8_t> encoded(sizeof(EnvironmentHeader));
+            for (int level = 0; level < environmentLevels; ++level) {
+                for (int face = 0; face < 6; ++face) {
+                    GLint imageSize = 0;
+                    glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level,
+                                             GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &imageSize);
+                    ImageHeader image{static_cast<uint32_t>(imageSize), 0};
+                    size_t offset = encoded.size();
+                    encoded.resize(offset + sizeof(image) + image.size);
+                    memcpy(encoded.data() + offset, &image, sizeof(image));
+                    glGetCompressedTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level,
+                                            encoded.data() + offset + sizeof(image));
+                }
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glDeleteTextures(1, &maps.environment);
+            maps.environment = compressed;
+            bytes = std::move(encoded);
+            header.environmentFormat = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+        } else {
+            spdlog::info("Driver can't encode BC6H, environment cache stays uncompressed");
+            glDeleteTextures(1, &compressed);
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, maps.irradiance);
+    for (int face = 0; face < (maps.irradiance != 0 ? 6 : 0); ++face) {
+        append(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, layout.irradianceSize, GL_RGB, halfRGBSize);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, maps.prefilter);
+    for (int level = 0; level < layout.prefilterLevels; ++level) {
+        for (int face = 0; face < 6; ++face) {
+            append(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, levelSize(layout.prefilterSize, level), GL_RGB,
+                   halfRGBSize);
+        }
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glBindTexture(GL_TEXTURE_2D, maps.brdfLUT);
+    append(GL_TEXTURE_2D, 0, layout.brdfLUTSize, GL_RG, halfRGSize);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+bool EnvironmentCache::write(const std::string &hdrPath, const std::vector<uint8_t> &bytes) {
+    // write next to the target and rename, a crash mid write must not leave a valid looking entry
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string path = cachePath(hdrPath);
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        spdlog::warn("Failed to write environment cache " + path);
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    out.close();
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        spdlog::warn("Failed to write environment cache " + path + ": " + error.message());
+        return false;
+    }
+    spdlog::info("Baked {} into {} ({} B)", hdrPath, path, bytes.size());
+    return true;
+}
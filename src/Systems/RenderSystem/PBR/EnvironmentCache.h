@@ -0,0 +1,63 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_ENVIRONMENTCACHE_H
+#define REASONABLEGL_ENVIRONMENTCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Capture resolutions of the baked image based lighting, part of the cache key.
+struct EnvironmentLayout {
+    int environmentSize;
+    int irradianceSize;
+    int prefilterSize;
+    int prefilterLevels;
+    int brdfLUTSize;
+};
+
+struct EnvironmentMaps {
+    unsigned int environment = 0;
+    unsigned int irradiance = 0;
+    unsigned int prefilter = 0;
+    unsigned int brdfLUT = 0;
+};
+
+// Baked image based lighting of an HDR: every face and mip of the environment, irradiance and prefilter cubemaps
+// plus the BRDF LUT, stored as the raw half float texels they were rendered to. Entries are keyed by a hash of the
+// HDR file contents and the layout, so a changed source or resolution simply bakes again. The environment cubemap
+// can be stored BC6H compressed by the driver, which also replaces the baked texture to save its memory.
+class EnvironmentCache {
+public:
+    static constexpr const char *directory = "res/cache/environment/";
+
+    static inline bool compressEnvironment = true;
+
+    // Hashes the HDR file, 0 if it can't be read. Callable from any thread.
+    static uint64_t key(const std::string &hdrPath, const EnvironmentLayout &layout);
+
+    // Maps the entry for key, nullptr if there is none or it is stale. Callable from any thread.
+    static std::shared_ptr<MappedFile> open(const std::string &hdrPath, uint64_t key);
+
+    // Creates all maps from an opened entry, GL thread only. maps.irradiance stays 0 if the entry has none.
+    static bool upload(const MappedFile &file, const EnvironmentLayout &layout, EnvironmentMaps &maps);
+
+    // Reads the baked maps back into an entry, GL thread only, a 0 maps.irradiance is left out. With
+    // compressEnvironment maps.environment may be swapped for its compressed copy.
+    static std::vector<uint8_t> capture(EnvironmentMaps &maps, const EnvironmentLayout &layout, uint64_t key);
+
+    // Callable from any thread.
+    static bool write(const std::string &hdrPath, const std::vector<uint8_t> &bytes);
+
+    static std::string cachePath(const std::string &hdrPath);
+
+    static int levelCount(int size);
+};
+
+
+#endif //REASONABLEGL_ENVIRONMENTCACHE_H
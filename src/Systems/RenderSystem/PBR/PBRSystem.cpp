@@ -5,34 +5,81 @@
 
 
 #include "PBRSystem.h"
+#include "modelLoading/AssetLoader.h"
+#include "modelLoading/MappedFile.h"
+#include "ECS/Light/LightSystem.h"
+#include "imgui.h"
+#include <chrono>
+#include <cstring>
+
+namespace {
+    // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
+    glm::mat4 captureProjectionMatrix() {
+        return glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+    }
+
+    const glm::mat4 *captureViewMatrices() {
+        static const glm::mat4 captureViews[] = {
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
+        };
+        return captureViews;
+    }
+}
 
 PBRSystem::PBRSystem(Camera *camera) : camera(camera) {
+    auto bindSamplers = [](Shader &shader) {
+        shader.setInt("irradianceMap", 0);
+        shader.setInt("prefilterMap", 1);
+        shader.setInt("brdfLUT", 2);
+        shader.setInt("albedoMap", 3);
+        shader.setInt("normalMap", 4);
+        shader.setInt("metallicMap", 5);
+        shader.setInt("roughnessMap", 6);
+        shader.setInt("aoMap", 7);
+    };
+    pbrVariants.onCreate = bindSamplers;
+    pbrInstanceVariants.onCreate = bindSamplers;
+}
 
+ShaderDefines PBRSystem::lightingDefines() {
+    return {{"MAX_LIGHTS", std::to_string(LightSystem::maxShadowMaps)}};
 }
 
-void PBRSystem::Init() {
-
-    pbrShader.init();
-    pbrShader.use();
-    pbrShader.setInt("irradianceMap", 0);
-    pbrShader.setInt("prefilterMap", 1);
-    pbrShader.setInt("brdfLUT", 2);
-    pbrShader.setInt("albedoMap", 3);
-    pbrShader.setInt("normalMap", 4);
-    pbrShader.setInt("metallicMap", 5);
-    pbrShader.setInt("roughnessMap", 6);
-    pbrShader.setInt("aoMap", 7);
-
-    pbrInstanceShader.init();
-    pbrInstanceShader.use();
-    pbrInstanceShader.setInt("irradianceMap", 0);
-    pbrInstanceShader.setInt("prefilterMap", 1);
-    pbrInstanceShader.setInt("brdfLUT", 2);
-    pbrInstanceShader.setInt("albedoMap", 3);
-    pbrInstanceShader.setInt("normalMap", 4);
-    pbrInstanceShader.setInt("metallicMap", 5);
-    pbrInstanceShader.setInt("roughnessMap", 6);
-    pbrInstanceShader.setInt("aoMap", 7);
+int PBRSystem::lightCountClass(int lightsPerKind) {
+    for (int bucket: {0, 1, 4, 16})
+        if (lightsPerKind <= bucket) return bucket;
+    return -1;
+}
+
+ShaderDefines PBRSystem::lightingPermutation(bool shadows, bool shIrradiance, int lightsPerKind) {
+    return {{"SHADOWS",           shadows ? "1" : "0"},
+            {"SH_IRRADIANCE",     shIrradiance ? "1" : "0"},
+            {"LIGHT_COUNT_CLASS", std::to_string(lightCountClass(lightsPerKind))}};
+}
+
+void PBRSystem::SubmitShaders(ShaderBatch &batch) {
+    // the map based variant draws until the SH coefficients exist, the SH one from then on
+    for (bool sh: {false, shIrradiance}) {
+        pbrVariants.submit(batch, lightingPermutation(shadows, sh, lightsPerKind));
+        pbrInstanceVariants.submit(batch, lightingPermutation(shadows, sh, lightsPerKind));
+    }
+    batch.add(backgroundShader);
+    batch.add(equirectangularToCubemapShader);
+    // SH lighting never convolves the irradiance cubemap, turning it off later compiles the shader on first use
+    if (!shIrradiance) batch.add(irradianceShader);
+    batch.add(prefilterShader);
+    batch.add(brdfShader);
+    batch.add(irradianceSHShader);
+}
+
+void PBRSystem::Init(AssetLoader *loader) {
+
+    SelectVariants();
 
     backgroundShader.init();
     backgroundShader.use();
@@ -43,37 +90,113 @@ void PBRSystem::Init() {
 
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, environmentLayout.environmentSize,
+                          environmentLayout.environmentSize);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
 
-    // pbr: load the HDR environment map
-    // ---------------------------------
+    // pbr: load the baked maps or the HDR environment map
+    // ---------------------------------------------------
     stbi_set_flip_vertically_on_load(true);
-    int width, height, nrComponents;
-    std::string hdrPath("res/hdr/nebula.hdr");
-    float *data = stbi_loadf(hdrPath.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        glGenTextures(1, &hdrTexture);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT,
-                     data); // note how we specify the texture's data value to be float
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (loader == nullptr) {
+        uint64_t cacheKey = EnvironmentCache::key(hdrPath, environmentLayout);
+        auto cached = EnvironmentCache::open(hdrPath, cacheKey);
+        if (!cached || !loadCachedEnvironment(*cached)) decodeAndBake(nullptr, cacheKey);
+    } else {
+        loader->runOnWorker([this, loader] {
+            // hashing and mapping the entry is file I/O as well, none of it belongs on the GL thread
+            uint64_t cacheKey = EnvironmentCache::key(hdrPath, environmentLayout);
+            auto cached = EnvironmentCache::open(hdrPath, cacheKey);
+            if (!cached) {
+                decodeAndBake(loader, cacheKey);
+                return;
+            }
+            loader->runOnGLThread([this, loader, cached, cacheKey] {
+                if (!loadCachedEnvironment(*cached)) loader->runOnWorker([this, loader, cacheKey] {
+                    decodeAndBake(loader, cacheKey);
+                });
+            });
+        });
+    }
+
+    camera->UpdateShader(pbrInstanceShader, 1920, 1080); // I don't care just hardcode it
+    camera->UpdateShader(&backgroundShader, 1920, 1080); // I don't care just hardcode it
+    camera->UpdateShader(pbrShader, 1920, 1080); // I don't care just hardcode it
+}
+
+void PBRSystem::createHDRTexture(int width, int height, const void *pixels) {
+    glGenTextures(1, &hdrTexture);
+    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT,
+                 pixels); // note how we specify the texture's data value to be float
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
+void PBRSystem::decodeAndBake(AssetLoader *loader, uint64_t cacheKey) {
+    int width, height, nrComponents;
+    float *data = stbi_loadf(hdrPath.c_str(), &width, &height, &nrComponents, 3);
+    if (!data) {
+        spdlog::error("Failed to load HDR image.");
+        return;
+    }
+    if (loader == nullptr) {
+        createHDRTexture(width, height, data);
         stbi_image_free(data);
-    } else {
-        std::cout << "Failed to load HDR image." << std::endl;
+        BakeEnvironment();
+        saveEnvironment(nullptr, cacheKey);
+        return;
     }
+    std::shared_ptr<float> pixels(data, stbi_image_free);
+    size_t size = static_cast<size_t>(width) * height * 3 * sizeof(float);
+    loader->uploadThroughPBO(
+            size, [pixels, size](void *destination) { memcpy(destination, pixels.get(), size); },
+            [this, loader, cacheKey, width, height](const void *staged) {
+                createHDRTexture(width, height, staged);
+                BakeEnvironment();
+                saveEnvironment(loader, cacheKey);
+            });
+}
+
+bool PBRSystem::loadCachedEnvironment(const MappedFile &file) {
+    EnvironmentMaps maps;
+    if (!EnvironmentCache::upload(file, environmentLayout, maps)) {
+        spdlog::warn("Environment cache of " + hdrPath + " is damaged, baking again");
+        return false;
+    }
+    envCubemap = maps.environment;
+    irradianceMap = maps.irradiance;
+    prefilterMap = maps.prefilter;
+    brdfLUTTexture = maps.brdfLUT;
+    ProjectIrradiance();
+    return true;
+}
+
+void PBRSystem::saveEnvironment(AssetLoader *loader, uint64_t cacheKey) {
+    if (cacheKey == 0) return;
+    EnvironmentMaps maps{envCubemap, irradianceMap, prefilterMap, brdfLUTTexture};
+    auto bytes = std::make_shared<std::vector<uint8_t>>(EnvironmentCache::capture(maps, environmentLayout, cacheKey));
+    envCubemap = maps.environment;
+    if (loader == nullptr)
+        EnvironmentCache::write(hdrPath, *bytes);
+    else
+        loader->runOnWorker([this, bytes] { EnvironmentCache::write(hdrPath, *bytes); });
+}
+
+void PBRSystem::BakeEnvironment() {
+    // the bake changes the viewport and framebuffer, put them back for whatever the frame draws next
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
 
     // pbr: setup cubemap to render to and attach to framebuffer
     // ---------------------------------------------------------
     glGenTextures(1, &envCubemap);
     glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     for (unsigned int i = 0; i < 6; ++i) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, environmentLayout.environmentSize,
+                     environmentLayout.environmentSize, 0, GL_RGB, GL_FLOAT, nullptr);
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -82,20 +205,8 @@ void PBRSystem::Init() {
                     GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
-    // ----------------------------------------------------------------------------------------------
-    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-    glm::mat4 captureViews[] =
-            {
-                    glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-                    glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
-                                glm::vec3(0.0f, -1.0f, 0.0f)),
-                    glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-                    glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
-                                glm::vec3(0.0f, 0.0f, -1.0f)),
-                    glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-                    glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
-            };
+    glm::mat4 captureProjection = captureProjectionMatrix();
+    const glm::mat4 *captureViews = captureViewMatrices();
 
     // pbr: convert HDR equirectangular environment map to cubemap equivalent
     // ----------------------------------------------------------------------
@@ -106,7 +217,7 @@ void PBRSystem::Init() {
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, hdrTexture);
 
-    glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
+    glViewport(0, 0, environmentLayout.environmentSize, environmentLayout.environmentSize); // don't forget to configure the viewport to the capture dimensions.
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     for (unsigned int i = 0; i < 6; ++i) {
         equirectangularToCubemapShader.setMatrix4("view", false, glm::value_ptr(captureViews[i]));
@@ -121,50 +232,16 @@ void PBRSystem::Init() {
     glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
     glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
-    // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
-    // --------------------------------------------------------------------------------
-    glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    for (unsigned int i = 0; i < 6; ++i) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
-    // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
-    // -----------------------------------------------------------------------------
-    irradianceShader.init();
-    irradianceShader.use();
-    irradianceShader.setInt("environmentMap", 0);
-    irradianceShader.setMatrix4("projection", false, glm::value_ptr(captureProjection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-    glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i) {
-        irradianceShader.setMatrix4("view", false, glm::value_ptr(captureViews[i]));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap,
-                               0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        renderCube();
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // SH lighting doesn't read the irradiance cubemap, SelectVariants convolves it once SH is turned off
+    if (!shIrradiance) ConvolveIrradiance();
 
     // pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
     // --------------------------------------------------------------------------------
     glGenTextures(1, &prefilterMap);
     glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
     for (unsigned int i = 0; i < 6; ++i) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, environmentLayout.prefilterSize,
+                     environmentLayout.prefilterSize, 0, GL_RGB, GL_FLOAT, nullptr);
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -185,11 +262,11 @@ void PBRSystem::Init() {
     glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
 
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    unsigned int maxMipLevels = 5;
+    unsigned int maxMipLevels = environmentLayout.prefilterLevels;
     for (unsigned int mip = 0; mip < maxMipLevels; ++mip) {
         // reisze framebuffer according to mip-level size.
-        unsigned int mipWidth = static_cast<unsigned int>(128 * std::pow(0.5, mip));
-        unsigned int mipHeight = static_cast<unsigned int>(128 * std::pow(0.5, mip));
+        unsigned int mipWidth = static_cast<unsigned int>(environmentLayout.prefilterSize * std::pow(0.5, mip));
+        unsigned int mipHeight = static_cast<unsigned int>(environmentLayout.prefilterSize * std::pow(0.5, mip));
         glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
         glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
         glViewport(0, 0, mipWidth, mipHeight);
@@ -213,7 +290,8 @@ void PBRSystem::Init() {
 
     // pre-allocate enough memory for the LUT texture.
     glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, environmentLayout.brdfLUTSize, environmentLayout.brdfLUTSize, 0, GL_RG,
+                 GL_FLOAT, 0);
     // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -223,20 +301,152 @@ void PBRSystem::Init() {
     // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
     glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
     glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, environmentLayout.brdfLUTSize,
+                          environmentLayout.brdfLUTSize);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
 
-    glViewport(0, 0, 512, 512);
+    glViewport(0, 0, environmentLayout.brdfLUTSize, environmentLayout.brdfLUTSize);
     brdfShader.init();
     brdfShader.use();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     renderQuad();
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
-    camera->UpdateShader(&pbrInstanceShader, 1920, 1080); // I don't care just hardcode it
-    camera->UpdateShader(&backgroundShader, 1920, 1080); // I don't care just hardcode it
-    camera->UpdateShader(&pbrShader, 1920, 1080); // I don't care just hardcode it
+    ProjectIrradiance();
+}
+
+void PBRSystem::ConvolveIrradiance() {
+    // runs outside the bake as well, in the middle of a frame
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glm::mat4 captureProjection = captureProjectionMatrix();
+    const glm::mat4 *captureViews = captureViewMatrices();
+
+    // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
+    // --------------------------------------------------------------------------------
+    glGenTextures(1, &irradianceMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+    for (unsigned int i = 0; i < 6; ++i) {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, environmentLayout.irradianceSize,
+                     environmentLayout.irradianceSize, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, environmentLayout.irradianceSize,
+                          environmentLayout.irradianceSize);
+
+    // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
+    // -----------------------------------------------------------------------------
+    irradianceShader.init();
+    irradianceShader.use();
+    irradianceShader.setInt("environmentMap", 0);
+    irradianceShader.setMatrix4("projection", false, glm::value_ptr(captureProjection));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+
+    glViewport(0, 0, environmentLayout.irradianceSize, environmentLayout.irradianceSize); // don't forget to configure the viewport to the capture dimensions.
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    for (unsigned int i = 0; i < 6; ++i) {
+        irradianceShader.setMatrix4("view", false, glm::value_ptr(captureViews[i]));
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap,
+                               0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        renderCube();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+int PBRSystem::shSampleLevel() const {
+    int level = 0;
+    while ((environmentLayout.environmentSize >> (level + 1)) >= shSampleSize) level++;
+    return level;
+}
+
+void PBRSystem::ProjectIrradiance() {
+    if (irradianceSHBuffer == 0) {
+        glGenBuffers(1, &irradianceSHBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, irradianceSHBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(IrradianceSH), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    int level = shSampleLevel();
+
+    irradianceSHShader.init();
+    irradianceSHShader.use();
+    irradianceSHShader.setInt("environmentMap", 0);
+    irradianceSHShader.setFloat("sampleLevel", (float) level);
+    irradianceSHShader.setInt("sampleSize", environmentLayout.environmentSize >> level);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, irradianceSHBuffer);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_UNIFORM_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    if (verifySH) {
+        // once per environment, the readback stalls on the projection
+        verifySH = false;
+        VerifyIrradianceSH();
+    }
+}
+
+bool PBRSystem::VerifyIrradianceSH() {
+    if (irradianceSHBuffer == 0) return false;
+    int level = shSampleLevel();
+    int size = environmentLayout.environmentSize >> level;
+
+    std::vector<float> faces[6];
+    const float *facePointers[6];
+    GLint packAlignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+    for (int face = 0; face < 6; ++face) {
+        faces[face].resize(static_cast<size_t>(size) * size * 3);
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, faces[face].data());
+        facePointers[face] = faces[face].data();
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    IrradianceSH reference = SphericalHarmonics::project(facePointers, size);
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    IrradianceSH gpu{};
+    glBindBuffer(GL_UNIFORM_BUFFER, irradianceSHBuffer);
+    glGetBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(gpu), &gpu);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // relative to the largest coefficient, the environment's brightness sets the scale of the error
+    float maxError = 0.0f;
+    float maxCoefficient = 0.0f;
+    for (int k = 0; k < 9; ++k) {
+        glm::vec3 difference = glm::abs(glm::vec3(reference.coefficients[k]) - glm::vec3(gpu.coefficients[k]));
+        glm::vec3 magnitude = glm::abs(glm::vec3(reference.coefficients[k]));
+        maxError = glm::max(maxError, glm::max(difference.x, glm::max(difference.y, difference.z)));
+        maxCoefficient = glm::max(maxCoefficient, glm::max(magnitude.x, glm::max(magnitude.y, magnitude.z)));
+    }
+    shRelativeError = maxError / glm::max(maxCoefficient, 1e-6f);
+    shMatchesCPU = shRelativeError <= shTolerance;
+    if (shMatchesCPU)
+        spdlog::info("SH irradiance: CPU reference of {} texels took {:.3f} ms, relative difference {} within {}",
+                     6 * size * size, milliseconds, shRelativeError, shTolerance);
+    else
+        spdlog::warn("SH irradiance: GPU coefficients are {} off the CPU reference, more than the {} tolerance",
+                     shRelativeError, shTolerance);
+    return shMatchesCPU;
 }
 
 void PBRSystem::renderCube() {
@@ -342,8 +552,17 @@ void PBRSystem::RenderBackground() {
     renderCube();
 }
 
+void PBRSystem::SelectVariants() {
+    // a cached or SH bake has no irradiance cubemap, the map based variants need one
+    if (!shIrradiance && irradianceMap == 0 && envCubemap != 0) ConvolveIrradiance();
+    ShaderDefines permutation = lightingPermutation(shadows, shIrradiance && irradianceSHBuffer != 0, lightsPerKind);
+    pbrShader = &pbrVariants.get(permutation);
+    pbrInstanceShader = &pbrInstanceVariants.get(permutation);
+}
+
 void PBRSystem::PrebindPBR(Camera *camera) {
-    pbrInstanceShader.use();
+    SelectVariants();
+    pbrInstanceShader->use();
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
     glActiveTexture(GL_TEXTURE1);
@@ -351,7 +570,7 @@ void PBRSystem::PrebindPBR(Camera *camera) {
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
 
-    pbrShader.use();
+    pbrShader->use();
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
     glActiveTexture(GL_TEXTURE1);
@@ -359,28 +578,39 @@ void PBRSystem::PrebindPBR(Camera *camera) {
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
 
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, irradianceSHBuffer);
+
     glm::mat4 projection = camera->GetProjectionMatrix();
     glm::mat4 view = camera->GetViewMatrix();
     glm::vec3 cameraPos = camera->Position;
     // float far_plane = camera->farClip;
 
-    pbrInstanceShader.use();
+    pbrInstanceShader->use();
 
-    pbrInstanceShader.setBool("shadows", true);
-    pbrInstanceShader.setMatrix4("projection", false, glm::value_ptr(projection));
-    pbrInstanceShader.setMatrix4("view", false, glm::value_ptr(view));
-    pbrInstanceShader.setVec3("camPos", cameraPos.x, cameraPos.y, cameraPos.z);
-    pbrInstanceShader.setFloat("far_plane", 25.0f);
+    pbrInstanceShader->setMatrix4("projection", false, glm::value_ptr(projection));
+    pbrInstanceShader->setMatrix4("view", false, glm::value_ptr(view));
+    pbrInstanceShader->setVec3("camPos", cameraPos.x, cameraPos.y, cameraPos.z);
+    pbrInstanceShader->setFloat("far_plane", 25.0f);
 
-    pbrShader.use();
-    pbrShader.setBool("shadows", true);
-    pbrShader.setMatrix4("projection", false, glm::value_ptr(projection));
-    pbrShader.setMatrix4("view", false, glm::value_ptr(view));
-    pbrShader.setVec3("camPos", cameraPos.x, cameraPos.y, cameraPos.z);
-    pbrShader.setFloat("far_plane", 25.0f);
+    pbrShader->use();
+    pbrShader->setMatrix4("projection", false, glm::value_ptr(projection));
+    pbrShader->setMatrix4("view", false, glm::value_ptr(view));
+    pbrShader->setVec3("camPos", cameraPos.x, cameraPos.y, cameraPos.z);
+    pbrShader->setFloat("far_plane", 25.0f);
 
     backgroundShader.use();
     backgroundShader.setMatrix4("projection", false, glm::value_ptr(projection));
     backgroundShader.setMatrix4("view", false, glm::value_ptr(view));
 }
 
+void PBRSystem::showImguiOptions() {
+    ImGui::Begin("PBR options");
+    ImGui::Checkbox("Shadows", &shadows);
+    ImGui::Checkbox("SH irradiance", &shIrradiance);
+    if (ImGui::SliderInt("SH sample size", &shSampleSize, 8, environmentLayout.environmentSize)) ProjectIrradiance();
+    if (ImGui::Button("Verify SH against CPU")) VerifyIrradianceSH();
+    if (shRelativeError >= 0.0f)
+        ImGui::Text("SH %s the CPU reference, %.2e relative", shMatchesCPU ? "matches" : "differs from",
+                    shRelativeError);
+    ImGui::End();
+}
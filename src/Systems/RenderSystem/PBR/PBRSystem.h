@@ -7,6 +7,11 @@
 
 
 #include "modelLoading/Shader.h"
+#include "modelLoading/ComputeShader.h"
+#include "modelLoading/ShaderBatch.h"
+#include "modelLoading/ShaderVariants.h"
+#include "EnvironmentCache.h"
+#include "SphericalHarmonics.h"
 #include "Camera.h"
 #include <string>
 #include "stb_image.h"
@@ -16,24 +21,77 @@
 #include "glm/ext/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+class AssetLoader;
+
 class PBRSystem {
 public:
     PBRSystem(Camera *camera);
 
-    void Init();
+    // Starts compiling the lighting and environment baking shaders, Init() and the bake only wait for them.
+    void SubmitShaders(ShaderBatch &batch);
+
+    // Loads the baked maps from the environment cache, otherwise decodes the HDR and bakes them. With a loader both
+    // happen on a worker and the maps are created once uploaded, until then the background and image based lighting
+    // stay black.
+    void Init(AssetLoader *loader = nullptr);
+
+    // Renders the environment cubemap, irradiance, prefilter and BRDF maps from hdrTexture.
+    void BakeEnvironment();
+
+    // Renders irradianceMap from envCubemap, only the map based lighting variants read it.
+    void ConvolveIrradiance();
+
+    // Projects envCubemap into the SH9 irradiance uniform buffer on the GPU, verifying the first projection.
+    void ProjectIrradiance();
+
+    // Runs the CPU reference projection on the same mip, false and a warning if the GPU coefficients are further
+    // than shTolerance off, relative to the largest coefficient.
+    bool VerifyIrradianceSH();
 
     void RenderBackground();
 
+    void showImguiOptions();
+
+    // Picks the lighting variants for the current flags and sets their per frame state.
     void PrebindPBR(Camera *camera);
 
-    Shader pbrInstanceShader = Shader("res/shaders/pbrBloomInstance.vert", "res/shaders/pbrBloomInstance.frag");
-    Shader pbrShader = Shader("res/shaders/pbr.vert", "res/shaders/pbrBloomInstance.frag");
+    // Points pbrShader and pbrInstanceShader at the variants for shadows, shIrradiance and lightsPerKind, compiling
+    // new ones.
+    void SelectVariants();
+
+    // lighting shaders, one specialized program per permutation of the SHADOWS, SH_IRRADIANCE and
+    // LIGHT_COUNT_CLASS defines
+    ShaderVariants pbrInstanceVariants = ShaderVariants("res/shaders/pbrBloomInstance.vert",
+                                                        "res/shaders/pbrBloomInstance.frag", lightingDefines());
+    ShaderVariants pbrVariants = ShaderVariants("res/shaders/pbr.vert", "res/shaders/pbrBloomInstance.frag",
+                                                lightingDefines());
+    // the selected variants, set by Init and PrebindPBR
+    Shader *pbrInstanceShader = nullptr;
+    Shader *pbrShader = nullptr;
     Shader equirectangularToCubemapShader = Shader("res/shaders/cubemap.vert",
                                                    "res/shaders/equirectangular_to_cubemap.frag");
     Shader irradianceShader = Shader("res/shaders/cubemap.vert", "res/shaders/irradiance_convolution.frag");
     Shader prefilterShader = Shader("res/shaders/cubemap.vert", "res/shaders/prefilter.frag");
     Shader brdfShader = Shader("res/shaders/brdf.vert", "res/shaders/brdf.frag");
     Shader backgroundShader = Shader("res/shaders/background.vert", "res/shaders/background.frag");
+    ComputeShader irradianceSHShader = ComputeShader("res/shaders/irradiance_sh.glsl");
+
+    // shadow map lookups in the lighting shaders
+    bool shadows = true;
+    // diffuse IBL from the SH coefficients instead of the irradiance cubemap
+    bool shIrradiance = true;
+    // lights of the most numerous kind, picks the light count class. SubmitShaders precompiles for this value, the
+    // frame sets the real count before PrebindPBR.
+    int lightsPerKind = 1;
+    // resolution of the environment mip the coefficients are projected from
+    int shSampleSize = 64;
+    // largest GPU to CPU coefficient difference VerifyIrradianceSH accepts, relative to the largest coefficient
+    float shTolerance = 1e-3f;
+    // the next projection is checked against the CPU reference
+    bool verifySH = true;
+    // result of the last check, a negative error until one ran
+    float shRelativeError = -1.0f;
+    bool shMatchesCPU = false;
 
 private:
     unsigned int captureFBO;
@@ -51,12 +109,37 @@ private:
     unsigned int quadVAO = 0;
     unsigned int quadVBO;
 
+    void createHDRTexture(int width, int height, const void *pixels);
+
+    // Decodes the HDR and bakes, on a worker with a loader.
+    void decodeAndBake(AssetLoader *loader, uint64_t cacheKey);
+
+    bool loadCachedEnvironment(const MappedFile &file);
+
+    void saveEnvironment(AssetLoader *loader, uint64_t cacheKey);
+
+    static constexpr EnvironmentLayout environmentLayout{512, 32, 128, 5, 512};
+
     Camera *camera;
-    unsigned int envCubemap;
-    unsigned int irradianceMap;
-    unsigned int prefilterMap;
-    unsigned int brdfLUTTexture;
-    unsigned int hdrTexture;
+    std::string hdrPath = "res/hdr/nebula.hdr";
+    unsigned int envCubemap = 0;
+    unsigned int irradianceMap = 0;
+    unsigned int prefilterMap = 0;
+    unsigned int brdfLUTTexture = 0;
+    unsigned int hdrTexture = 0;
+    unsigned int irradianceSHBuffer = 0;
+
+    // mip of envCubemap closest to shSampleSize
+    int shSampleLevel() const;
+
+    // defines every lighting variant shares
+    static ShaderDefines lightingDefines();
+
+    // SHADOWS, SH_IRRADIANCE and LIGHT_COUNT_CLASS for the given flags and light count
+    static ShaderDefines lightingPermutation(bool shadows, bool shIrradiance, int lightsPerKind);
+
+    // smallest bucket of 0, 1, 4 or 16 lights that fits, -1 above that for the loops bounded by the buffers alone
+    static int lightCountClass(int lightsPerKind);
 
 };
 
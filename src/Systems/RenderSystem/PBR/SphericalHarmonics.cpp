@@ -0,0 +1,170 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "SphericalHarmonics.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define REASONABLEGL_SH_SSE
+#endif
+
+namespace {
+    // band normalization of the real SH basis
+    constexpr float basis0 = 0.282095f;
+    constexpr float basis1 = 0.488603f;
+    constexpr float basis2 = 1.092548f;
+    constexpr float basis20 = 0.315392f;
+    constexpr float basis22 = 0.546274f;
+
+    // clamped cosine convolution per band divided by pi: 1, 2/3, 1/4
+    constexpr float bandScale[9] = {1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+
+    void basis(glm::vec3 n, float (&y)[9]) {
+        y[0] = basis0;
+        y[1] = basis1 * n.y;
+        y[2] = basis1 * n.z;
+        y[3] = basis1 * n.x;
+        y[4] = basis2 * n.x * n.y;
+        y[5] = basis2 * n.y * n.z;
+        y[6] = basis20 * (3.0f * n.z * n.z - 1.0f);
+        y[7] = basis2 * n.x * n.z;
+        y[8] = basis22 * (n.x * n.x - n.y * n.y);
+    }
+
+    // one texel: weight is its solid angle, direction not yet normalized
+    void accumulate(int face, float u, float v, float texelArea, const float *rgb, glm::vec3 (&sums)[9],
+                    float &weightSum) {
+        float lengthSquared = 1.0f + u * u + v * v;
+        float inverseLength = 1.0f / std::sqrt(lengthSquared);
+        float weight = texelArea * inverseLength * inverseLength * inverseLength;
+        float y[9];
+        basis(SphericalHarmonics::faceDirection(face, u, v) * inverseLength, y);
+        glm::vec3 color(rgb[0], rgb[1], rgb[2]);
+        for (int k = 0; k < 9; ++k) sums[k] += color * (y[k] * weight);
+        weightSum += weight;
+    }
+
+#ifdef REASONABLEGL_SH_SSE
+    float horizontalSum(__m128 value) {
+        __m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(value, shuffled);
+        shuffled = _mm_movehl_ps(shuffled, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+    }
+
+    // faceDirection for four u's of the same row
+    void faceDirection4(int face, __m128 u, float v, __m128 &x, __m128 &y, __m128 &z) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 vv = _mm_set1_ps(v);
+        switch (face) {
+            case 0: x = one; y = _mm_sub_ps(zero, vv); z = _mm_sub_ps(zero, u); break;
+            case 1: x = _mm_sub_ps(zero, one); y = _mm_sub_ps(zero, vv); z = u; break;
+            case 2: x = u; y = one; z = vv; break;
+            case 3: x = u; y = _mm_sub_ps(zero, one); z = _mm_sub_ps(zero, vv); break;
+            case 4: x = u; y = _mm_sub_ps(zero, vv); z = one; break;
+            default: x = _mm_sub_ps(zero, u); y = _mm_sub_ps(zero, vv); z = _mm_sub_ps(zero, one); break;
+        }
+    }
+#endif
+}
+
+glm::vec3 SphericalHarmonics::faceDirection(int face, float u, float v) {
+    // GL cube map face orientation, u along s and v along t
+    switch (face) {
+        case 0: return {1.0f, -v, -u};
+        case 1: return {-1.0f, -v, u};
+        case 2: return {u, 1.0f, v};
+        case 3: return {u, -1.0f, -v};
+        case 4: return {u, -v, 1.0f};
+        default: return {-u, -v, -1.0f};
+    }
+}
+
+IrradianceSH SphericalHarmonics::project(const float *const faces[6], int size) {
+    glm::vec3 sums[9] = {};
+    float weightSum = 0.0f;
+    float texelStep = 2.0f / static_cast<float>(size);
+    float texelArea = texelStep * texelStep;
+
+#ifdef REASONABLEGL_SH_SSE
+    __m128 red[9], green[9], blue[9];
+    for (int k = 0; k < 9; ++k) red[k] = green[k] = blue[k] = _mm_setzero_ps();
+    __m128 weights = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 area = _mm_set1_ps(texelArea);
+#endif
+
+    for (int face = 0; face < 6; ++face) {
+        for (int row = 0; row < size; ++row) {
+            float v = (static_cast<float>(row) + 0.5f) * texelStep - 1.0f;
+            const float *texels = faces[face] + static_cast<size_t>(row) * size * 3;
+            int column = 0;
+#ifdef REASONABLEGL_SH_SSE
+            for (; column + 4 <= size; column += 4) {
+                __m128 u = _mm_set_ps((column + 3.5f) * texelStep - 1.0f, (column + 2.5f) * texelStep - 1.0f,
+                                      (column + 1.5f) * texelStep - 1.0f, (column + 0.5f) * texelStep - 1.0f);
+                __m128 x, y, z;
+                faceDirection4(face, u, v, x, y, z);
+                __m128 lengthSquared = _mm_add_ps(one, _mm_add_ps(_mm_mul_ps(u, u), _mm_set1_ps(v * v)));
+                // exact division, the cheap reciprocal square root is visibly off next to the GPU result
+                __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+                __m128 weight = _mm_mul_ps(area, _mm_mul_ps(inverseLength, _mm_mul_ps(inverseLength, inverseLength)));
+                x = _mm_mul_ps(x, inverseLength);
+                y = _mm_mul_ps(y, inverseLength);
+                z = _mm_mul_ps(z, inverseLength);
+
+                __m128 basisValues[9];
+                basisValues[0] = _mm_set1_ps(basis0);
+                basisValues[1] = _mm_mul_ps(_mm_set1_ps(basis1), y);
+                basisValues[2] = _mm_mul_ps(_mm_set1_ps(basis1), z);
+                basisValues[3] = _mm_mul_ps(_mm_set1_ps(basis1), x);
+                basisValues[4] = _mm_mul_ps(_mm_set1_ps(basis2), _mm_mul_ps(x, y));
+                basisValues[5] = _mm_mul_ps(_mm_set1_ps(basis2), _mm_mul_ps(y, z));
+                basisValues[6] = _mm_mul_ps(_mm_set1_ps(basis20),
+                                            _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(z, z)), one));
+                basisValues[7] = _mm_mul_ps(_mm_set1_ps(basis2), _mm_mul_ps(x, z));
+                basisValues[8] = _mm_mul_ps(_mm_set1_ps(basis22), _mm_sub_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+
+                const float *t = texels + column * 3;
+                __m128 r = _mm_mul_ps(weight, _mm_set_ps(t[9], t[6], t[3], t[0]));
+                __m128 g = _mm_mul_ps(weight, _mm_set_ps(t[10], t[7], t[4], t[1]));
+                __m128 b = _mm_mul_ps(weight, _mm_set_ps(t[11], t[8], t[5], t[2]));
+                for (int k = 0; k < 9; ++k) {
+                    red[k] = _mm_add_ps(red[k], _mm_mul_ps(r, basisValues[k]));
+                    green[k] = _mm_add_ps(green[k], _mm_mul_ps(g, basisValues[k]));
+                    blue[k] = _mm_add_ps(blue[k], _mm_mul_ps(b, basisValues[k]));
+                }
+                weights = _mm_add_ps(weights, weight);
+            }
+#endif
+            for (; column < size; ++column) {
+                float u = (static_cast<float>(column) + 0.5f) * texelStep - 1.0f;
+                accumulate(face, u, v, texelArea, texels + column * 3, sums, weightSum);
+            }
+        }
+    }
+
+#ifdef REASONABLEGL_SH_SSE
+    for (int k = 0; k < 9; ++k) {
+        sums[k] += glm::vec3(horizontalSum(red[k]), horizontalSum(green[k]), horizontalSum(blue[k]));
+    }
+    weightSum += horizontalSum(weights);
+#endif
+
+    // the texel solid angles only approximately cover the sphere, scale them to exactly 4 pi
+    float normalization = 4.0f * 3.14159265f / weightSum;
+    IrradianceSH sh{};
+    for (int k = 0; k < 9; ++k) sh.coefficients[k] = glm::vec4(sums[k] * (normalization * bandScale[k]), 0.0f);
+    return sh;
+}
+
+glm::vec3 SphericalHarmonics::evaluate(const IrradianceSH &sh, glm::vec3 normal) {
+    float y[9];
+    basis(normal, y);
+    glm::vec3 irradiance(0.0f);
+    for (int k = 0; k < 9; ++k) irradiance += glm::vec3(sh.coefficients[k]) * y[k];
+    return glm::max(irradiance, glm::vec3(0.0f));
+}
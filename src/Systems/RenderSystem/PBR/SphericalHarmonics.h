@@ -0,0 +1,30 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_SPHERICALHARMONICS_H
+#define REASONABLEGL_SPHERICALHARMONICS_H
+
+#include <glm/glm.hpp>
+
+// Diffuse irradiance as the first three spherical harmonics bands, already convolved with the clamped cosine lobe
+// and divided by pi like the irradiance cubemap. Matches the std140 IrradianceSH block in pbrBloomInstance.frag,
+// rgb per coefficient, w unused.
+struct IrradianceSH {
+    glm::vec4 coefficients[9];
+};
+
+class SphericalHarmonics {
+public:
+    // CPU reference of res/shaders/irradiance_sh.glsl, faces are size x size tightly packed RGB floats in
+    // GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order. Four texels of a row are projected at once with SSE where available.
+    static IrradianceSH project(const float *const faces[6], int size);
+
+    static glm::vec3 evaluate(const IrradianceSH &sh, glm::vec3 normal);
+
+    // Direction through the texel center at u, v in [-1, 1] of a cube face, not normalized.
+    static glm::vec3 faceDirection(int face, float u, float v);
+};
+
+
+#endif //REASONABLEGL_SPHERICALHARMONICS_H
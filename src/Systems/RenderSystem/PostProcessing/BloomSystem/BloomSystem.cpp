@@ -38,6 +38,11 @@ void renderQuad() {
 }
 
 
+void BloomSystem::SubmitShaders(ShaderBatch &batch) {
+    batch.add(shaderBlur);
+    batch.add(shaderBloomFinal);
+}
+
 void BloomSystem::Init(int SCR_WIDTH, int SCR_HEIGHT) {
     SetUpBuffers(SCR_WIDTH, SCR_HEIGHT);
     // shader configuration
@@ -110,12 +115,16 @@ void BloomSystem::SetUpBuffers(int SCR_WIDTH, int SCR_HEIGHT) {
         // attach texture to framebuffer
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
     }
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, (GLsizei)SCR_WIDTH, (GLsizei)SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // create and attach depth buffer, a texture so the meshlet culler can build its Hi-Z pyramid from it
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, (GLsizei)SCR_WIDTH, (GLsizei)SCR_HEIGHT, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
     // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
     unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
     glDrawBuffers(2, attachments);
@@ -162,5 +171,6 @@ void BloomSystem::DeleteGPUData() {
     glDeleteFramebuffers(2, pingpongFBO);
     glDeleteTextures(2, colorBuffers);
     glDeleteTextures(2, pingpongColorbuffers);
+    glDeleteTextures(1, &depthTexture);
 }
 
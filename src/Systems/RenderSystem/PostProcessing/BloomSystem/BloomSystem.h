@@ -7,6 +7,7 @@
 
 
 #include "modelLoading/Shader.h"
+#include "modelLoading/ShaderBatch.h"
 #include "Camera.h"
 
 class BloomSystem {
@@ -14,6 +15,8 @@ public:
     ~BloomSystem();
 
 
+    void SubmitShaders(ShaderBatch &batch);
+
     void Init(int SCR_WIDTH, int SCR_HEIGHT);
 
     void BindBuffer();
@@ -30,6 +33,9 @@ public:
                                "res/shaders/BloomSystem/Shaders/blur.frag");
     Shader shaderBloomFinal = Shader("res/shaders/BloomSystem/Shaders/bloom_final.vert",
                                      "res/shaders/BloomSystem/Shaders/bloom_final.frag");
+
+    // depth attachment of the HDR framebuffer
+    unsigned int depthTexture = 0;
 private:
     void DeleteGPUData();
     
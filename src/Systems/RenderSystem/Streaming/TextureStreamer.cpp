@@ -0,0 +1,139 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "TextureStreamer.h"
+#include "modelLoading/AssetLoader.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+void TextureStreamer::Request(const std::shared_ptr<Texture> &texture, float uvPerPixel) {
+    if (texture->streamSource == nullptr || uvPerPixel <= 0.0f) return;
+
+    Streamed &streamed = textures[texture.get()];
+    if (streamed.texture.lock() != texture) {
+        // new, or a dead texture's address got reused
+        streamed = Streamed();
+        streamed.texture = texture;
+        streamed.wantedLevel = texture->startLevel;
+    }
+    // texels per pixel at full resolution, every halving of that is one level further down the chain
+    const TextureSource::Level &top = texture->streamSource->levels[0];
+    float texelsPerPixel = uvPerPixel * std::sqrt(static_cast<float>(top.width) * static_cast<float>(top.height));
+    streamed.requestedLevel = std::min(streamed.requestedLevel, std::log2(std::max(texelsPerPixel, 1e-6f)));
+    streamed.lastRequested = frame;
+}
+
+void TextureStreamer::Update() {
+    struct Plan {
+        Texture *key;
+        std::shared_ptr<Texture> texture;
+        int level;
+    };
+    std::vector<Plan> plans;
+    plans.reserve(textures.size());
+    size_t total = 0;
+    for (auto it = textures.begin(); it != textures.end();) {
+        std::shared_ptr<Texture> texture = it->second.texture.lock();
+        if (texture == nullptr) {
+            it = textures.erase(it);
+            continue;
+        }
+        Streamed &streamed = it->second;
+        if (streamed.lastRequested == frame) {
+            // never coarser than what the texture started with, those levels are always resident
+            streamed.wantedLevel = std::clamp(static_cast<int>(std::floor(streamed.requestedLevel + lodBias)), 0,
+                                              texture->startLevel);
+        } else if (frame - streamed.lastRequested > keepFrames) {
+            streamed.wantedLevel = texture->startLevel;
+        }
+        streamed.requestedLevel = 1e9f;
+        plans.push_back({it->first, texture, streamed.wantedLevel});
+        total += texture->streamedBytes(streamed.wantedLevel);
+        ++it;
+    }
+
+    // over budget: take the finest level off whichever texture has the biggest one, that frees the most memory and
+    // the biggest levels are the ones that are only needed up close
+    while (total > budgetBytes) {
+        Plan *largest = nullptr;
+        size_t largestBytes = 0;
+        for (Plan &plan: plans) {
+            if (plan.level >= plan.texture->startLevel) continue;
+            size_t bytes = plan.texture->streamSource->levels[plan.level].size;
+            if (bytes > largestBytes) {
+                largest = &plan;
+                largestBytes = bytes;
+            }
+        }
+        if (largest == nullptr) break;
+        largest->level++;
+        total -= largestBytes;
+    }
+    wanted = total;
+
+    resident = 0;
+    for (Plan &plan: plans) {
+        Texture &texture = *plan.texture;
+        Streamed &streamed = textures[plan.key];
+        if (!streamed.uploading) {
+            if (plan.level > texture.allocatedLevel) {
+                // dropping levels is a reallocation and a GPU side copy, no need to wait for anything
+                texture.allocateStreamed(plan.level);
+            } else if (plan.level < texture.residentLevel && uploadsInFlight < maxUploadsInFlight) {
+                if (plan.level < texture.allocatedLevel) texture.allocateStreamed(plan.level);
+                // one level at a time, coarse to fine, so every step is usable as soon as it lands
+                streamLevel(plan.texture, streamed, texture.residentLevel - 1);
+            }
+        }
+        // blend freshly streamed levels in instead of popping them
+        if (texture.minLod > static_cast<float>(texture.residentLevel))
+            texture.setMinLod(std::max(static_cast<float>(texture.residentLevel), texture.minLod - fadeSpeed));
+        resident += texture.gpuBytes;
+    }
+    frame++;
+}
+
+void TextureStreamer::streamLevel(const std::shared_ptr<Texture> &texture, Streamed &streamed, int level) {
+    streamed.uploading = true;
+    uploadsInFlight++;
+
+    // the texture isn't reallocated while uploading is set, so the level still has storage once the data arrives
+    Texture *key = texture.get();
+    auto finish = [this, texture, key, level](const unsigned char *base, size_t baseOffset) {
+        texture->uploadStreamedLevel(level, base, baseOffset);
+        auto it = textures.find(key);
+        if (it != textures.end()) it->second.uploading = false;
+        uploadsInFlight--;
+    };
+
+    std::shared_ptr<TextureSource> source = texture->streamSource;
+    if (loader == nullptr) {
+        finish(source->bytes, 0);
+        return;
+    }
+    const TextureSource::Level &data = source->levels[level];
+    size_t offset = data.offset;
+    size_t size = data.size;
+    loader->uploadThroughPBO(
+            size, [source, offset, size](void *destination) { memcpy(destination, source->bytes + offset, size); },
+            [finish, offset](const void *pixels) {
+                // the staged level starts at offset into the chain
+                finish(static_cast<const unsigned char *>(pixels), offset);
+            });
+}
+
+void TextureStreamer::showImguiOptions() {
+    ImGui::Begin("Texture streaming");
+    ImGui::Text("Streamed textures: %zu", textures.size());
+    ImGui::Text("Resident: %.1f MB, wanted: %.1f MB", resident / (1024.0 * 1024.0), wanted / (1024.0 * 1024.0));
+    ImGui::Text("Uploads in flight: %u", uploadsInFlight);
+    float budgetMegabytes = static_cast<float>(budgetBytes / (1024.0 * 1024.0));
+    if (ImGui::SliderFloat("Budget (MB)", &budgetMegabytes, 8.0f, 4096.0f))
+        budgetBytes = static_cast<size_t>(budgetMegabytes * 1024.0 * 1024.0);
+    ImGui::SliderFloat("LOD bias", &lodBias, -2.0f, 4.0f);
+    ImGui::End();
+}
@@ -0,0 +1,63 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_TEXTURESTREAMER_H
+#define REASONABLEGL_TEXTURESTREAMER_H
+
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include "modelLoading/Texture.h"
+
+class AssetLoader;
+
+// Mip streaming for cooked textures. They load with only their low levels (Texture::streamingStartResolution),
+// RenderSystem reports how many texture coordinate units every drawn texture covers per screen pixel, and Update
+// raises or lowers each texture's resident levels to match, within budgetBytes of texture memory. Textures nobody
+// asked for in keepFrames fall back to their start levels.
+class TextureStreamer {
+public:
+    // level uploads go through its PBOs when set, otherwise straight from the mapped cooked file
+    AssetLoader *loader = nullptr;
+
+    size_t budgetBytes = size_t(512) << 20;
+    // added to the computed level, positive saves memory, negative sharpens
+    float lodBias = 0.0f;
+    unsigned int keepFrames = 120;
+    unsigned int maxUploadsInFlight = 4;
+    // chain levels per frame the MIN_LOD clamp moves towards a freshly streamed level
+    float fadeSpeed = 0.1f;
+
+    // uvPerPixel: texture coordinate units one screen pixel covers where the texture is drawn
+    void Request(const std::shared_ptr<Texture> &texture, float uvPerPixel);
+
+    // once per frame after every Request
+    void Update();
+
+    size_t residentBytes() const { return resident; }
+
+    void showImguiOptions();
+
+private:
+    struct Streamed {
+        std::weak_ptr<Texture> texture;
+        // finest level requested this frame, and what the last requests settled on
+        float requestedLevel = 1e9f;
+        int wantedLevel = 0;
+        uint64_t lastRequested = 0;
+        bool uploading = false;
+    };
+
+    void streamLevel(const std::shared_ptr<Texture> &texture, Streamed &streamed, int level);
+
+    std::unordered_map<Texture *, Streamed> textures;
+    uint64_t frame = 0;
+    unsigned int uploadsInFlight = 0;
+    size_t resident = 0;
+    size_t wanted = 0;
+};
+
+
+#endif //REASONABLEGL_TEXTURESTREAMER_H
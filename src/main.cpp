@@ -28,6 +28,11 @@
 
 #include "Systems/RenderSystem/PBR/PBRSystem.h"
 #include "Systems/RenderSystem/PostProcessing/BloomSystem/BloomSystem.h"
+#include "Systems/RenderSystem/Culling/MeshletCuller.h"
+#include "modelLoading/AssetLoader.h"
+#include "modelLoading/AssetRegistry.h"
+#include "modelLoading/ShaderBatch.h"
+#include "Systems/RenderSystem/Streaming/TextureStreamer.h"
 #include "ECS/Light/LightSystem.h"
 #include "ECS/Render/RenderSystem.h"
 #include "Systems/EntitySystem/Scene.h"
@@ -43,7 +48,7 @@
 
 Scene scene;
 string modelPath = "res/models/asteroid/Asteroid.fbx";
-Model model = Model(&modelPath);
+shared_ptr<Model> model;
 
 shared_ptr<spdlog::logger> file_logger;
 #pragma endregion Includes
@@ -76,7 +81,7 @@ void update();
 
 void render();
 
-void render_scene();
+void render_scene(bool culling);
 
 void render_scene_to_depth();
 
@@ -132,6 +137,11 @@ LightSystem lightSystem(&camera);
 PBRSystem pbrSystem(&camera);
 RenderSystem renderSystem;
 BloomSystem bloomSystem;
+MeshletCuller meshletCuller;
+AssetRegistry assetRegistry;
+TextureStreamer textureStreamer;
+// declared after everything it loads into so its workers are joined first
+AssetLoader assetLoader;
 
 
 bool captureMouse = false;
@@ -220,6 +230,9 @@ int main(int, char **) {
 #pragma region Functions
 
 void cleanup() {
+    model.reset();
+    assetRegistry.clear();
+
     //Orginal clean up
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -284,6 +297,7 @@ bool init() {
         spdlog::error("Failed to initialize OpenGL loader!");
         return false;
     }
+    ShaderBatch::configure((GLADloadproc) glfwGetProcAddress);
 
     stbi_set_flip_vertically_on_load(true);
     return true;
@@ -291,23 +305,37 @@ bool init() {
 
 
 void init_systems() {
+    // every program is in flight before the first one is waited on, the driver compiles them side by side
+    ShaderBatch shaderBatch;
+    lightSystem.SubmitShaders(shaderBatch);
+    pbrSystem.SubmitShaders(shaderBatch);
+    bloomSystem.SubmitShaders(shaderBatch);
+    // the culling programs are polled every frame instead, drawing goes unculled until they are linked
+    meshletCuller.Init();
+    // the first frame needs every program of the batch, wait for all of them at once
+    shaderBatch.finish();
+
+    // the Inits' init() calls find their programs already linked
     lightSystem.Init();
-    pbrSystem.Init();
+    assetRegistry.loader = &assetLoader;
+    textureStreamer.loader = &assetLoader;
+    pbrSystem.Init(&assetLoader);
     bloomSystem.Init(camera.saved_display_w, camera.saved_display_h);
     scene.systemManager.addSystem(&lightSystem);
     scene.systemManager.addSystem(&renderSystem);
 }
 
 void load_enteties() {
-    model.loadModel();
+    // entities can reference the model right away, it has no meshes to draw until its uploads ran
+    model = assetRegistry.model(modelPath, VertexLayout::Compact());
     Entity *gameObject = scene.addGameObject();
     gameObject->transform.setLocalPosition({-0, 0, 0});
     const float scale = 10;
     gameObject->transform.setLocalScale({scale, scale, scale});
-    gameObject->addComponent(new Render(&model));
+    gameObject->addComponent(new Render(model.get()));
     for (unsigned int i = 0; i < 2; ++i) {
         gameObject = scene.addGameObject(gameObject);
-        gameObject->addComponent(new Render(&model));
+        gameObject->addComponent(new Render(model.get()));
         gameObject->transform.setLocalScale({scale, scale, scale});
         gameObject->transform.setLocalPosition({5, 0, 0});
         gameObject->transform.setLocalScale({0.2f, 0.2f, 0.2f});
@@ -343,6 +371,9 @@ void before_frame() {
     double currentFrame = glfwGetTime();
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
+
+    assetLoader.processUploads(assetLoader.uploadBudgetMilliseconds);
+    assetRegistry.collectGarbage();
 };
 
 
@@ -365,9 +396,6 @@ void update() {
 void render() {
     render_scene_to_depth();
 
-    lightSystem.PushDepthMapsToShader(&pbrSystem.pbrShader);
-    lightSystem.PushDepthMapsToShader(&pbrSystem.pbrInstanceShader);
-
     glViewport(0, 0, camera.saved_display_w, camera.saved_display_h); // Needed after light generation
 
     bloomSystem.BindBuffer();
@@ -376,13 +404,27 @@ void render() {
 
     file_logger->info("Cleared.");
 
+    pbrSystem.lightsPerKind = lightSystem.MaxLightsPerKind();
     pbrSystem.PrebindPBR(&camera);
+    // after PrebindPBR, it selects the variants the shadow maps go to
+    lightSystem.PushDepthMapsToShader(pbrSystem.pbrShader);
+    lightSystem.PushDepthMapsToShader(pbrSystem.pbrInstanceShader);
     pbrSystem.RenderBackground();
     file_logger->info("Set up PBR.");
 
-    pbrSystem.pbrShader.use();
-
-    render_scene();
+    pbrSystem.pbrShader->use();
+
+    meshletCuller.SetView(&camera);
+    renderSystem.RequestTextures(&camera, textureStreamer);
+    textureStreamer.Update();
+    // until the culling programs are linked everything is drawn unculled
+    bool culling = meshletCuller.Ready();
+    render_scene(culling);
+    // the late culling pass tests the meshlets the early one skipped against the depth it drew
+    if (culling && meshletCuller.BuildHiZ(bloomSystem.depthTexture, camera.saved_display_w, camera.saved_display_h)) {
+        pbrSystem.pbrShader->use();
+        render_scene(culling);
+    }
 
     file_logger->info("Rendered AsteroidsSystem.");
 
@@ -392,8 +434,8 @@ void render() {
 }
 
 
-void render_scene() {
-    renderSystem.DrawScene(&pbrSystem.pbrShader);
+void render_scene(bool culling) {
+    renderSystem.DrawScene(pbrSystem.pbrShader, culling ? &meshletCuller : nullptr);
     file_logger->info("Rendered Entities.");
 }
 
@@ -433,6 +475,11 @@ void imgui_render() {
 
 
     bloomSystem.showImguiOptions();
+    pbrSystem.showImguiOptions();
+    meshletCuller.showImguiOptions();
+    assetLoader.showImguiOptions();
+    assetRegistry.showImguiOptions();
+    textureStreamer.showImguiOptions();
 
 }
 
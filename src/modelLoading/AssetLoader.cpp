@@ -0,0 +1,146 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "AssetLoader.h"
+#include "Texture.h"
+#include "Model.h"
+#include "imgui.h"
+#include <cstring>
+#include <vector>
+
+AssetLoader::AssetLoader(unsigned int workerCount) : pool(workerCount) {
+}
+
+void AssetLoader::runOnWorker(std::function<void()> task) {
+    pool.submit(std::move(task));
+}
+
+void AssetLoader::runOnGLThread(std::function<void()> task) {
+    glTasks.push(std::move(task));
+}
+
+void AssetLoader::processUploads(double budgetMilliseconds) {
+    auto start = std::chrono::steady_clock::now();
+    std::function<void()> task;
+    while (glTasks.pop(task)) {
+        task();
+        if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >=
+            budgetMilliseconds)
+            break;
+    }
+    lastUploadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void AssetLoader::uploadThroughPBO(size_t size, std::function<void(void *destination)> fill,
+                                   std::function<void(const void *pixels)> upload) {
+    runOnGLThread([this, size, fill = std::move(fill), upload = std::move(upload)]() mutable {
+        GLuint pbo;
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
+        void *destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size),
+                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (destination == nullptr) {
+            glDeleteBuffers(1, &pbo);
+            auto staging = std::make_shared<std::vector<uint8_t>>(size);
+            runOnWorker([this, staging, fill = std::move(fill), upload = std::move(upload)]() mutable {
+                fill(staging->data());
+                runOnGLThread([staging, upload = std::move(upload)] { upload(staging->data()); });
+            });
+            return;
+        }
+
+        // the buffer stays mapped while a worker writes it, GL doesn't touch it until it's unmapped
+        runOnWorker([this, pbo, destination, fill = std::move(fill), upload = std::move(upload)]() mutable {
+            fill(destination);
+            runOnGLThread([pbo, upload = std::move(upload)] {
+                GLuint buffer = pbo;
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+                if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE) {
+                    upload(nullptr);
+                } else {
+                    spdlog::warn("Pixel buffer contents were lost while mapped, upload skipped");
+                }
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                glDeleteBuffers(1, &buffer);
+            });
+        });
+    });
+}
+
+AssetHandle<Texture> AssetLoader::loadTexture(const std::string &path, const std::string &type) {
+    auto promise = std::make_shared<std::promise<void>>();
+    AssetHandle<Texture> handle{Texture::deferred(path, type), promise->get_future().share()};
+    pending++;
+
+    std::shared_ptr<Texture> texture = handle.asset;
+    runOnWorker([this, texture, promise, path, type] {
+        auto source = std::make_shared<TextureSource>(TextureSource::load(path, type, &pool));
+        if (!source->valid()) {
+            spdlog::error("Failed to load texture: " + path);
+            runOnGLThread([this, promise] {
+                promise->set_value();
+                pending--;
+            });
+            return;
+        }
+        // streamed textures start without their finest levels, those bytes don't have to be staged
+        size_t skip = source->compressed ? source->levels[Texture::streamingStartLevel(*source)].offset : 0;
+        uploadThroughPBO(
+                source->size - skip,
+                [source, skip](void *destination) {
+                    memcpy(destination, source->bytes + skip, source->size - skip);
+                },
+                [this, texture, source, promise, skip](const void *pixels) {
+                    // staged data starts skip bytes into source.bytes
+                    texture->upload(*source, static_cast<const unsigned char *>(pixels), skip);
+                    promise->set_value();
+                    pending--;
+                });
+    });
+    return handle;
+}
+
+AssetHandle<Model> AssetLoader::loadModel(Model *model) {
+    auto promise = std::make_shared<std::promise<void>>();
+    // the caller owns the model, the handle only points at it
+    AssetHandle<Model> handle{std::shared_ptr<Model>(std::shared_ptr<Model>(), model), promise->get_future().share()};
+    pending++;
+
+    runOnWorker([this, model, promise] {
+        bool imported = model->import(&pool);
+        runOnGLThread([this, model, promise, imported] {
+            if (imported) {
+                uploadNextMesh(model, promise);
+            } else {
+                promise->set_value();
+                pending--;
+            }
+        });
+    });
+    return handle;
+}
+
+void AssetLoader::uploadNextMesh(Model *model, std::shared_ptr<std::promise<void>> promise) {
+    TextureLoadFunction loadTexture = [this](const string &path, const string &type) {
+        return this->loadTexture(path, type).asset;
+    };
+    // one mesh per task keeps big models from eating a whole frame's budget in one go
+    if (model->uploadNextMesh(loadTexture)) {
+        runOnGLThread([this, model, promise] { uploadNextMesh(model, promise); });
+        return;
+    }
+    promise->set_value();
+    pending--;
+}
+
+void AssetLoader::showImguiOptions() {
+    ImGui::Begin("Asset loading");
+    ImGui::Text("Pending loads: %zu", pendingLoads());
+    ImGui::Text("Uploads last frame: %.2f ms", lastUploadMilliseconds);
+    ImGui::SliderFloat("Upload budget (ms)", &uploadBudgetMilliseconds, 0.1f, 16.0f);
+    ImGui::End();
+}
@@ -0,0 +1,83 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_ASSETLOADER_H
+#define REASONABLEGL_ASSETLOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include "ThreadPool.h"
+#include "MPSCQueue.h"
+
+class Texture;
+class Model;
+
+// An asset that is being loaded. asset can be handed around right away, it is only safe to use once ready().
+template<typename T>
+struct AssetHandle {
+    std::shared_ptr<T> asset;
+    std::shared_future<void> done;
+
+    bool valid() const { return asset != nullptr; }
+
+    bool ready() const {
+        return done.valid() && done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    T *get() const { return asset.get(); }
+};
+
+// Loads assets without stalling the GL thread: file I/O, decoding and mesh processing run on a thread pool, the
+// results come back through a lock-free queue that processUploads drains under a time budget every frame. Texture
+// data reaches GL through pixel buffer objects the workers fill.
+class AssetLoader {
+public:
+    explicit AssetLoader(unsigned int workerCount = 0);
+
+    // Texture without GL storage until its upload ran; Model::Draw binds it as an empty texture until then.
+    AssetHandle<Texture> loadTexture(const std::string &path, const std::string &type);
+
+    // Imports on a worker, then uploads one mesh per GL task. The model is owned by the caller and has to outlive
+    // the load. Ready once every mesh exists, its textures can still be streaming in.
+    AssetHandle<Model> loadModel(Model *model);
+
+    void runOnWorker(std::function<void()> task);
+
+    void runOnGLThread(std::function<void()> task);
+
+    // Callable from any thread. Maps a size byte PBO on the GL thread, runs fill into it on a worker and then
+    // upload on the GL thread with the PBO bound to GL_PIXEL_UNPACK_BUFFER and pixels = nullptr (offset 0).
+    // If the PBO can't be mapped fill writes to CPU memory instead and upload gets a pointer to it, unbound.
+    void uploadThroughPBO(size_t size, std::function<void(void *destination)> fill,
+                          std::function<void(const void *pixels)> upload);
+
+    // Runs queued GL work until budgetMilliseconds is used up, at least one task so loading always progresses.
+    // Call once per frame from the GL thread.
+    void processUploads(double budgetMilliseconds);
+
+    size_t pendingLoads() const { return pending.load(std::memory_order_relaxed); }
+
+    void showImguiOptions();
+
+    // the loading workers, other CPU work shares them instead of starting threads of its own
+    ThreadPool &workers() { return pool; }
+
+    float uploadBudgetMilliseconds = 2.0f;
+
+private:
+    void uploadNextMesh(Model *model, std::shared_ptr<std::promise<void>> promise);
+
+    MPSCQueue<std::function<void()>> glTasks;
+    std::atomic<size_t> pending{0};
+    double lastUploadMilliseconds = 0.0;
+    // last member, its workers are joined before the queue they push to goes away
+    ThreadPool pool;
+};
+
+
+#endif //REASONABLEGL_ASSETLOADER_H
@@ -0,0 +1,204 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "AssetRegistry.h"
+#include "AssetLoader.h"
+#include "Model.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace {
+    // keeps the path strings alive, Shader only stores the pointers
+    struct ShaderEntry {
+        std::string vertexPath, fragmentPath, geometryPath;
+        Shader shader;
+
+        ShaderEntry(std::string vertex, std::string fragment, std::string geometry)
+                : vertexPath(std::move(vertex)), fragmentPath(std::move(fragment)),
+                  geometryPath(std::move(geometry)),
+                  shader(vertexPath.c_str(), fragmentPath.c_str(), geometryPath.c_str()) {}
+
+        ~ShaderEntry() { glDeleteProgram(shader.ID); }
+    };
+}
+
+AssetRegistry::Key AssetRegistry::hash(const void *data, size_t size, Key seed) {
+    // FNV-1a over 8 byte words, then the tail bytewise. Fast enough to hash whole vertex streams on a worker.
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    Key value = seed;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        value = (value ^ word) * 1099511628211ull;
+        value ^= value >> 29;
+    }
+    for (; i < size; ++i) value = (value ^ bytes[i]) * 1099511628211ull;
+    return value;
+}
+
+AssetRegistry::Key AssetRegistry::hash(std::string_view text, Key seed) {
+    return hash(text.data(), text.size(), seed);
+}
+
+std::string AssetRegistry::normalizePath(const std::string &path) {
+    std::string unified = path;
+    std::replace(unified.begin(), unified.end(), '\\', '/');
+    return std::filesystem::path(unified).lexically_normal().generic_string();
+}
+
+std::shared_ptr<void> AssetRegistry::find(Key key, const std::string &name) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        misses++;
+        return nullptr;
+    }
+    if (it->second.name != name) {
+        // 64 bit collision, practically never happens, keep the registered asset and load the other one unshared
+        spdlog::warn("Asset key collision between {} and {}", it->second.name, name);
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    it->second.lastUsed = ++useCounter;
+    return it->second.asset;
+}
+
+void AssetRegistry::insert(Key key, Entry entry) {
+    entry.lastUsed = ++useCounter;
+    entries.try_emplace(key, std::move(entry));
+}
+
+std::shared_ptr<Texture> AssetRegistry::texture(const std::string &path, const std::string &type) {
+    std::string name = "texture:" + normalizePath(path) + "|" + type;
+    Key key = hash(name);
+    if (auto existing = find(key, name)) return std::static_pointer_cast<Texture>(existing);
+
+    Entry entry;
+    std::shared_ptr<Texture> texture;
+    if (loader != nullptr) {
+        AssetHandle<Texture> handle = loader->loadTexture(path, type);
+        texture = handle.asset;
+        entry.loading = handle.done;
+    } else {
+        texture = std::make_shared<Texture>(path, type);
+    }
+    entry.asset = texture;
+    entry.name = name;
+    entry.bytes = [texture = texture.get()] { return texture->gpuBytes; };
+    insert(key, std::move(entry));
+    return texture;
+}
+
+std::shared_ptr<Model> AssetRegistry::model(const std::string &path, VertexLayout layout, bool gamma) {
+    // the same file with another layout is different GPU data
+    uint32_t settings[] = {
+            static_cast<uint32_t>(layout.positionFormat),
+            layout.octahedralNormals,
+            layout.halfTexCoords,
+            layout.skinning,
+            gamma,
+    };
+    std::string name = "model:" + normalizePath(path);
+    Key key = hash(settings, sizeof(settings), hash(name));
+    if (auto existing = find(key, name)) return std::static_pointer_cast<Model>(existing);
+
+    auto model = std::make_shared<Model>(path, gamma, layout);
+    model->registry = this;
+    Entry entry;
+    if (loader != nullptr) {
+        entry.loading = loader->loadModel(model.get()).done;
+    } else {
+        model->loadModel();
+    }
+    entry.asset = model;
+    entry.name = name;
+    // meshes and textures are registered on their own, the model itself holds no GPU memory
+    entry.bytes = [] { return size_t(0); };
+    insert(key, std::move(entry));
+    return model;
+}
+
+std::shared_ptr<Shader> AssetRegistry::shader(const std::string &vertexPath, const std::string &fragmentPath,
+                                              const std::string &geometryPath) {
+    std::string name = "shader:" + normalizePath(vertexPath) + "|" + normalizePath(fragmentPath) + "|" +
+                       (geometryPath.empty() ? "" : normalizePath(geometryPath));
+    Key key = hash(name);
+    if (auto existing = find(key, name)) return std::static_pointer_cast<Shader>(existing);
+
+    auto holder = std::make_shared<ShaderEntry>(vertexPath, fragmentPath, geometryPath);
+    if (geometryPath.empty())
+        holder->shader.init();
+    else
+        holder->shader.initWithGeometry();
+    // points at the shader, owns the whole entry
+    std::shared_ptr<Shader> shader(holder, &holder->shader);
+
+    Entry entry;
+    entry.asset = shader;
+    entry.name = name;
+    entry.bytes = [] { return size_t(0); };
+    insert(key, std::move(entry));
+    return shader;
+}
+
+std::shared_ptr<Mesh> AssetRegistry::mesh(Key contentKey, const std::function<std::shared_ptr<Mesh>()> &create) {
+    std::string name = "mesh:" + std::to_string(contentKey);
+    if (auto existing = find(contentKey, name)) return std::static_pointer_cast<Mesh>(existing);
+
+    std::shared_ptr<Mesh> mesh = create();
+    Entry entry;
+    entry.asset = mesh;
+    entry.name = name;
+    entry.bytes = [mesh = mesh.get()] { return mesh->gpuBytes; };
+    insert(contentKey, std::move(entry));
+    return mesh;
+}
+
+void AssetRegistry::collectGarbage() {
+    resident = 0;
+    for (auto &[key, entry]: entries) resident += entry.bytes();
+    if (resident <= budgetBytes) return;
+
+    // evicting a model releases its meshes and those their textures, so keep going while that frees up more
+    std::vector<std::pair<uint64_t, Key>> candidates;
+    bool evicted = true;
+    while (resident > budgetBytes && evicted) {
+        evicted = false;
+        candidates.clear();
+        for (auto &[key, entry]: entries) {
+            bool loaded = !entry.loading.valid() ||
+                          entry.loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            if (entry.asset.use_count() == 1 && loaded) candidates.emplace_back(entry.lastUsed, key);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (auto &[lastUsed, key]: candidates) {
+            if (resident <= budgetBytes) break;
+            auto it = entries.find(key);
+            resident -= std::min(resident, it->second.bytes());
+            entries.erase(it);
+            evictions++;
+            evicted = true;
+        }
+    }
+}
+
+void AssetRegistry::clear() {
+    entries.clear();
+    resident = 0;
+}
+
+void AssetRegistry::showImguiOptions() {
+    ImGui::Begin("Asset registry");
+    ImGui::Text("Assets: %zu", entries.size());
+    ImGui::Text("Resident: %.1f MB", resident / (1024.0 * 1024.0));
+    float budgetMegabytes = static_cast<float>(budgetBytes / (1024.0 * 1024.0));
+    if (ImGui::SliderFloat("Budget (MB)", &budgetMegabytes, 16.0f, 8192.0f))
+        budgetBytes = static_cast<size_t>(budgetMegabytes * 1024.0 * 1024.0);
+    ImGui::Text("Hits: %zu, misses: %zu, evictions: %zu", hits, misses, evictions);
+    ImGui::End();
+}
@@ -0,0 +1,89 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_ASSETREGISTRY_H
+#define REASONABLEGL_ASSETREGISTRY_H
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "VertexLayout.h"
+
+class AssetLoader;
+class Texture;
+class Model;
+class Mesh;
+class Shader;
+
+// Engine wide cache of every loaded model, mesh, texture and shader. Assets are found through 64 bit hashes of their
+// normalized path and load settings (meshes through a hash of their contents), so asking twice for the same asset is
+// one map lookup and the GPU holds it once. The returned shared_ptrs are the reference counts: assets only the
+// registry still holds are evicted, least recently used first, once residentBytes goes over budgetBytes.
+// Use from the GL thread only.
+class AssetRegistry {
+public:
+    using Key = uint64_t;
+
+    // when set, textures and models load asynchronously through it
+    AssetLoader *loader = nullptr;
+
+    size_t budgetBytes = size_t(1) << 30;
+
+    static Key hash(const void *data, size_t size, Key seed = 14695981039346656037ull);
+
+    static Key hash(std::string_view text, Key seed = 14695981039346656037ull);
+
+    // separators unified and ./.. resolved, so different spellings of one file share a key
+    static std::string normalizePath(const std::string &path);
+
+    std::shared_ptr<Texture> texture(const std::string &path, const std::string &type);
+
+    std::shared_ptr<Model> model(const std::string &path, VertexLayout layout = VertexLayout::Full(),
+                                 bool gamma = false);
+
+    // geometryPath can be empty
+    std::shared_ptr<Shader> shader(const std::string &vertexPath, const std::string &fragmentPath,
+                                   const std::string &geometryPath = "");
+
+    // The mesh already registered under contentKey, otherwise the one create makes.
+    std::shared_ptr<Mesh> mesh(Key contentKey, const std::function<std::shared_ptr<Mesh>()> &create);
+
+    // Evicts unreferenced assets until the resident size fits the budget. Call once per frame.
+    void collectGarbage();
+
+    // Drops every registered asset, call before the GL context goes away.
+    void clear();
+
+    size_t residentBytes() const { return resident; }
+
+    void showImguiOptions();
+
+private:
+    struct Entry {
+        std::shared_ptr<void> asset;
+        std::string name;
+        // GPU bytes, asked on every collection since uploads finish after registration. Captures the asset by raw
+        // pointer: another shared_ptr would keep use_count above 1 and the asset would never look unreferenced.
+        std::function<size_t()> bytes;
+        // evicting something that is still loading would pull it out from under the loader
+        std::shared_future<void> loading;
+        uint64_t lastUsed = 0;
+    };
+
+    std::shared_ptr<void> find(Key key, const std::string &name);
+
+    void insert(Key key, Entry entry);
+
+    std::unordered_map<Key, Entry> entries;
+    uint64_t useCounter = 0;
+    size_t resident = 0;
+    size_t hits = 0, misses = 0, evictions = 0;
+};
+
+
+#endif //REASONABLEGL_ASSETREGISTRY_H
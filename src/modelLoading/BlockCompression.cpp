@@ -0,0 +1,383 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    template<int N>
+    float distanceSquared(const float *a, const float *b) {
+        float sum = 0.0f;
+        for (int c = 0; c < N; ++c) sum += (a[c] - b[c]) * (a[c] - b[c]);
+        return sum;
+    }
+
+    template<int N>
+    float length(const float *v) {
+        float sum = 0.0f;
+        for (int c = 0; c < N; ++c) sum += v[c] * v[c];
+        return std::sqrt(sum);
+    }
+
+    // endpoints at the extremes of the block's principal axis
+    template<int N>
+    void principalEndpoints(const float pixels[16][N], float e0[N], float e1[N]) {
+        float mean[N] = {};
+        float minimum[N], maximum[N];
+        for (int c = 0; c < N; ++c) minimum[c] = maximum[c] = pixels[0][c];
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < N; ++c) {
+                mean[c] += pixels[i][c] / 16.0f;
+                minimum[c] = std::min(minimum[c], pixels[i][c]);
+                maximum[c] = std::max(maximum[c], pixels[i][c]);
+            }
+        }
+
+        float covariance[N][N] = {};
+        for (int i = 0; i < 16; ++i) {
+            for (int a = 0; a < N; ++a) {
+                for (int b = 0; b < N; ++b) covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+            }
+        }
+
+        // power iteration, the bounding box diagonal is a good starting guess
+        float axis[N];
+        for (int c = 0; c < N; ++c) axis[c] = maximum[c] - minimum[c];
+        for (int iteration = 0; iteration < 8; ++iteration) {
+            float next[N] = {};
+            for (int a = 0; a < N; ++a) {
+                for (int b = 0; b < N; ++b) next[a] += covariance[a][b] * axis[b];
+            }
+            float nextLength = length<N>(next);
+            if (nextLength < 1e-6f) break;
+            for (int c = 0; c < N; ++c) axis[c] = next[c] / nextLength;
+        }
+        float axisLength = length<N>(axis);
+        if (axisLength < 1e-6f) {
+            for (int c = 0; c < N; ++c) e0[c] = e1[c] = mean[c];
+            return;
+        }
+        for (int c = 0; c < N; ++c) axis[c] /= axisLength;
+
+        float tMin = 0.0f, tMax = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            float t = 0.0f;
+            for (int c = 0; c < N; ++c) t += (pixels[i][c] - mean[c]) * axis[c];
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+        for (int c = 0; c < N; ++c) {
+            e0[c] = std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+            e1[c] = std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+        }
+    }
+
+    // least squares endpoints for fixed interpolation weights (weight of e1 per pixel), false if degenerate
+    template<int N>
+    bool refineEndpoints(const float pixels[16][N], const float weights[16], float e0[N], float e1[N]) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[N] = {}, bx[N] = {};
+        for (int i = 0; i < 16; ++i) {
+            float a = 1.0f - weights[i], b = weights[i];
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < N; ++c) {
+                ax[c] += a * pixels[i][c];
+                bx[c] += b * pixels[i][c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f) return false;
+        for (int c = 0; c < N; ++c) {
+            e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+            e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    uint16_t pack565(const float color[3]) {
+        auto r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+        auto g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+        auto b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+        return static_cast<uint16_t>(r << 11 | g << 5 | b);
+    }
+
+    void unpack565(uint16_t packed, float color[3]) {
+        unsigned int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+        color[0] = static_cast<float>(r << 3 | r >> 2);
+        color[1] = static_cast<float>(g << 2 | g >> 4);
+        color[2] = static_cast<float>(b << 3 | b >> 2);
+    }
+
+    // BC1 4 color mode: index 0 = c0, 1 = c1, 2 = 2/3 c0 + 1/3 c1, 3 = 1/3 c0 + 2/3 c1
+    constexpr float bc1Weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+    float fitBC1(const float pixels[16][3], uint16_t c0, uint16_t c1, uint8_t indices[16]) {
+        float palette[4][3];
+        unpack565(c0, palette[0]);
+        unpack565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        float error = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            float best = distanceSquared<3>(pixels[i], palette[0]);
+            indices[i] = 0;
+            for (uint8_t k = 1; k < 4; ++k) {
+                float distance = distanceSquared<3>(pixels[i], palette[k]);
+                if (distance < best) {
+                    best = distance;
+                    indices[i] = k;
+                }
+            }
+            error += best;
+        }
+        return error;
+    }
+
+    constexpr int bc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // 7 bit endpoint + shared p-bit, picks the p-bit with the smaller quantization error
+    void quantizeBC7(const float endpoint[4], uint8_t quantized[4], uint8_t &pBit) {
+        float bestError = -1.0f;
+        for (uint8_t p = 0; p < 2; ++p) {
+            uint8_t candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c) {
+                long value = std::lround((endpoint[c] - p) / 2.0f);
+                candidate[c] = static_cast<uint8_t>(std::clamp(value, 0l, 127l));
+                float reconstructed = static_cast<float>(candidate[c] << 1 | p);
+                error += (reconstructed - endpoint[c]) * (reconstructed - endpoint[c]);
+            }
+            if (bestError < 0.0f || error < bestError) {
+                bestError = error;
+                pBit = p;
+                memcpy(quantized, candidate, 4);
+            }
+        }
+    }
+
+    float fitBC7(const float pixels[16][4], const uint8_t q0[4], uint8_t p0, const uint8_t q1[4], uint8_t p1,
+                 uint8_t indices[16]) {
+        float palette[16][4];
+        for (int k = 0; k < 16; ++k) {
+            for (int c = 0; c < 4; ++c) {
+                int a = q0[c] << 1 | p0, b = q1[c] << 1 | p1;
+                palette[k][c] = static_cast<float>(((64 - bc7Weights[k]) * a + bc7Weights[k] * b + 32) >> 6);
+            }
+        }
+        float error = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            float best = distanceSquared<4>(pixels[i], palette[0]);
+            indices[i] = 0;
+            for (uint8_t k = 1; k < 16; ++k) {
+                float distance = distanceSquared<4>(pixels[i], palette[k]);
+                if (distance < best) {
+                    best = distance;
+                    indices[i] = k;
+                }
+            }
+            error += best;
+        }
+        return error;
+    }
+
+    struct BitWriter {
+        uint8_t *out;
+        int position = 0;
+
+        void write(uint32_t value, int bits) {
+            for (int b = 0; b < bits; ++b, ++position) {
+                if (value >> b & 1u) out[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+            }
+        }
+    };
+}
+
+size_t BlockCompression::blockSize(BlockFormat format) {
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t BlockCompression::imageSize(BlockFormat format, int width, int height) {
+    return static_cast<size_t>((width + 3) / 4) * static_cast<size_t>((height + 3) / 4) * blockSize(format);
+}
+
+void BlockCompression::encodeBC1(const uint8_t rgba[64], uint8_t out[8]) {
+    float pixels[16][3];
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) pixels[i][c] = rgba[i * 4 + c];
+    }
+
+    float e0[3], e1[3];
+    principalEndpoints<3>(pixels, e0, e1);
+    uint16_t c0 = pack565(e0), c1 = pack565(e1);
+    uint8_t indices[16];
+    float error = fitBC1(pixels, c0, c1, indices);
+
+    float weights[16];
+    for (int i = 0; i < 16; ++i) weights[i] = bc1Weights[indices[i]];
+    if (refineEndpoints<3>(pixels, weights, e0, e1)) {
+        uint16_t r0 = pack565(e0), r1 = pack565(e1);
+        uint8_t refined[16];
+        if (fitBC1(pixels, r0, r1, refined) < error) {
+            c0 = r0;
+            c1 = r1;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    // c0 > c1 selects the 4 color mode, swapping the endpoints swaps index 0/1 and 2/3
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (uint8_t &index: indices) index ^= 1;
+    } else if (c0 == c1) {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t packedIndices = 0;
+    for (int i = 0; i < 16; ++i) packedIndices |= static_cast<uint32_t>(indices[i]) << (i * 2);
+    out[0] = static_cast<uint8_t>(c0 & 0xFF);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1 & 0xFF);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int b = 0; b < 4; ++b) out[4 + b] = static_cast<uint8_t>(packedIndices >> (b * 8));
+}
+
+void BlockCompression::encodeBC4(const uint8_t values[16], uint8_t out[8]) {
+    uint8_t low = values[0], high = values[0];
+    for (int i = 1; i < 16; ++i) {
+        low = std::min(low, values[i]);
+        high = std::max(high, values[i]);
+    }
+
+    // high > low selects the 8 value mode: 0 = high, 1 = low, 2..7 blend from high to low
+    int palette[8] = {high, low};
+    for (int k = 2; k < 8; ++k) palette[k] = ((8 - k) * high + (k - 1) * low + 3) / 7;
+
+    uint64_t packedIndices = 0;
+    if (high != low) {
+        for (int i = 0; i < 16; ++i) {
+            uint64_t best = 0;
+            for (uint64_t k = 1; k < 8; ++k) {
+                if (std::abs(palette[k] - values[i]) < std::abs(palette[best] - values[i])) best = k;
+            }
+            packedIndices |= best << (i * 3);
+        }
+    }
+    out[0] = high;
+    out[1] = low;
+    for (int b = 0; b < 6; ++b) out[2 + b] = static_cast<uint8_t>(packedIndices >> (b * 8));
+}
+
+void BlockCompression::encodeBC7(const uint8_t rgba[64], uint8_t out[16]) {
+    float pixels[16][4];
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 4; ++c) pixels[i][c] = rgba[i * 4 + c];
+    }
+
+    float e0[4], e1[4];
+    principalEndpoints<4>(pixels, e0, e1);
+    uint8_t q0[4], q1[4], p0, p1;
+    quantizeBC7(e0, q0, p0);
+    quantizeBC7(e1, q1, p1);
+    uint8_t indices[16];
+    float error = fitBC7(pixels, q0, p0, q1, p1, indices);
+
+    float weights[16];
+    for (int i = 0; i < 16; ++i) weights[i] = static_cast<float>(bc7Weights[indices[i]]) / 64.0f;
+    if (refineEndpoints<4>(pixels, weights, e0, e1)) {
+        uint8_t r0[4], r1[4], rp0, rp1, refined[16];
+        quantizeBC7(e0, r0, rp0);
+        quantizeBC7(e1, r1, rp1);
+        if (fitBC7(pixels, r0, rp0, r1, rp1, refined) < error) {
+            memcpy(q0, r0, 4);
+            memcpy(q1, r1, 4);
+            p0 = rp0;
+            p1 = rp1;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    // the anchor index is stored with 3 bits, its top bit has to be 0
+    if (indices[0] & 8) {
+        std::swap_ranges(q0, q0 + 4, q1);
+        std::swap(p0, p1);
+        for (uint8_t &index: indices) index = 15 - index;
+    }
+
+    memset(out, 0, 16);
+    BitWriter writer{out};
+    writer.write(1u << 6, 7); // mode 6
+    for (int c = 0; c < 4; ++c) {
+        writer.write(q0[c], 7);
+        writer.write(q1[c], 7);
+    }
+    writer.write(p0, 1);
+    writer.write(p1, 1);
+    writer.write(indices[0], 3);
+    for (int i = 1; i < 16; ++i) writer.write(indices[i], 4);
+}
+
+std::vector<uint8_t> BlockCompression::encode(BlockFormat format, const uint8_t *rgba, int width, int height,
+                                              ThreadPool *pool) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t size = blockSize(format);
+    std::vector<uint8_t> result(static_cast<size_t>(blocksX) * blocksY * size);
+
+    auto encodeRows = [&](int firstRow, int lastRow) {
+        uint8_t block[64], channel[16];
+        for (int by = firstRow; by < lastRow; ++by) {
+            for (int bx = 0; bx < blocksX; ++bx) {
+                for (int y = 0; y < 4; ++y) {
+                    for (int x = 0; x < 4; ++x) {
+                        int sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+                        memcpy(&block[(y * 4 + x) * 4], &rgba[(static_cast<size_t>(sy) * width + sx) * 4], 4);
+                    }
+                }
+                uint8_t *out = &result[(static_cast<size_t>(by) * blocksX + bx) * size];
+                auto extract = [&](int c) {
+                    for (int i = 0; i < 16; ++i) channel[i] = block[i * 4 + c];
+                    return channel;
+                };
+                switch (format) {
+                    case BlockFormat::BC1:
+                        encodeBC1(block, out);
+                        break;
+                    case BlockFormat::BC3:
+                        encodeBC4(extract(3), out);
+                        encodeBC1(block, out + 8);
+                        break;
+                    case BlockFormat::BC4:
+                        encodeBC4(extract(0), out);
+                        break;
+                    case BlockFormat::BC5:
+                        encodeBC4(extract(0), out);
+                        encodeBC4(extract(1), out + 8);
+                        break;
+                    case BlockFormat::BC7:
+                        encodeBC7(block, out);
+                        break;
+                }
+            }
+        }
+    };
+
+    // rows of blocks are independent
+    constexpr int rowsPerTask = 8;
+    int tasks = (blocksY + rowsPerTask - 1) / rowsPerTask;
+    if (pool == nullptr || tasks <= 1) {
+        encodeRows(0, blocksY);
+        return result;
+    }
+    pool->parallelFor(static_cast<size_t>(tasks), [&](size_t task) {
+        int firstRow = static_cast<int>(task) * rowsPerTask;
+        encodeRows(firstRow, std::min(firstRow + rowsPerTask, blocksY));
+    });
+    return result;
+}
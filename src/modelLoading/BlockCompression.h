@@ -0,0 +1,45 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_BLOCKCOMPRESSION_H
+#define REASONABLEGL_BLOCKCOMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+enum class BlockFormat : uint32_t {
+    BC1 = 1, // RGB, 8 bytes per 4x4 block
+    BC3 = 3, // RGBA, BC1 colors + BC4 alpha, 16 bytes
+    BC4 = 4, // R, 8 bytes
+    BC5 = 5, // RG, two BC4 blocks, 16 bytes
+    BC7 = 7  // RGBA, mode 6 only, 16 bytes
+};
+
+// CPU block encoders for the cooked texture format. They aim for reasonable quality at cooking speed:
+// endpoints come from the principal axis of the block, refined once by least squares.
+class BlockCompression {
+public:
+    static size_t blockSize(BlockFormat format);
+
+    // Bytes of a width x height image, partial blocks at the edges count as full ones.
+    static size_t imageSize(BlockFormat format, int width, int height);
+
+    // rgba: width * height * 4 bytes. Edge blocks repeat the last row/column. Rows of blocks spread over pool when
+    // given, the calling thread encodes along, so a task of the same pool can call it.
+    static std::vector<uint8_t> encode(BlockFormat format, const uint8_t *rgba, int width, int height,
+                                       ThreadPool *pool = nullptr);
+
+    // single blocks, pixels in row major order
+    static void encodeBC1(const uint8_t rgba[64], uint8_t out[8]);
+
+    static void encodeBC4(const uint8_t values[16], uint8_t out[8]);
+
+    static void encodeBC7(const uint8_t rgba[64], uint8_t out[16]);
+};
+
+
+#endif //REASONABLEGL_BLOCKCOMPRESSION_H
@@ -3,64 +3,76 @@
 //
 
 #include "ComputeShader.h"
+#include "ProgramCache.h"
+#include "ShaderBatch.h"
 
 
 ComputeShader::ComputeShader(const char *shaderPath) : computeShaderPath(shaderPath) {
-    std::ifstream cShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        // open files
-        cShaderFile.open(shaderPath);
-
-        std::stringstream cShaderStream;
-        // read file's buffer contents into streams
-        cShaderStream << cShaderFile.rdbuf();
-        // close file handlers
-        cShaderFile.close();
-        // convert stream into string
-        shaderCode = cShaderStream.str();
-    }
-    catch (std::ifstream::failure &e) {
-        spdlog::error("FILE_NOT_SUCCESSFULLY_READ:", e.what());
-    }
 }
 
 void ComputeShader::setLayout(int localSizeX, int localSizeY, int localSizeZ) {
-    std::string toBeReplaced = "//HERE SHOULD BE LAYOUT";
-    std::size_t foundPos = shaderCode.find(toBeReplaced);
-    if (foundPos == std::string::npos) return;
-    std::string newLayout =
-            " layout (local_size_x = " + std::to_string(localSizeX) + ", local_size_y = " + std::to_string(localSizeY) +
-            ", local_size_z = " + std::to_string(localSizeZ) + ") in;";
-    shaderCode.replace(foundPos, toBeReplaced.size(), newLayout);
+    defines["LOCAL_SIZE_X"] = std::to_string(localSizeX);
+    defines["LOCAL_SIZE_Y"] = std::to_string(localSizeY);
+    defines["LOCAL_SIZE_Z"] = std::to_string(localSizeZ);
 }
 
 void ComputeShader::init() {
-// 1. retrieve the vertex/fragment source code from filePath
-    if (shaderCode.empty()) return; // No code no init
+    submit();
+    finish();
+}
 
-    std::string toBeReplaced = "//HERE SHOULD BE LAYOUT"; // set defouglt layout if it doesn't work
-    if (shaderCode.find(toBeReplaced) != std::string::npos) {
-        setLayout(1, 1, 1);
+void ComputeShader::submit() {
+// 1. retrieve the source code from filePath, with includes and defines resolved
+    if (submitted) return;
+    submitted = true;
+    ShaderSource source = ShaderPreprocessor::process(computeShaderPath, defines);
+    if (source.code.empty()) {
+        // no code no program, but ready() has to turn true or whoever polls it waits forever
+        spdlog::error("Compute shader " + computeShaderPath + " has no source, program left empty");
+        finished = true;
+        return;
+    }
+    const std::string &shaderCode = source.code;
+    sources = ShaderPreprocessor::describe(source);
+
+    // a cached binary of exactly this source skips compiling altogether
+    cacheKey = ProgramCache::key({shaderCode});
+    ID = ProgramCache::load(cacheKey);
+    if (ID != 0) {
+        finished = true;
+        return;
     }
 
     const char *cShaderCode = shaderCode.c_str();
-    // 2. compile shaders
-    unsigned int compute;
-    // compute shader
+    // 2. compile shaders, the statuses are only queried in finish() so the driver can work on it meanwhile
     compute = glCreateShader(GL_COMPUTE_SHADER);
     glShaderSource(compute, 1, &cShaderCode, NULL);
     glCompileShader(compute);
-    checkCompileErrors(compute, "COMPUTE");
 
     // shader Program
     ID = glCreateProgram();
     glAttachShader(ID, compute);
+    ProgramCache::prepare(ID);
     glLinkProgram(ID);
+}
+
+bool ComputeShader::ready() const {
+    if (!submitted) return false;
+    if (finished || !ShaderBatch::parallel()) return true;
+    GLint done = GL_FALSE;
+    glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+void ComputeShader::finish() {
+    if (!submitted || finished) return;
+    finished = true;
+    checkCompileErrors(compute, "COMPUTE");
     checkCompileErrors(ID, "PROGRAM");
+    ProgramCache::save(ID, cacheKey);
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(compute);
+    compute = 0;
 }
 
 void ComputeShader::use() const {
@@ -103,7 +115,8 @@ void ComputeShader::checkCompileErrors(unsigned int shader, std::string type) {
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            spdlog::error("Shader in path: " + computeShaderPath + " has compilation error of type: " + type + infoLog);
+            spdlog::error("Shader in path: " + computeShaderPath + " has compilation error of type: " + type + infoLog +
+                          " (sources: " + sources + ")");
         }
     } else {
         glGetProgramiv(shader, GL_LINK_STATUS, &success);
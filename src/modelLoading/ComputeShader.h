@@ -5,6 +5,7 @@
 #ifndef OPENGLGP_COMPUTESHADER_H
 #define OPENGLGP_COMPUTESHADER_H
 
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <sstream>
@@ -13,6 +14,7 @@
 #include "glm/detail/type_vec3.hpp"
 #include "glm/vec3.hpp"
 #include "glad/glad.h"
+#include "ShaderPreprocessor.h"
 
 
 class ComputeShader {
@@ -20,14 +22,28 @@ public:
     // the program ID
     GLuint ID{};
 
+    // injected by ShaderPreprocessor, set them before the shader is submitted
+    ShaderDefines defines;
+
     // constructor reads and builds the shader
     ComputeShader(const char *shaderPath);
 
     // use/activate the shader
     void use() const;
 
+    // compiles and links, blocking until the driver is done
     void init();
 
+    // Hands compile and link to the driver without waiting for it, init() or finish() complete the program later.
+    void submit();
+
+    // Polls GL_COMPLETION_STATUS_KHR, the program can be finished without stalling once this is true.
+    bool ready() const;
+
+    // Reports compile/link errors and stores the program binary, blocks if the driver isn't done yet.
+    void finish();
+
+    // Sets LOCAL_SIZE_X/Y/Z, shaders pick them up through res/shaders/include/workgroup.glsl. Call before submitting.
     void setLayout(int localSizeX, int localSizeY, int localSizeZ);
 
     // utility uniform functions
@@ -46,8 +62,15 @@ public:
     void setVec3(const std::string &name, glm::vec3 vec3);
 
 private:
-    std::string shaderCode;
     std::string computeShaderPath;
+    // source string numbers for the error log, see ShaderPreprocessor::describe
+    std::string sources;
+
+    // stays alive between submit() and finish() for the error log
+    GLuint compute = 0;
+    uint64_t cacheKey = 0;
+    bool submitted = false;
+    bool finished = false;
 
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
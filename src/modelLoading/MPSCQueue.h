@@ -0,0 +1,57 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_MPSCQUEUE_H
+#define REASONABLEGL_MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free multi producer single consumer queue (Vyukov's intrusive MPSC). push is wait-free and can be
+// called from any thread, pop only from the one consumer thread. A push that is still in flight can make the queue
+// look empty for a moment, the consumer just picks it up on its next pop.
+template<typename T>
+class MPSCQueue {
+public:
+    MPSCQueue() : head(&stub), tail(&stub) {}
+
+    ~MPSCQueue() {
+        T value;
+        while (pop(value)) {}
+        if (tail != &stub) delete tail;
+    }
+
+    MPSCQueue(const MPSCQueue &) = delete;
+
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    void push(T value) {
+        Node *node = new Node{std::move(value)};
+        Node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T &value) {
+        // tail is always an already consumed node, the front element lives in its successor
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) return false;
+        value = std::move(next->value);
+        if (tail != &stub) delete tail;
+        tail = next;
+        return true;
+    }
+
+private:
+    struct Node {
+        T value;
+        std::atomic<Node *> next{nullptr};
+    };
+
+    Node stub;
+    std::atomic<Node *> head; // producers
+    Node *tail;               // consumer
+};
+
+
+#endif //REASONABLEGL_MPSCQUEUE_H
@@ -3,6 +3,9 @@
 //
 
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
 
 #ifndef MESH_H
 #define MESH_H
@@ -12,21 +15,77 @@ using namespace std;
 
 
 // constructor
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<shared_ptr<Texture>> textures) : vertices(
-        vertices), indices(indices), textures(textures) {
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<shared_ptr<Texture>> textures,
+           VertexLayout layout, bool hasBones, MeshletData meshletData) : vertices(std::move(vertices)),
+                                                                          indices(std::move(indices)),
+                                                                          textures(std::move(textures)), layout(layout),
+                                                                          hasBones(hasBones),
+                                                                          meshletData(std::move(meshletData)) {
     // now that we have all the required data, set the vertex buffers and its attribute pointers.
     setupMesh();
 }
 
+Mesh::Mesh(const MeshBlobs &blobs, vector<shared_ptr<Texture>> textures, VertexLayout layout, bool hasBones,
+           MeshletData meshletData) : textures(textures), layout(layout), hasBones(hasBones),
+                                      meshletData(std::move(meshletData)) {
+    upload(blobs);
+}
+
+Mesh::~Mesh() {
+    if (VAO == 0) return;
+    unsigned int buffers[] = {VBO, EBO, skinVBO, meshletBuffer, meshletVertexBuffer, meshletTriangleBuffer,
+                              culledIndexBuffer, drawCommandBuffer};
+    glDeleteBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+    unsigned int vertexArrays[] = {VAO, culledVAO};
+    glDeleteVertexArrays(2, vertexArrays);
+}
+
+
+void Mesh::bindVertexFormat(Shader &shader) {
+    shader.setVec3("vertexPositionOffset", layout.decodeOffset(boundsMin, boundsMax));
+    shader.setVec3("vertexPositionScale", layout.decodeScale(boundsMin, boundsMax));
+    shader.setBool("vertexOctahedralNormals", layout.octahedralNormals);
+}
 
 void Mesh::SimpleDraw(Shader &shader) {
+    bindVertexFormat(shader);
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
     glBindVertexArray(0);
 }
 
 // render the mesh
 void Mesh::Draw(Shader &shader) {
+    bindTextures(shader);
+
+    // draw mesh
+    bindVertexFormat(shader);
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+    glBindVertexArray(0);
+
+    // always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawCulled(Shader &shader) {
+    if (culledVAO == 0) {
+        Draw(shader);
+        return;
+    }
+    bindTextures(shader);
+
+    bindVertexFormat(shader);
+    glBindVertexArray(culledVAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::bindTextures(Shader &shader) {
     // bind appropriate textures
     unsigned int albedoNr = 1;
     unsigned int normalNr = 1;
@@ -55,18 +114,116 @@ void Mesh::Draw(Shader &shader) {
         glBindTexture(GL_TEXTURE_2D, textures[i]->ID);
     
     }
-
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
 }
 
 // initializes all the buffer objects/arrays
 void Mesh::setupMesh() {
+    // quantized layouts store positions relative to the mesh bounds
+    computeBounds(vertices, boundsMin, boundsMax);
+    MeshBlobs blobs;
+    blobs.boundsMin = boundsMin;
+    blobs.boundsMax = boundsMax;
+    blobs.uvDensity = computeUVDensity(vertices, indices);
+
+    vector<uint8_t> vertexData = layout.pack(vertices, boundsMin, boundsMax);
+    blobs.vertexData = vertexData.data();
+    blobs.vertexBytes = vertexData.size();
+
+    vector<uint8_t> indexData = packIndices(indices, vertices.size(), blobs.indexType);
+    blobs.indexData = indexData.data();
+    blobs.indexCount = static_cast<unsigned int>(indices.size());
+
+    // bone data lives in its own stream so static meshes don't pay for it
+    vector<uint8_t> skinData;
+    if (layout.skinning && hasBones) {
+        skinData = VertexLayout::packSkin(vertices);
+        blobs.skinData = skinData.data();
+        blobs.skinBytes = skinData.size();
+    }
+    upload(blobs);
+}
+
+void Mesh::computeBounds(const vector<Vertex> &vertices, glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+    boundsMin = boundsMax = glm::vec3(0.0f);
+    if (vertices.empty()) return;
+    boundsMin = boundsMax = vertices[0].Position;
+    for (const Vertex &vertex: vertices) {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
+}
+
+float Mesh::computeUVDensity(const vector<Vertex> &vertices, const vector<unsigned int> &indices) {
+    // sqrt of texture area over surface area, both summed over every triangle
+    double uvArea = 0.0, surfaceArea = 0.0;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const Vertex &v0 = vertices[indices[t]];
+        const Vertex &v1 = vertices[indices[t + 1]];
+        const Vertex &v2 = vertices[indices[t + 2]];
+        glm::vec2 uv1 = v1.TexCoords - v0.TexCoords;
+        glm::vec2 uv2 = v2.TexCoords - v0.TexCoords;
+        uvArea += glm::abs(uv1.x * uv2.y - uv1.y * uv2.x);
+        surfaceArea += glm::length(glm::cross(v1.Position - v0.Position, v2.Position - v0.Position));
+    }
+    return surfaceArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / surfaceArea)) : 0.0f;
+}
+
+vector<uint8_t> Mesh::packIndices(const vector<unsigned int> &indices, size_t vertexCount, GLenum &indexType) {
+    vector<uint8_t> data;
+    if (MeshOptimizer::indexSize(vertexCount) == sizeof(uint16_t)) {
+        indexType = GL_UNSIGNED_SHORT;
+        data.resize(indices.size() * sizeof(uint16_t));
+        auto *shortIndices = reinterpret_cast<uint16_t *>(data.data());
+        for (size_t i = 0; i < indices.size(); ++i) shortIndices[i] = static_cast<uint16_t>(indices[i]);
+    } else {
+        indexType = GL_UNSIGNED_INT;
+        data.resize(indices.size() * sizeof(unsigned int));
+        memcpy(data.data(), indices.data(), data.size());
+    }
+    return data;
+}
+
+vector<unsigned int> Mesh::unpackIndices(const uint8_t *data, unsigned int indexCount, GLenum indexType) {
+    vector<unsigned int> indices(indexCount);
+    if (indexType == GL_UNSIGNED_SHORT) {
+        for (unsigned int i = 0; i < indexCount; ++i) {
+            uint16_t index;
+            memcpy(&index, data + i * sizeof(uint16_t), sizeof(uint16_t));
+            indices[i] = index;
+        }
+    } else {
+        memcpy(indices.data(), data, indexCount * sizeof(unsigned int));
+    }
+    return indices;
+}
+
+void Mesh::retainGeometry(GeometryRetention retention) {
+    if (retention == GeometryRetention::Full) return;
+    if (retention == GeometryRetention::Positions && !vertices.empty()) {
+        positions.resize(vertices.size());
+        for (size_t v = 0; v < vertices.size(); ++v) positions[v] = vertices[v].Position;
+    }
+    // swap with empty vectors, clear() would keep the capacity
+    vector<Vertex>().swap(vertices);
+    if (retention == GeometryRetention::Discard) {
+        vector<unsigned int>().swap(indices);
+        vector<glm::vec3>().swap(positions);
+    }
+}
+
+size_t Mesh::cpuGeometryBytes() const {
+    return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) +
+           positions.capacity() * sizeof(glm::vec3);
+}
+
+void Mesh::upload(const MeshBlobs &blobs) {
+    boundsMin = blobs.boundsMin;
+    boundsMax = blobs.boundsMax;
+    uvDensity = blobs.uvDensity;
+    indexType = blobs.indexType;
+    indexCount = blobs.indexCount;
+    size_t indexBytes = indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+
     // create buffers/arrays
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -75,37 +232,63 @@ void Mesh::setupMesh() {
     glBindVertexArray(VAO);
     // load data into vertex buffers
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for all its items.
-    // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-    // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, blobs.vertexBytes, blobs.vertexData, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, blobs.indexData, GL_STATIC_DRAW);
 
     // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) 0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, Bitangent));
-    // ids
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void *) offsetof(Vertex, m_BoneIDs));
-
-    // weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, m_Weights));
+    layout.setAttributes();
+
+    if (blobs.skinData != nullptr) {
+        glGenBuffers(1, &skinVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+        glBufferData(GL_ARRAY_BUFFER, blobs.skinBytes, blobs.skinData, GL_STATIC_DRAW);
+        VertexLayout::setSkinAttributes();
+    }
+    glBindVertexArray(0);
+    gpuBytes = blobs.vertexBytes + blobs.skinBytes + indexBytes;
+
+    if (!meshletData.meshlets.empty())
+        setupMeshlets();
+}
+
+void Mesh::setupMeshlets() {
+    auto createStorage = [](unsigned int &buffer, GLsizeiptr size, const void *data, GLenum usage) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usage);
+    };
+    createStorage(meshletBuffer, meshletData.meshlets.size() * sizeof(Meshlet), meshletData.meshlets.data(),
+                  GL_STATIC_DRAW);
+    createStorage(meshletVertexBuffer, meshletData.vertices.size() * sizeof(uint32_t), meshletData.vertices.data(),
+                  GL_STATIC_DRAW);
+    createStorage(meshletTriangleBuffer, meshletData.triangles.size() * sizeof(uint32_t),
+                  meshletData.triangles.data(), GL_STATIC_DRAW);
+    // worst case every triangle survives, culled indices are always 32 bit
+    createStorage(culledIndexBuffer, indexCount * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // count, instanceCount, firstIndex, baseVertex, baseInstance
+    GLuint command[5] = {indexCount, 1, 0, 0, 0};
+    glGenBuffers(1, &drawCommandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), command, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    gpuBytes += meshletData.meshlets.size() * sizeof(Meshlet) +
+                (meshletData.vertices.size() + meshletData.triangles.size() + indexCount) * sizeof(uint32_t) +
+                sizeof(command);
+
+    // same vertex streams as VAO, indices come from the culling output
+    glGenVertexArrays(1, &culledVAO);
+    glBindVertexArray(culledVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    layout.setAttributes();
+    if (skinVBO != 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+        VertexLayout::setSkinAttributes();
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, culledIndexBuffer);
     glBindVertexArray(0);
 }
 
@@ -15,24 +15,28 @@ using namespace std;
 
 #include "Shader.h"
 #include "Texture.h"
+#include "VertexLayout.h"
+#include "Meshlet.h"
+
+// GPU-ready mesh streams, e.g. pointing straight into a memory mapped ModelCache file
+struct MeshBlobs {
+    const uint8_t *vertexData = nullptr;
+    size_t vertexBytes = 0;
+    const uint8_t *skinData = nullptr; // only for skinned meshes
+    size_t skinBytes = 0;
+    const uint8_t *indexData = nullptr;
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float uvDensity = 0.0f;
+};
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
+// What a Mesh keeps in RAM once its streams are on the GPU. indexCount and the bounds are always kept.
+enum class GeometryRetention {
+    Discard,   // nothing, the GPU copy is all there is
+    Positions, // positions and 32 bit indices, enough for CPU picking or collision
+    Full       // vertices and indices as imported
 };
 
 class Mesh {
@@ -40,20 +44,80 @@ public:
     // mesh Data
     vector<Vertex> vertices;
     vector<unsigned int> indices;
+    // only filled with GeometryRetention::Positions, vertices is empty then
+    vector<glm::vec3> positions;
     vector<shared_ptr<Texture>> textures;
-    unsigned int VAO;
+    unsigned int VAO = 0;
+
+    VertexLayout layout;
+    bool hasBones = false;
+    // GL_UNSIGNED_SHORT when the mesh has fewer than 65536 vertices, GL_UNSIGNED_INT otherwise
+    GLenum indexType = GL_UNSIGNED_INT;
+    // what the draw calls use, meshes loaded from the model cache have no CPU side indices
+    unsigned int indexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // texture coordinate units per mesh space unit, averaged over the surface. TextureStreamer feedback uses it.
+    float uvDensity = 0.0f;
+
+    // meshlets for GPU cluster culling, see MeshletCuller. Buffers stay 0 for meshes without meshlets.
+    MeshletData meshletData;
+    unsigned int meshletBuffer = 0, meshletVertexBuffer = 0, meshletTriangleBuffer = 0;
+    unsigned int culledIndexBuffer = 0, drawCommandBuffer = 0, culledVAO = 0;
+    // everything this mesh allocated on the GPU, what AssetRegistry budgets with
+    size_t gpuBytes = 0;
+
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<shared_ptr<Texture>> textures,
+         VertexLayout layout = VertexLayout::Full(), bool hasBones = false, MeshletData meshletData = MeshletData());
+
+    // Uploads already packed streams, vertices and indices stay empty unless the caller moves them in afterwards.
+    Mesh(const MeshBlobs &blobs, vector<shared_ptr<Texture>> textures, VertexLayout layout, bool hasBones,
+         MeshletData meshletData = MeshletData());
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<shared_ptr<Texture>> textures);
+    // meshes own their GL objects and are shared through shared_ptr, never copied
+    Mesh(const Mesh &) = delete;
+
+    Mesh &operator=(const Mesh &) = delete;
+
+    ~Mesh();
 
     void setupMesh();
 
+    static void computeBounds(const vector<Vertex> &vertices, glm::vec3 &boundsMin, glm::vec3 &boundsMax);
+
+    static float computeUVDensity(const vector<Vertex> &vertices, const vector<unsigned int> &indices);
+
+    // 16 bit indices when every vertex can be addressed with them, otherwise 32 bit
+    static vector<uint8_t> packIndices(const vector<unsigned int> &indices, size_t vertexCount, GLenum &indexType);
+
+    static vector<unsigned int> unpackIndices(const uint8_t *data, unsigned int indexCount, GLenum indexType);
+
+    // Frees the CPU geometry the retention doesn't ask for. Positions are taken from vertices if they are still there.
+    void retainGeometry(GeometryRetention retention);
+
+    // RAM held by vertices, indices and positions
+    size_t cpuGeometryBytes() const;
+
+    // Sets the uniforms vertex shaders use to decode quantized positions and octahedral normals.
+    void bindVertexFormat(Shader &shader);
+
     void Draw(Shader &shader);
 
     void SimpleDraw(Shader &shader);
 
+    // Draws the triangles of the meshlets that survived the last MeshletCuller::Cull of this mesh.
+    void DrawCulled(Shader &shader);
+
 private:
     // render data 
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+    unsigned int skinVBO = 0;
+
+    void upload(const MeshBlobs &blobs);
+
+    void setupMeshlets();
+
+    void bindTextures(Shader &shader);
 
 };
 
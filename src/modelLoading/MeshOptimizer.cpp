@@ -0,0 +1,291 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    struct VertexHasher {
+        const std::vector<Vertex> *vertices;
+
+        size_t operator()(unsigned int index) const {
+            // FNV-1a over the raw vertex bytes, Vertex has no padding
+            const auto *bytes = reinterpret_cast<const unsigned char *>(&(*vertices)[index]);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); ++i) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct VertexEqual {
+        const std::vector<Vertex> *vertices;
+
+        bool operator()(unsigned int a, unsigned int b) const {
+            return std::memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0;
+        }
+    };
+
+    // Forsyth scoring constants
+    constexpr int maxCacheSize = 32;
+    constexpr float cacheDecayPower = 1.5f;
+    constexpr float lastTriangleScore = 0.75f;
+    constexpr float valenceBoostScale = 2.0f;
+    constexpr float valenceBoostPower = 0.5f;
+
+    float vertexScore(int cachePosition, unsigned int remainingValence) {
+        if (remainingValence == 0) return -1.0f; // no triangles need this vertex anymore
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // the vertices of the last triangle get a fixed score so we don't just reuse the same edge
+                score = lastTriangleScore;
+            } else {
+                const float scaler = 1.0f / (maxCacheSize - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+            }
+        }
+        // bonus for vertices with few triangles left, finishes them off before they drop out of the cache
+        score += valenceBoostScale * std::pow(static_cast<float>(remainingValence), -valenceBoostPower);
+        return score;
+    }
+}
+
+size_t MeshOptimizer::indexSize(size_t vertexCount) {
+    return vertexCount < 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+float MeshOptimizer::calculateACMR(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                   unsigned int cacheSize) {
+    if (indices.size() < 3) return 0.0f;
+
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0;
+    for (unsigned int index: indices) {
+        // a vertex is still in a FIFO cache if fewer than cacheSize misses happened since it was inserted
+        if (time - timestamps[index] > cacheSize) {
+            timestamps[index] = time++;
+            misses++;
+        }
+    }
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+size_t MeshOptimizer::weldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+    std::unordered_map<unsigned int, unsigned int, VertexHasher, VertexEqual> unique(
+            vertices.size(), VertexHasher{&vertices}, VertexEqual{&vertices});
+
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); ++i) {
+        auto [it, inserted] = unique.try_emplace(i, static_cast<unsigned int>(welded.size()));
+        if (inserted) welded.push_back(vertices[i]);
+        remap[i] = it->second;
+    }
+
+    for (unsigned int &index: indices) index = remap[index];
+    vertices = std::move(welded);
+    return vertices.size();
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // vertex -> triangles adjacency
+    std::vector<unsigned int> valence(vertexCount, 0);
+    for (unsigned int index: indices) valence[index]++;
+
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) score[v] = vertexScore(-1, valence[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache, newCache;
+    cache.reserve(maxCacheSize + 3);
+    newCache.reserve(maxCacheSize + 3);
+
+    size_t scanCursor = 0;
+    long long bestTriangle = 0;
+    for (size_t t = 1; t < triangleCount; ++t) {
+        if (triangleScore[t] > triangleScore[bestTriangle]) bestTriangle = static_cast<long long>(t);
+    }
+
+    while (bestTriangle >= 0) {
+        emitted[bestTriangle] = true;
+        const unsigned int *tri = &indices[bestTriangle * 3];
+        result.insert(result.end(), tri, tri + 3);
+
+        // the emitted triangle's vertices move to the front of the LRU cache
+        newCache.assign(tri, tri + 3);
+        for (unsigned int v: cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) newCache.push_back(v);
+        }
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = tri[k];
+            valence[v]--;
+            // remove the triangle from the vertex adjacency so it isn't scored again
+            unsigned int begin = adjacencyOffset[v];
+            unsigned int end = begin + valence[v] + 1;
+            for (unsigned int a = begin; a < end; ++a) {
+                if (adjacency[a] == bestTriangle) {
+                    std::swap(adjacency[a], adjacency[end - 1]);
+                    break;
+                }
+            }
+        }
+
+        // update vertex scores for everything that was or is in the cache, then rescore touched triangles
+        for (size_t i = 0; i < newCache.size(); ++i) {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < maxCacheSize ? static_cast<int>(i) : -1;
+            float newScore = vertexScore(cachePosition[v], valence[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + valence[v]; ++a) {
+                triangleScore[adjacency[a]] += delta;
+            }
+        }
+        if (newCache.size() > maxCacheSize) newCache.resize(maxCacheSize);
+        std::swap(cache, newCache);
+
+        // next triangle: best one adjacent to the cache, otherwise the first not yet emitted
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v: cache) {
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + valence[v]; ++a) {
+                unsigned int t = adjacency[a];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+        if (bestTriangle < 0) {
+            while (scanCursor < triangleCount && emitted[scanCursor]) scanCursor++;
+            if (scanCursor < triangleCount) bestTriangle = static_cast<long long>(scanCursor);
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // cluster boundaries: triangles where all three vertices miss the cache, the order restarts there anyway
+    std::vector<size_t> clusterStart;
+    std::vector<unsigned int> timestamps(vertices.size(), 0);
+    unsigned int time = fifoCacheSize + 1;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int index = indices[t * 3 + k];
+            if (time - timestamps[index] > fifoCacheSize) {
+                timestamps[index] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) clusterStart.push_back(t);
+    }
+    clusterStart.push_back(triangleCount);
+    size_t clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2) return;
+
+    glm::vec3 meshCentroid(0.0f);
+    for (const Vertex &vertex: vertices) meshCentroid += vertex.Position;
+    meshCentroid /= static_cast<float>(vertices.size());
+
+    // sort key: how much the cluster faces away from the mesh center, outward clusters occlude the rest
+    std::vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+            glm::vec3 p0 = vertices[indices[t * 3]].Position;
+            glm::vec3 p1 = vertices[indices[t * 3 + 1]].Position;
+            glm::vec3 p2 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            float faceArea = glm::length(faceNormal);
+            centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+            normal += faceNormal;
+            area += faceArea;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.0f) centroid /= area;
+        if (normalLength > 0.0f) normal /= normalLength;
+        sortKey[c] = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c: order) {
+        result.insert(result.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+    }
+    indices = std::move(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int &index: indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(ordered);
+}
+
+MeshOptimizationStats MeshOptimizer::optimize(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                                              const VertexLayout &layout) {
+    MeshOptimizationStats stats;
+    stats.vertexCountBefore = vertices.size();
+    stats.acmrBefore = calculateACMR(indices, vertices.size());
+    stats.vertexBytesBefore = vertices.size() * layout.stride();
+    stats.indexBytesBefore = indices.size() * sizeof(unsigned int);
+
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices);
+    optimizeVertexFetch(vertices, indices);
+
+    stats.vertexCountAfter = vertices.size();
+    stats.acmrAfter = calculateACMR(indices, vertices.size());
+    stats.vertexBytesAfter = vertices.size() * layout.stride();
+    stats.indexBytesAfter = indices.size() * indexSize(vertices.size());
+    return stats;
+}
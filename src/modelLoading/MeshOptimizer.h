@@ -0,0 +1,56 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_MESHOPTIMIZER_H
+#define REASONABLEGL_MESHOPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+#include "VertexLayout.h"
+
+struct MeshOptimizationStats {
+    size_t vertexCountBefore = 0;
+    size_t vertexCountAfter = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+    size_t vertexBytesBefore = 0;
+    size_t vertexBytesAfter = 0;
+    size_t indexBytesBefore = 0;
+    size_t indexBytesAfter = 0;
+};
+
+// Import-time optimization of indexed triangle lists. All steps keep the rendered result identical, they only
+// change how much data there is and in which order the GPU gets to see it.
+class MeshOptimizer {
+public:
+    // Post-transform cache size used for ACMR reporting (FIFO, typical for current hardware).
+    static constexpr unsigned int fifoCacheSize = 16;
+
+    // Runs weld -> vertex cache -> overdraw -> vertex fetch and returns before/after numbers.
+    static MeshOptimizationStats optimize(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                                          const VertexLayout &layout);
+
+    // Merges bitwise identical vertices and rewrites the indices. Returns the new vertex count.
+    static size_t weldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+    // Reorders triangles for post-transform cache hits (Forsyth, "Linear-Speed Vertex Cache Optimisation").
+    static void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+
+    // Splits the cache-optimized order into clusters at cache restarts and sorts the clusters so outward facing
+    // ones are drawn first, which keeps most of the cache efficiency while reducing overdraw.
+    static void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices);
+
+    // Reorders vertices in order of first use so vertex fetch walks memory linearly. Drops unreferenced vertices.
+    static void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+    // Average number of vertex shader invocations per triangle for a FIFO cache of the given size.
+    static float calculateACMR(const std::vector<unsigned int> &indices, size_t vertexCount,
+                               unsigned int cacheSize = fifoCacheSize);
+
+    // Size in bytes of one index for a mesh with the given vertex count (2 below 65536 vertices, 4 otherwise).
+    static size_t indexSize(size_t vertexCount);
+};
+
+
+#endif //REASONABLEGL_MESHOPTIMIZER_H
@@ -0,0 +1,106 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "Meshlet.h"
+
+MeshletData MeshletBuilder::build(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices) {
+    MeshletData data;
+    if (indices.size() < 3) return data;
+
+    data.meshlets.reserve(indices.size() / 3 / maxTriangles + 1);
+    data.vertices.reserve(indices.size() / 2);
+    data.triangles.reserve(indices.size() / 3);
+
+    // local index of each mesh vertex inside the meshlet that is being built, valid while stamp matches
+    std::vector<uint32_t> localIndex(vertices.size());
+    std::vector<uint32_t> stamp(vertices.size(), ~0u);
+
+    Meshlet current{};
+    auto finish = [&]() {
+        if (current.triangleCount == 0) return;
+        computeBounds(current, data, vertices);
+        data.meshlets.push_back(current);
+        current = Meshlet{};
+        current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(data.triangles.size());
+    };
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        auto meshletId = static_cast<uint32_t>(data.meshlets.size());
+        unsigned int newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (stamp[indices[t + k]] != meshletId) newVertices++;
+        }
+        // degenerate triangles can reference the same new vertex twice, counting it twice only wastes a slot
+        if (current.vertexCount + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles) {
+            finish();
+            meshletId = static_cast<uint32_t>(data.meshlets.size());
+        }
+
+        uint32_t local[3];
+        for (int k = 0; k < 3; ++k) {
+            unsigned int index = indices[t + k];
+            if (stamp[index] != meshletId) {
+                stamp[index] = meshletId;
+                localIndex[index] = current.vertexCount++;
+                data.vertices.push_back(index);
+            }
+            local[k] = localIndex[index];
+        }
+        data.triangles.push_back(local[0] | (local[1] << 8) | (local[2] << 16));
+        current.triangleCount++;
+    }
+    finish();
+    return data;
+}
+
+void MeshletBuilder::computeBounds(Meshlet &meshlet, const MeshletData &data, const std::vector<Vertex> &vertices) {
+    auto position = [&](uint32_t local) {
+        return vertices[data.vertices[meshlet.vertexOffset + local]].Position;
+    };
+
+    // bounding sphere around the AABB center, good enough for culling and cheap to build
+    glm::vec3 boundsMin = position(0);
+    glm::vec3 boundsMax = boundsMin;
+    for (uint32_t v = 1; v < meshlet.vertexCount; ++v) {
+        boundsMin = glm::min(boundsMin, position(v));
+        boundsMax = glm::max(boundsMax, position(v));
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+        radius = glm::max(radius, glm::length(position(v) - center));
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // normal cone: average face normal and the widest deviation from it
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+        uint32_t packed = data.triangles[meshlet.triangleOffset + t];
+        glm::vec3 p0 = position(packed & 0xFF);
+        glm::vec3 p1 = position((packed >> 8) & 0xFF);
+        glm::vec3 p2 = position((packed >> 16) & 0xFF);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length <= 0.0f) continue;
+        normal /= length;
+        normals.push_back(normal);
+        axis += normal;
+    }
+
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= 0.0f) {
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        return;
+    }
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for (const glm::vec3 &normal: normals) minDot = glm::min(minDot, glm::dot(normal, axis));
+
+    // cones wider than ~84 degrees are practically never fully backfacing
+    float cutoff = minDot <= 0.1f ? 1.0f : glm::sqrt(1.0f - minDot * minDot);
+    meshlet.cone = glm::vec4(axis, cutoff);
+}
@@ -0,0 +1,44 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_MESHLET_H
+#define REASONABLEGL_MESHLET_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "VertexLayout.h"
+
+// Matches struct Meshlet in res/shaders/Culling/meshletCull.glsl (std430)
+struct Meshlet {
+    glm::vec4 sphere;      // xyz center, w radius, mesh space
+    glm::vec4 cone;        // xyz axis, w cutoff (1 = never backface culled)
+    uint32_t vertexOffset; // into MeshletData::vertices
+    uint32_t vertexCount;
+    uint32_t triangleOffset; // into MeshletData::triangles
+    uint32_t triangleCount;
+};
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    // mesh vertex index for every meshlet local vertex
+    std::vector<uint32_t> vertices;
+    // one entry per triangle, three 8 bit meshlet local indices packed as x | y << 8 | z << 16
+    std::vector<uint32_t> triangles;
+};
+
+class MeshletBuilder {
+public:
+    static constexpr unsigned int maxVertices = 64;
+    static constexpr unsigned int maxTriangles = 124;
+
+    // Greedily splits the index buffer in its current order (run it after MeshOptimizer for tight clusters).
+    static MeshletData build(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices);
+
+private:
+    static void computeBounds(Meshlet &meshlet, const MeshletData &data, const std::vector<Vertex> &vertices);
+};
+
+
+#endif //REASONABLEGL_MESHLET_H
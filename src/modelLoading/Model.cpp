@@ -3,37 +3,152 @@
 //
 
 #include "Model.h"
+#include "ModelCache.h"
+#include "MappedFile.h"
+#include "AssetRegistry.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include "Systems/RenderSystem/Culling/MeshletCuller.h"
 
 void Model::SimpleDraw(Shader &shader) {
     for (unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].SimpleDraw(shader);
+        meshes[i]->SimpleDraw(shader);
 }
 
 // draws the model, and thus all its meshes
 void Model::Draw(Shader &shader) {
     for (unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].Draw(shader);
+        meshes[i]->Draw(shader);
+}
+
+void Model::DrawCulled(Shader &shader, MeshletCuller &culler, const glm::mat4 &model, const void *instance) {
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        if (!culler.Cull(*meshes[i], model, instance)) continue;
+        // culling switched to its compute program
+        shader.use();
+        meshes[i]->DrawCulled(shader);
+    }
 }
 
 //private:
 // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 void Model::loadModel() {
+    if (!import()) return;
+    while (uploadNextMesh()) {}
+}
+
+bool Model::import(ThreadPool *pool) {
+    importedMeshes.clear();
+    uploadedMeshes = 0;
+    auto start = std::chrono::steady_clock::now();
+    // the cache only has packed streams, full CPU geometry has to come from Assimp every time
+    bool cached = useModelCache && geometryRetention != GeometryRetention::Full;
+    if (useModelCache && !cached)
+        spdlog::info("{} keeps its full geometry, importing through Assimp instead of the model cache", *path);
+    if (cached && ModelCache::load(*this, *path)) {
+        spdlog::info("Loaded {} from model cache in {:.2f} ms", *path,
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if (registry != nullptr)
+            for (ImportedMesh &imported: importedMeshes) imported.contentKey = contentKey(imported);
+        return true;
+    }
+
     // read file via ASSIMP
     Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(*path,
-                                             aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs |
-                                             aiProcess_CalcTangentSpace);
+    const aiScene *scene = importer.ReadFile(*path, importFlags);
     // check for errors
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
     {
         spdlog::error("Assimp error: " + string(importer.GetErrorString()));
-        return;
+        return false;
     }
     // retrieve the directory path of the filepath
     directory = path->substr(0, path->find_last_of('/'));
 
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    // process ASSIMP's root node recursively, then every mesh on its own
+    vector<aiMesh *> sceneMeshes;
+    processNode(scene->mRootNode, scene, sceneMeshes);
+    importedMeshes.resize(sceneMeshes.size());
+    vector<glm::vec3> furthest(sceneMeshes.size(), glm::vec3(0.0f));
+    auto process = [&](size_t i) { processMesh(sceneMeshes[i], scene, importedMeshes[i], furthest[i]); };
+    if (pool != nullptr)
+        pool->parallelFor(sceneMeshes.size(), process);
+    else
+        for (size_t i = 0; i < sceneMeshes.size(); ++i) process(i);
+    futhestLenghtsFromCenter = glm::vec3(0.0f);
+    for (const glm::vec3 &meshFurthest: furthest)
+        futhestLenghtsFromCenter = glm::max(futhestLenghtsFromCenter, meshFurthest);
+    spdlog::info("Imported {} meshes of {} in {:.2f} ms", sceneMeshes.size(), *path,
+                 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    // still worth writing with Full, other models of the same file load from it
+    if (useModelCache)
+        ModelCache::save(*this, *path);
+    if (registry != nullptr)
+        for (ImportedMesh &imported: importedMeshes) imported.contentKey = contentKey(imported);
+    return true;
+}
+
+uint64_t Model::contentKey(const ImportedMesh &mesh) const {
+    uint32_t settings[] = {
+            static_cast<uint32_t>(vertexLayout.positionFormat),
+            vertexLayout.octahedralNormals,
+            vertexLayout.halfTexCoords,
+            vertexLayout.skinning,
+            mesh.hasBones,
+            // models asking for different CPU copies don't share, each gets a mesh that kept what it asked for
+            static_cast<uint32_t>(geometryRetention),
+    };
+    // cooked and freshly imported meshes have the same packed streams, so they share entries as well
+    uint64_t key = AssetRegistry::hash(settings, sizeof(settings));
+    key = AssetRegistry::hash(mesh.blobs.vertexData, mesh.blobs.vertexBytes, key);
+    key = AssetRegistry::hash(mesh.blobs.indexData, mesh.blobs.indexCount *
+                                                    (mesh.blobs.indexType == GL_UNSIGNED_SHORT ? 2 : 4), key);
+    if (mesh.blobs.skinData != nullptr) key = AssetRegistry::hash(mesh.blobs.skinData, mesh.blobs.skinBytes, key);
+    key = AssetRegistry::hash(mesh.meshletData.meshlets.data(), mesh.meshletData.meshlets.size() * sizeof(Meshlet),
+                              key);
+    // the same geometry with other textures is another mesh
+    for (const TextureRef &texture: mesh.textures)
+        key = AssetRegistry::hash(AssetRegistry::normalizePath(texture.path) + "|" + texture.type, key);
+    return key;
+}
+
+bool Model::uploadNextMesh(const TextureLoadFunction &loadTexture) {
+    if (uploadedMeshes >= importedMeshes.size()) return false;
+
+    ImportedMesh &imported = importedMeshes[uploadedMeshes++];
+    vector<shared_ptr<Texture>> textures;
+    for (const TextureRef &reference: imported.textures)
+        textures.push_back(findOrLoadTexture(reference, loadTexture));
+
+    // the streams were packed during import, all that is left here is creating the buffers
+    auto create = [&]() {
+        auto mesh = std::make_shared<Mesh>(imported.blobs, std::move(textures), vertexLayout, imported.hasBones,
+                                           std::move(imported.meshletData));
+        if (imported.cooked && geometryRetention == GeometryRetention::Positions) {
+            const MeshBlobs &blobs = imported.blobs;
+            mesh->positions = vertexLayout.unpackPositions(blobs.vertexData, blobs.vertexBytes / vertexLayout.stride(),
+                                                           blobs.boundsMin, blobs.boundsMax);
+            mesh->indices = Mesh::unpackIndices(blobs.indexData, blobs.indexCount, blobs.indexType);
+        } else {
+            mesh->vertices = std::move(imported.vertices);
+            mesh->indices = std::move(imported.indices);
+        }
+        mesh->retainGeometry(geometryRetention);
+        return mesh;
+    };
+    meshes.push_back(registry != nullptr && imported.contentKey != 0 ? registry->mesh(imported.contentKey, create)
+                                                                     : create());
+
+    if (uploadedMeshes < importedMeshes.size()) return true;
+    size_t retainedBytes = 0;
+    for (const shared_ptr<Mesh> &mesh: meshes) retainedBytes += mesh->cpuGeometryBytes();
+    spdlog::info("Uploaded {}, {:.1f} KB of CPU geometry retained", *path, retainedBytes / 1024.0);
+    // everything is on the GPU, the CPU copies and the cache mapping can go
+    importedMeshes.clear();
+    uploadedMeshes = 0;
+    cacheFile.reset();
+    return false;
 }
 
 void replaceAll(string &str, const string &from, const string &to) {
@@ -45,30 +160,32 @@ void replaceAll(string &str, const string &from, const string &to) {
 }
 
 // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::processNode(aiNode *node, const aiScene *scene) {
+void Model::processNode(aiNode *node, const aiScene *scene, vector<aiMesh *> &sceneMeshes) {
     // process each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         // the node object only contains indices to index the actual objects in the scene. 
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
     // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, sceneMeshes);
     }
 
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
+// runs on any thread for several meshes at once, only touches imported and furthest
+void Model::processMesh(aiMesh *mesh, const aiScene *scene, ImportedMesh &imported, glm::vec3 &furthest) const {
     // data to fill
     vector<Vertex> vertices;
     vector<unsigned int> indices;
-    vector<shared_ptr<Texture>> textures;
-    this->futhestLenghtsFromCenter = glm::vec3(0.0f);
+    vector<TextureRef> textures;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
+    glm::vec3 &futhestLenghtsFromCenter = furthest;
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
+        Vertex vertex{};
         glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
         // positions
         vector.x = mesh->mVertices[i].x;
@@ -118,6 +235,20 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
 
         vertices.push_back(vertex);
     }
+    // bone weights, only skinned meshes get a bone stream on the GPU
+    for (unsigned int boneIndex = 0; boneIndex < mesh->mNumBones; boneIndex++) {
+        aiBone *bone = mesh->mBones[boneIndex];
+        for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+            Vertex &vertex = vertices[bone->mWeights[w].mVertexId];
+            for (int slot = 0; slot < MAX_BONE_INFLUENCE; slot++) {
+                if (vertex.m_Weights[slot] == 0.0f) {
+                    vertex.m_BoneIDs[slot] = static_cast<int>(boneIndex);
+                    vertex.m_Weights[slot] = bone->mWeights[w].mWeight;
+                    break;
+                }
+            }
+        }
+    }
     // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
         aiFace face = mesh->mFaces[i];
@@ -125,6 +256,18 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
+    if (optimizeMeshes) {
+        MeshOptimizationStats stats = MeshOptimizer::optimize(vertices, indices, vertexLayout);
+        spdlog::info("Optimized mesh of {}: vertices {} -> {}, ACMR {:.3f} -> {:.3f}, vertex buffer {} -> {} B, "
+                     "index buffer {} -> {} B", *path, stats.vertexCountBefore, stats.vertexCountAfter,
+                     stats.acmrBefore, stats.acmrAfter, stats.vertexBytesBefore, stats.vertexBytesAfter,
+                     stats.indexBytesBefore, stats.indexBytesAfter);
+    }
+    MeshletData meshletData;
+    if (buildMeshlets) {
+        meshletData = MeshletBuilder::build(vertices, indices);
+        spdlog::info("Built {} meshlets for mesh of {}", meshletData.meshlets.size(), *path);
+    }
     // process materials
     aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
     // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -135,79 +278,83 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
     // normal: texture_normalN
 
 // 1. albedo maps
-    vector<shared_ptr<Texture>> albedoMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_albedo");
+    vector<TextureRef> albedoMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_albedo");
     textures.insert(textures.end(), albedoMaps.begin(), albedoMaps.end());
 // 2. normal maps
-    vector<shared_ptr<Texture>> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
+    vector<TextureRef> normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
     textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 // 3. metallic maps
-    vector<shared_ptr<Texture>> metallicMaps = loadMaterialTextures(material, aiTextureType_METALNESS,
-                                                                    "texture_metallic");
+    vector<TextureRef> metallicMaps = loadMaterialTextures(material, aiTextureType_METALNESS, "texture_metallic");
     textures.insert(textures.end(), metallicMaps.begin(), metallicMaps.end());
 // 4. roughness maps
-    vector<shared_ptr<Texture>> roughnessMaps = loadMaterialTextures(material, aiTextureType_SHININESS,
-                                                                     "texture_roughness");
+    vector<TextureRef> roughnessMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness");
     textures.insert(textures.end(), roughnessMaps.begin(), roughnessMaps.end());
 // 5. ambient occlusion maps
 
-    string albedoPath = albedoMaps.back().get()->path;
+    string albedoPath = albedoMaps.back().path;
     string aoPath = albedoPath.substr(0, albedoPath.find_last_of('_')) + "_ao.png";
+    textures.push_back({aoPath, "texture_ao"});
 
-    vector<shared_ptr<Texture>> aoMaps = forceLoadMaterialTexture(aoPath, aiTextureType_AMBIENT_OCCLUSION,
-                                                                  "texture_ao");
+    // the CPU side mesh with its packed streams, Model::uploadNextMesh creates the GL objects
+    imported.vertices = std::move(vertices);
+    imported.indices = std::move(indices);
+    imported.hasBones = mesh->HasBones();
+    imported.meshletData = std::move(meshletData);
+    imported.textures = std::move(textures);
+    packStreams(imported);
+}
 
-    textures.insert(textures.end(), aoMaps.begin(), aoMaps.end());
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+// the exact streams Mesh::setupMesh would build
+void Model::packStreams(ImportedMesh &imported) const {
+    MeshBlobs &blobs = imported.blobs;
+    Mesh::computeBounds(imported.vertices, blobs.boundsMin, blobs.boundsMax);
+    blobs.uvDensity = Mesh::computeUVDensity(imported.vertices, imported.indices);
+
+    imported.vertexData = vertexLayout.pack(imported.vertices, blobs.boundsMin, blobs.boundsMax);
+    blobs.vertexData = imported.vertexData.data();
+    blobs.vertexBytes = imported.vertexData.size();
+
+    imported.indexData = Mesh::packIndices(imported.indices, imported.vertices.size(), blobs.indexType);
+    blobs.indexData = imported.indexData.data();
+    blobs.indexCount = static_cast<unsigned int>(imported.indices.size());
+
+    if (vertexLayout.skinning && imported.hasBones) {
+        imported.skinData = VertexLayout::packSkin(imported.vertices);
+        blobs.skinData = imported.skinData.data();
+        blobs.skinBytes = imported.skinData.size();
+    }
 }
 
-// checks all material textures of a given type and loads the textures if they're not loaded yet.
-// the required info is returned as a Texture struct.
-vector<std::shared_ptr<Texture>> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName) {
-    vector<std::shared_ptr<Texture>> textures;
+// collects the paths of all material textures of a given type, loading them is left to uploadNextMesh
+vector<TextureRef> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName) const {
+    vector<TextureRef> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
         aiString str;
 
         mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-            if (std::strcmp(textures_loaded[j]->path.c_str(), str.C_Str()) == 0) {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
-        if (!skip) {   // if texture hasn't been loaded already, load it
-            directory = path->substr(0, path->find_last_of('/'));
-            string texturePath = string("\\" + directory + "\\" + str.C_Str());
-            replaceAll(texturePath, "/", "\\");
-            shared_ptr<Texture> texture = std::make_shared<Texture>(texturePath, typeName);
-            textures.push_back(texture);
-            textures_loaded.push_back(
-                    texture);  // store it as texture loaded for entire model, to ensure we won't unnecessarily load duplicate textures.
-        }
+        // directory was set by import before any mesh got processed
+        string texturePath = string("\\" + directory + "\\" + str.C_Str());
+        replaceAll(texturePath, "/", "\\");
+        textures.push_back({texturePath, typeName});
     }
     return textures;
 }
 
-vector<std::shared_ptr<Texture>> Model::forceLoadMaterialTexture(string path, aiTextureType type, string typeName) {
-    vector<std::shared_ptr<Texture>> textures;
-    // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-    bool skip = false;
-    for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-        if (std::strcmp(textures_loaded[j]->path.c_str(), path.c_str()) == 0) {
-            textures.push_back(textures_loaded[j]);
-            skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-            break;
-        }
-    }
-    if (!skip) {   // if texture hasn't been loaded already, load it
-        shared_ptr<Texture> texture = std::make_shared<Texture>(path, typeName);
-        textures.push_back(texture);
-        textures_loaded.push_back(
-                texture);  // store it as texture loaded for entire model, to ensure we won't unnecessarily load duplicate textures.
-    }
-    return textures;
-}
+shared_ptr<Texture> Model::findOrLoadTexture(const TextureRef &reference, const TextureLoadFunction &loadTexture) {
+    // check if texture was loaded before and if so, reuse it
+    auto found = textureLookup.find(reference.path);
+    if (found != textureLookup.end())
+        return textures_loaded[found->second];
 
+    shared_ptr<Texture> texture;
+    if (registry != nullptr)
+        texture = registry->texture(reference.path, reference.type);
+    else if (loadTexture)
+        texture = loadTexture(reference.path, reference.type);
+    else
+        texture = std::make_shared<Texture>(reference.path, reference.type);
+    textureLookup.emplace(reference.path, textures_loaded.size());
+    textures_loaded.push_back(
+            texture);  // store it as texture loaded for entire model, to ensure we won't unnecessarily load duplicate textures.
+    return texture;
+}
@@ -21,38 +21,118 @@ using namespace std;
 #include "Shader.h"
 #include "Texture.h"
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "Meshlet.h"
 #include <direct.h>
 #include <iostream>
+#include <functional>
+#include <unordered_map>
 
+class MeshletCuller;
+class MappedFile;
+class AssetRegistry;
+class ThreadPool;
+
+struct TextureRef {
+    string path;
+    string type;
+};
+
+// CPU side result of importing one mesh. Model::import fills these on any thread, Model::uploadNextMesh turns
+// them into Meshes on the GL thread.
+struct ImportedMesh {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    bool hasBones = false;
+    MeshletData meshletData;
+    vector<TextureRef> textures;
+    // meshes from the model cache only have packed streams, pointing into the mapped cache file
+    bool cooked = false;
+    // GPU-ready streams, packed by the importing thread so uploading is only the buffer creation. blobs points into
+    // these, or into the cache mapping for cooked meshes.
+    vector<uint8_t> vertexData, indexData, skinData;
+    MeshBlobs blobs;
+    // hash of everything that ends up on the GPU, lets AssetRegistry share identical meshes between models
+    uint64_t contentKey = 0;
+};
+
+// creates the Texture for a reference, e.g. synchronously or through the AssetLoader
+using TextureLoadFunction = std::function<shared_ptr<Texture>(const string &path, const string &type)>;
 
 class Model {
 public:
     // model data 
     vector<std::shared_ptr<Texture>> textures_loaded;    // stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
-    vector<Mesh> meshes;
+    vector<shared_ptr<Mesh>> meshes;
     string directory;
     bool gammaCorrection;
-
-    Model(string const *path, bool gamma = false) : path(path), gammaCorrection(gamma) {};
+    VertexLayout vertexLayout;
+    // weld, cache/overdraw/fetch reordering after import, see MeshOptimizer
+    bool optimizeMeshes = true;
+    // split meshes into meshlets so MeshletCuller can cull them on the GPU
+    bool buildMeshlets = true;
+    // load/store the cooked model from ModelCache, Assimp only runs when the entry is missing or stale
+    bool useModelCache = true;
+    // CPU copies the meshes keep after upload. Full has to go through Assimp, the model cache only has packed streams.
+    GeometryRetention geometryRetention = GeometryRetention::Discard;
+    // set by the AssetRegistry that owns this model, meshes and textures are then shared through it
+    AssetRegistry *registry = nullptr;
+
+    static constexpr unsigned int importFlags =
+            aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    Model(string const *path, bool gamma = false, VertexLayout vertexLayout = VertexLayout::Full())
+            : gammaCorrection(gamma), vertexLayout(vertexLayout), path(path) {};
+
+    // keeps its own copy of the path
+    Model(string path, bool gamma = false, VertexLayout vertexLayout = VertexLayout::Full())
+            : gammaCorrection(gamma), vertexLayout(vertexLayout), ownedPath(std::move(path)), path(&ownedPath) {};
 
     void Draw(Shader &shader);
 
+    // culls every mesh against the culler's current view and pass and draws what survived, see MeshletCuller::Cull
+    void DrawCulled(Shader &shader, MeshletCuller &culler, const glm::mat4 &model, const void *instance);
+
+    // import() followed by uploading every mesh, blocks until done
     void loadModel();
 
+    // CPU half of loading, makes no GL calls: cache lookup or Assimp import, optimization, meshlets, cache writing.
+    // With a pool the meshes are processed in parallel, the calling thread helps out.
+    bool import(ThreadPool *pool = nullptr);
+
+    // GL half, uploads the next imported mesh. Returns false once every mesh is uploaded.
+    bool uploadNextMesh(const TextureLoadFunction &loadTexture = nullptr);
+
     glm::vec3 futhestLenghtsFromCenter;
 
     void SimpleDraw(Shader &shader);
 
 private:
+    friend class ModelCache;
+
+    string ownedPath;
     string const *path;
 
-    void processNode(aiNode *node, const aiScene *scene);
+    // path -> index into textures_loaded
+    unordered_map<string, size_t> textureLookup;
+
+    vector<ImportedMesh> importedMeshes;
+    size_t uploadedMeshes = 0;
+    // keeps the cooked streams of importedMeshes alive until they are uploaded
+    shared_ptr<MappedFile> cacheFile;
+
+    // the scene's meshes in node order
+    void processNode(aiNode *node, const aiScene *scene, vector<aiMesh *> &sceneMeshes);
+
+    void processMesh(aiMesh *mesh, const aiScene *scene, ImportedMesh &imported, glm::vec3 &furthest) const;
+
+    void packStreams(ImportedMesh &imported) const;
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+    vector<TextureRef> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName) const;
 
-    vector<std::shared_ptr<Texture>> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName);
+    shared_ptr<Texture> findOrLoadTexture(const TextureRef &reference, const TextureLoadFunction &loadTexture);
 
-    vector<std::shared_ptr<Texture>> forceLoadMaterialTexture(string path, aiTextureType type, string typeName);
+    uint64_t contentKey(const ImportedMesh &mesh) const;
 
 };
 
@@ -0,0 +1,281 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ModelCache.h"
+#include "Model.h"
+#include "MappedFile.h"
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+namespace {
+    constexpr char magic[4] = {'R', 'G', 'L', 'M'};
+    // bump whenever the file layout or anything that changes the cooked data changes
+    constexpr uint32_t cacheVersion = 2;
+    constexpr size_t blobAlignment = 16;
+
+    struct CacheHeader {
+        char magic[4];
+        uint32_t version;
+        int64_t sourceTime;
+        uint64_t importKey;
+        uint32_t meshCount;
+        uint32_t textureCount;
+        uint64_t meshTableOffset;
+        uint64_t textureTableOffset;
+        float furthestFromCenter[3];
+        uint32_t padding;
+    };
+
+    struct CachedMesh {
+        uint64_t vertexOffset, vertexBytes;
+        uint64_t skinOffset, skinBytes;
+        uint64_t indexOffset;
+        uint32_t indexCount, indexType;
+        float boundsMin[3], boundsMax[3];
+        uint32_t hasBones;
+        uint32_t meshletCount;
+        uint64_t meshletOffset;
+        uint64_t meshletVertexOffset, meshletVertexCount;
+        uint64_t meshletTriangleOffset, meshletTriangleCount;
+        uint32_t firstTexture, textureCount;
+        float uvDensity;
+        uint32_t padding;
+    };
+
+    // strings live in the blob area, not null terminated
+    struct CachedTexture {
+        uint64_t pathOffset;
+        uint32_t pathLength;
+        uint32_t typeLength;
+        uint64_t typeOffset;
+    };
+
+    uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    class CacheWriter {
+    public:
+        std::vector<uint8_t> bytes;
+
+        uint64_t append(const void *data, size_t size) {
+            bytes.resize((bytes.size() + blobAlignment - 1) / blobAlignment * blobAlignment);
+            uint64_t offset = bytes.size();
+            bytes.resize(bytes.size() + size);
+            if (size > 0) memcpy(bytes.data() + offset, data, size);
+            return offset;
+        }
+    };
+
+    bool inFile(const MappedFile &file, uint64_t offset, uint64_t size) {
+        return offset <= file.size && size <= file.size - offset;
+    }
+}
+
+std::string ModelCache::cachePath(const std::string &sourcePath, uint64_t importKey) {
+    // the same file imported with other settings is another entry, not a stale one to overwrite
+    char name[34];
+    snprintf(name, sizeof(name), "%016llx_%016llx",
+             static_cast<unsigned long long>(fnv1a(sourcePath.data(), sourcePath.size())),
+             static_cast<unsigned long long>(importKey));
+    return std::string(directory) + name + ".rglm";
+}
+
+uint64_t ModelCache::importKey(const Model &model) {
+    uint32_t settings[] = {
+            Model::importFlags,
+            model.optimizeMeshes,
+            model.buildMeshlets,
+            static_cast<uint32_t>(model.vertexLayout.positionFormat),
+            model.vertexLayout.octahedralNormals,
+            model.vertexLayout.halfTexCoords,
+            model.vertexLayout.skinning,
+            MeshletBuilder::maxVertices,
+            MeshletBuilder::maxTriangles,
+    };
+    return fnv1a(settings, sizeof(settings));
+}
+
+int64_t ModelCache::sourceTime(const std::string &sourcePath) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(sourcePath, error);
+    if (error) return 0;
+    return static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+bool ModelCache::load(Model &model, const std::string &sourcePath) {
+    auto file = std::make_shared<MappedFile>(cachePath(sourcePath, importKey(model)));
+    if (!file->valid() || file->size < sizeof(CacheHeader)) return false;
+
+    CacheHeader header;
+    memcpy(&header, file->data, sizeof(header));
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != cacheVersion) return false;
+    int64_t time = sourceTime(sourcePath);
+    if (time == 0 || header.sourceTime != time || header.importKey != importKey(model)) {
+        spdlog::info("Model cache of {} is stale, reimporting", sourcePath);
+        return false;
+    }
+    if (!inFile(*file, header.meshTableOffset, uint64_t(header.meshCount) * sizeof(CachedMesh)) ||
+        !inFile(*file, header.textureTableOffset, uint64_t(header.textureCount) * sizeof(CachedTexture))) {
+        spdlog::warn("Model cache of {} is truncated, reimporting", sourcePath);
+        return false;
+    }
+
+    // validate everything before handing out pointers into the file
+    std::vector<CachedMesh> cachedMeshes(header.meshCount);
+    memcpy(cachedMeshes.data(), file->data + header.meshTableOffset, cachedMeshes.size() * sizeof(CachedMesh));
+    std::vector<CachedTexture> cachedTextures(header.textureCount);
+    memcpy(cachedTextures.data(), file->data + header.textureTableOffset,
+           cachedTextures.size() * sizeof(CachedTexture));
+    for (const CachedMesh &mesh: cachedMeshes) {
+        size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        if (!inFile(*file, mesh.vertexOffset, mesh.vertexBytes) || !inFile(*file, mesh.skinOffset, mesh.skinBytes) ||
+            !inFile(*file, mesh.indexOffset, uint64_t(mesh.indexCount) * indexSize) ||
+            !inFile(*file, mesh.meshletOffset, uint64_t(mesh.meshletCount) * sizeof(Meshlet)) ||
+            !inFile(*file, mesh.meshletVertexOffset, mesh.meshletVertexCount * sizeof(uint32_t)) ||
+            !inFile(*file, mesh.meshletTriangleOffset, mesh.meshletTriangleCount * sizeof(uint32_t)) ||
+            uint64_t(mesh.firstTexture) + mesh.textureCount > header.textureCount) {
+            spdlog::warn("Model cache of {} is truncated, reimporting", sourcePath);
+            return false;
+        }
+    }
+    for (const CachedTexture &texture: cachedTextures) {
+        if (!inFile(*file, texture.pathOffset, texture.pathLength) ||
+            !inFile(*file, texture.typeOffset, texture.typeLength)) {
+            spdlog::warn("Model cache of {} is truncated, reimporting", sourcePath);
+            return false;
+        }
+    }
+
+    model.directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+    model.futhestLenghtsFromCenter = glm::vec3(header.furthestFromCenter[0], header.furthestFromCenter[1],
+                                               header.furthestFromCenter[2]);
+    model.importedMeshes.reserve(header.meshCount);
+    for (const CachedMesh &cached: cachedMeshes) {
+        ImportedMesh imported;
+        imported.cooked = true;
+        imported.hasBones = cached.hasBones != 0;
+        for (uint32_t t = cached.firstTexture; t < cached.firstTexture + cached.textureCount; ++t) {
+            const CachedTexture &texture = cachedTextures[t];
+            imported.textures.push_back(
+                    {string(reinterpret_cast<const char *>(file->data + texture.pathOffset), texture.pathLength),
+                     string(reinterpret_cast<const char *>(file->data + texture.typeOffset), texture.typeLength)});
+        }
+
+        auto meshlets = reinterpret_cast<const Meshlet *>(file->data + cached.meshletOffset);
+        auto meshletVertices = reinterpret_cast<const uint32_t *>(file->data + cached.meshletVertexOffset);
+        auto meshletTriangles = reinterpret_cast<const uint32_t *>(file->data + cached.meshletTriangleOffset);
+        imported.meshletData.meshlets.assign(meshlets, meshlets + cached.meshletCount);
+        imported.meshletData.vertices.assign(meshletVertices, meshletVertices + cached.meshletVertexCount);
+        imported.meshletData.triangles.assign(meshletTriangles, meshletTriangles + cached.meshletTriangleCount);
+
+        MeshBlobs &blobs = imported.blobs;
+        blobs.vertexData = file->data + cached.vertexOffset;
+        blobs.vertexBytes = cached.vertexBytes;
+        if (cached.skinBytes > 0) {
+            blobs.skinData = file->data + cached.skinOffset;
+            blobs.skinBytes = cached.skinBytes;
+        }
+        blobs.indexData = file->data + cached.indexOffset;
+        blobs.indexCount = cached.indexCount;
+        blobs.indexType = cached.indexType;
+        blobs.boundsMin = glm::vec3(cached.boundsMin[0], cached.boundsMin[1], cached.boundsMin[2]);
+        blobs.boundsMax = glm::vec3(cached.boundsMax[0], cached.boundsMax[1], cached.boundsMax[2]);
+        blobs.uvDensity = cached.uvDensity;
+        model.importedMeshes.push_back(std::move(imported));
+    }
+    model.cacheFile = file;
+    return true;
+}
+
+bool ModelCache::save(const Model &model, const std::string &sourcePath) {
+    CacheWriter writer;
+    CacheHeader header{};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = cacheVersion;
+    header.sourceTime = sourceTime(sourcePath);
+    header.importKey = importKey(model);
+    header.meshCount = static_cast<uint32_t>(model.importedMeshes.size());
+    header.furthestFromCenter[0] = model.futhestLenghtsFromCenter.x;
+    header.furthestFromCenter[1] = model.futhestLenghtsFromCenter.y;
+    header.furthestFromCenter[2] = model.futhestLenghtsFromCenter.z;
+    if (header.sourceTime == 0) return false;
+    writer.append(&header, sizeof(header));
+
+    std::vector<CachedMesh> cachedMeshes(model.importedMeshes.size());
+    std::vector<CachedTexture> cachedTextures;
+    for (size_t m = 0; m < model.importedMeshes.size(); ++m) {
+        const ImportedMesh &mesh = model.importedMeshes[m];
+        CachedMesh &cached = cachedMeshes[m];
+        // the streams were already packed during import, exactly what Mesh::upload takes
+        const MeshBlobs &blobs = mesh.blobs;
+        cached.vertexOffset = writer.append(blobs.vertexData, blobs.vertexBytes);
+        cached.vertexBytes = blobs.vertexBytes;
+        if (blobs.skinData != nullptr) {
+            cached.skinOffset = writer.append(blobs.skinData, blobs.skinBytes);
+            cached.skinBytes = blobs.skinBytes;
+        }
+        cached.indexOffset = writer.append(blobs.indexData, mesh.indexData.size());
+        cached.indexCount = blobs.indexCount;
+        cached.indexType = blobs.indexType;
+        memcpy(cached.boundsMin, &blobs.boundsMin, sizeof(cached.boundsMin));
+        memcpy(cached.boundsMax, &blobs.boundsMax, sizeof(cached.boundsMax));
+        cached.hasBones = mesh.hasBones;
+        cached.uvDensity = blobs.uvDensity;
+
+        const MeshletData &meshletData = mesh.meshletData;
+        cached.meshletCount = static_cast<uint32_t>(meshletData.meshlets.size());
+        cached.meshletOffset = writer.append(meshletData.meshlets.data(), meshletData.meshlets.size() * sizeof(Meshlet));
+        cached.meshletVertexCount = meshletData.vertices.size();
+        cached.meshletVertexOffset = writer.append(meshletData.vertices.data(),
+                                                   meshletData.vertices.size() * sizeof(uint32_t));
+        cached.meshletTriangleCount = meshletData.triangles.size();
+        cached.meshletTriangleOffset = writer.append(meshletData.triangles.data(),
+                                                     meshletData.triangles.size() * sizeof(uint32_t));
+
+        cached.firstTexture = static_cast<uint32_t>(cachedTextures.size());
+        cached.textureCount = static_cast<uint32_t>(mesh.textures.size());
+        for (const TextureRef &texture: mesh.textures) {
+            CachedTexture cachedTexture{};
+            cachedTexture.pathOffset = writer.append(texture.path.data(), texture.path.size());
+            cachedTexture.pathLength = static_cast<uint32_t>(texture.path.size());
+            cachedTexture.typeOffset = writer.append(texture.type.data(), texture.type.size());
+            cachedTexture.typeLength = static_cast<uint32_t>(texture.type.size());
+            cachedTextures.push_back(cachedTexture);
+        }
+    }
+    header.textureCount = static_cast<uint32_t>(cachedTextures.size());
+    header.meshTableOffset = writer.append(cachedMeshes.data(), cachedMeshes.size() * sizeof(CachedMesh));
+    header.textureTableOffset = writer.append(cachedTextures.data(), cachedTextures.size() * sizeof(CachedTexture));
+    memcpy(writer.bytes.data(), &header, sizeof(header));
+
+    // write next to the target and rename, a crash mid write must not leave a valid looking entry
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string path = cachePath(sourcePath, importKey(model));
+    // per thread, two loads of one model can both be writing it
+    std::string temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        spdlog::warn("Failed to write model cache " + path);
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(writer.bytes.data()), static_cast<std::streamsize>(writer.bytes.size()));
+    out.close();
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        spdlog::warn("Failed to write model cache " + path + ": " + error.message());
+        return false;
+    }
+    spdlog::info("Cooked {} into {} ({} B)", sourcePath, path, writer.bytes.size());
+    return true;
+}
@@ -0,0 +1,36 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_MODELCACHE_H
+#define REASONABLEGL_MODELCACHE_H
+
+#include <cstdint>
+#include <string>
+
+class Model;
+
+// Cooked models: the final GPU-ready vertex/index streams, bounds, meshlets and material texture references of a
+// Model, written after the first Assimp import and memory mapped on later runs. An entry is only used while the
+// source file's modification time and the import settings (Assimp flags, optimization, meshlets, vertex layout)
+// still match what it was cooked with.
+class ModelCache {
+public:
+    static constexpr const char *directory = "res/cache/models/";
+
+    // Fills the model's imported meshes from the cache, false if there is no entry or it is stale.
+    static bool load(Model &model, const std::string &sourcePath);
+
+    // Writes the model's imported meshes, call before they are uploaded.
+    static bool save(const Model &model, const std::string &sourcePath);
+
+    static std::string cachePath(const std::string &sourcePath, uint64_t importKey);
+
+    static uint64_t importKey(const Model &model);
+
+private:
+    static int64_t sourceTime(const std::string &sourcePath);
+};
+
+
+#endif //REASONABLEGL_MODELCACHE_H
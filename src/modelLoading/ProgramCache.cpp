@@ -0,0 +1,134 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ProgramCache.h"
+#include "AssetRegistry.h"
+#include "spdlog/spdlog.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace {
+    constexpr char magic[4] = {'R', 'G', 'L', 'P'};
+    constexpr uint32_t cacheVersion = 1;
+
+    struct ProgramHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+    std::string glString(GLenum name) {
+        const auto *value = reinterpret_cast<const char *>(glGetString(name));
+        return value != nullptr ? value : "";
+    }
+}
+
+bool ProgramCache::supported() {
+    static const bool formats = [] {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+        if (count == 0) spdlog::info("Driver offers no program binary formats, program cache disabled");
+        return count > 0;
+    }();
+    return enabled && formats;
+}
+
+uint64_t ProgramCache::key(const std::vector<std::string> &sources) {
+    // a driver update changes the binary format without telling anyone, so it is part of the key
+    static const uint64_t driver = AssetRegistry::hash(glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" +
+                                                       glString(GL_VERSION));
+    uint64_t value = driver;
+    for (const std::string &source: sources) {
+        uint64_t length = source.size();
+        value = AssetRegistry::hash(&length, sizeof(length), value);
+        value = AssetRegistry::hash(source, value);
+    }
+    return value;
+}
+
+std::string ProgramCache::cachePath(uint64_t key) {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return std::string(directory) + name + ".rglp";
+}
+
+GLuint ProgramCache::load(uint64_t key) {
+    if (!supported()) return 0;
+    std::string path = cachePath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return 0;
+
+    ProgramHeader header{};
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != cacheVersion ||
+        header.key != key)
+        return 0;
+    // the length comes from disk, a truncated or corrupt entry must not size the allocation
+    std::error_code error;
+    uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if (error || sizeof(header) + static_cast<uintmax_t>(header.binaryLength) > fileSize ||
+        header.binaryLength > static_cast<uint32_t>(std::numeric_limits<GLsizei>::max())) {
+        spdlog::info("Cached program {} is truncated, compiling from source", path);
+        return 0;
+    }
+    std::vector<char> binary(header.binaryLength);
+    in.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!in) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        spdlog::info("Driver rejected cached program {}, compiling from source", path);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::prepare(GLuint program) {
+    if (supported()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::save(GLuint program, uint64_t key) {
+    if (!supported()) return;
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (linked != GL_TRUE || length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramHeader header{};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = cacheVersion;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binaryLength = static_cast<uint32_t>(length);
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string path = cachePath(key);
+    // write next to the target and rename, a crash mid write must not leave a valid looking entry
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        spdlog::warn("Failed to write program cache " + path);
+        return;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(binary.data(), length);
+    out.close();
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) spdlog::warn("Failed to write program cache " + path + ": " + error.message());
+}
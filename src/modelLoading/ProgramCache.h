@@ -0,0 +1,41 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_PROGRAMCACHE_H
+#define REASONABLEGL_PROGRAMCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "glad/glad.h"
+
+// Linked program binaries from glGetProgramBinary, stored per program so start-up can skip compiling. Entries are
+// keyed by the final source of every stage (defines and layouts already substituted) and the driver's vendor,
+// renderer and version, any change to either simply misses. Drivers may still reject a binary, then the caller
+// compiles from source as usual and the entry gets rewritten.
+class ProgramCache {
+public:
+    static constexpr const char *directory = "res/cache/programs/";
+
+    static inline bool enabled = true;
+
+    static uint64_t key(const std::vector<std::string> &sources);
+
+    // A linked program created from the cached binary, 0 if there is none or the driver rejected it.
+    static GLuint load(uint64_t key);
+
+    // Call before glLinkProgram on programs that will be saved.
+    static void prepare(GLuint program);
+
+    // Stores a successfully linked program, anything else is ignored.
+    static void save(GLuint program, uint64_t key);
+
+private:
+    static std::string cachePath(uint64_t key);
+
+    static bool supported();
+};
+
+
+#endif //REASONABLEGL_PROGRAMCACHE_H
@@ -1,56 +1,88 @@
 #include "Shader.h"
+#include "ProgramCache.h"
+#include "ShaderBatch.h"
 
 
 void Shader::init() {
-    // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch (std::ifstream::failure &e) {
-        spdlog::error("FILE_NOT_SUCCESSFULLY_READ:", e.what());
+    submit();
+    finish();
+}
+
+void Shader::initWithGeometry() {
+    submit(true);
+    finish();
+}
+
+void Shader::submit(bool withGeometry) {
+    if (submitted) return;
+    submitted = true;
+    // 1. retrieve the source code from filePath, with includes and defines resolved
+    ShaderSource vertexSource = ShaderPreprocessor::process(vertexPath, defines);
+    ShaderSource fragmentSource = ShaderPreprocessor::process(fragmentPath, defines);
+    ShaderSource geometrySource;
+    withGeometry = withGeometry && geometryPath != nullptr;
+    if (withGeometry) geometrySource = ShaderPreprocessor::process(geometryPath, defines);
+    const std::string &vertexCode = vertexSource.code;
+    const std::string &fragmentCode = fragmentSource.code;
+    const std::string &geometryCode = geometrySource.code;
+    vertexSources = ShaderPreprocessor::describe(vertexSource);
+    fragmentSources = ShaderPreprocessor::describe(fragmentSource);
+    geometrySources = ShaderPreprocessor::describe(geometrySource);
+
+    // a cached binary of exactly these sources skips compiling altogether
+    cacheKey = withGeometry ? ProgramCache::key({vertexCode, fragmentCode, geometryCode})
+                            : ProgramCache::key({vertexCode, fragmentCode});
+    ID = ProgramCache::load(cacheKey);
+    if (ID != 0) {
+        finished = true;
+        return;
     }
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment;
-    // vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    // fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
+
+    // 2. compile and link, the statuses are only queried in finish() so the driver can work on it meanwhile
+    auto compile = [](GLenum type, const std::string &code) {
+        const char *source = code.c_str();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        return shader;
+    };
+    vertex = compile(GL_VERTEX_SHADER, vertexCode);
+    fragment = compile(GL_FRAGMENT_SHADER, fragmentCode);
+    if (withGeometry) geometry = compile(GL_GEOMETRY_SHADER, geometryCode);
+
     // shader Program
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    if (geometry != 0)
+        glAttachShader(ID, geometry);
+    ProgramCache::prepare(ID);
     glLinkProgram(ID);
+}
+
+bool Shader::ready() const {
+    if (!submitted) return false;
+    if (finished || !ShaderBatch::parallel()) return true;
+    GLint done = GL_FALSE;
+    glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+void Shader::finish() {
+    if (!submitted || finished) return;
+    finished = true;
+    checkCompileErrors(vertex, "VERTEX", vertexSources);
+    checkCompileErrors(fragment, "FRAGMENT", fragmentSources);
+    if (geometry != 0)
+        checkCompileErrors(geometry, "GEOMETRY", geometrySources);
     checkCompileErrors(ID, "PROGRAM");
+    ProgramCache::save(ID, cacheKey);
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    if (geometry != 0)
+        glDeleteShader(geometry);
+    vertex = fragment = geometry = 0;
 }
 
 void Shader::use() const {
@@ -86,7 +118,7 @@ void Shader::setVec3(const std::string &name, glm::vec3 vec3) {
 
 }
 
-void Shader::checkCompileErrors(unsigned int shader, std::string type) {
+void Shader::checkCompileErrors(unsigned int shader, std::string type, const std::string &sources) {
     int success;
     std::string stringFragmentPath = fragmentPath;
     std::string stringVertexPath = vertexPath;
@@ -95,8 +127,8 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type) {
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         if (!success) {
             glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            spdlog::error(
-                    "Shader in path: " + stringFragmentPath + " has compilation error of type: " + type + infoLog);
+            spdlog::error("Shader in path: " + stringFragmentPath + " has compilation error of type: " + type + infoLog +
+                          " (sources: " + sources + ")");
         }
     } else {
         glGetProgramiv(shader, GL_LINK_STATUS, &success);
@@ -106,84 +138,3 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type) {
         }
     }
 }
-
-void Shader::initWithGeometry() {
-    // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::string geometryCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    std::ifstream gShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-        // if geometry shader path is present, also load a geometry shader
-        if (geometryPath != nullptr) {
-            gShaderFile.open(geometryPath);
-            std::stringstream gShaderStream;
-            gShaderStream << gShaderFile.rdbuf();
-            gShaderFile.close();
-            geometryCode = gShaderStream.str();
-        }
-    }
-    catch (std::ifstream::failure &e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-    }
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment;
-    // vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    // fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    // if geometry shader is given, compile geometry shader
-    unsigned int geometry;
-    if (geometryPath != nullptr) {
-        const char *gShaderCode = geometryCode.c_str();
-        geometry = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(geometry, 1, &gShaderCode, NULL);
-        glCompileShader(geometry);
-        checkCompileErrors(geometry, "GEOMETRY");
-    }
-    // shader Program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    if (geometryPath != nullptr)
-        glAttachShader(ID, geometry);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
-    // delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-    if (geometryPath != nullptr)
-        glDeleteShader(geometry);
-
-}
-
-
-
-
@@ -1,6 +1,7 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <sstream>
@@ -9,6 +10,7 @@
 #include "glm/detail/type_vec3.hpp"
 #include "glm/vec3.hpp"
 #include "glad/glad.h"
+#include "ShaderPreprocessor.h"
 
 
 class Shader {
@@ -16,6 +18,9 @@ public:
     // the program ID
     GLuint ID;
 
+    // injected into every stage by ShaderPreprocessor, set them before the shader is submitted
+    ShaderDefines defines;
+
     // constructor reads and builds the shader
     Shader(const char *vertexPath, const char *fragmentPath)
             : vertexPath(vertexPath), fragmentPath(fragmentPath) {}
@@ -24,13 +29,26 @@ public:
     Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath)
             : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath) {}
 
+    Shader(const char *vertexPath, const char *fragmentPath, ShaderDefines defines)
+            : defines(std::move(defines)), vertexPath(vertexPath), fragmentPath(fragmentPath) {}
+
     // use/activate the shader
     void use() const;
 
+    // compiles and links, blocking until the driver is done
     void init();
 
     void initWithGeometry();
 
+    // Hands compile and link to the driver without waiting for it, init() or finish() complete the program later.
+    void submit(bool withGeometry = false);
+
+    // Polls GL_COMPLETION_STATUS_KHR, the program can be finished without stalling once this is true.
+    bool ready() const;
+
+    // Reports compile/link errors and stores the program binary, blocks if the driver isn't done yet.
+    void finish();
+
     // utility uniform functions
     void setBool(const std::string &name, bool value) const;
 
@@ -51,9 +69,17 @@ private:
     const char *fragmentPath{};
     const char *geometryPath{};
 
+    // stage objects stay alive between submit() and finish() for the error log
+    GLuint vertex = 0, fragment = 0, geometry = 0;
+    uint64_t cacheKey = 0;
+    bool submitted = false;
+    bool finished = false;
+    // source string numbers of every stage for the error log, see ShaderPreprocessor::describe
+    std::string vertexSources, fragmentSources, geometrySources;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(unsigned int shader, std::string type);
+    void checkCompileErrors(unsigned int shader, std::string type, const std::string &sources = "");
 
 };
 
@@ -0,0 +1,65 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ShaderBatch.h"
+#include "Shader.h"
+#include "ComputeShader.h"
+#include "spdlog/spdlog.h"
+#include <cstring>
+
+void ShaderBatch::configure(GLADloadproc loadProc) {
+    bool khr = false, arb = false;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; ++i) {
+        const auto *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (name == nullptr) continue;
+        if (strcmp(name, "GL_KHR_parallel_shader_compile") == 0) khr = true;
+        if (strcmp(name, "GL_ARB_parallel_shader_compile") == 0) arb = true;
+    }
+    if (!khr && !arb) {
+        spdlog::info("No parallel shader compile extension, programs are compiled one after another");
+        return;
+    }
+
+    // looked up by hand, the glad build doesn't necessarily include the extension
+    using MaxThreadsProc = void (*)(GLuint count);
+    auto maxThreads = reinterpret_cast<MaxThreadsProc>(
+            loadProc(khr ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB"));
+    // 0xFFFFFFFF leaves the thread count to the driver
+    if (maxThreads != nullptr) maxThreads(0xFFFFFFFFu);
+    parallelCompile = true;
+}
+
+bool ShaderBatch::parallel() {
+    return parallelCompile;
+}
+
+void ShaderBatch::add(Shader &shader, bool withGeometry) {
+    shader.submit(withGeometry);
+    shaders.push_back(&shader);
+}
+
+void ShaderBatch::add(ComputeShader &shader) {
+    shader.submit();
+    computeShaders.push_back(&shader);
+}
+
+bool ShaderBatch::ready() const {
+    return pendingCount() == 0;
+}
+
+size_t ShaderBatch::pendingCount() const {
+    size_t pending = 0;
+    for (const Shader *shader: shaders) pending += shader->ready() ? 0 : 1;
+    for (const ComputeShader *shader: computeShaders) pending += shader->ready() ? 0 : 1;
+    return pending;
+}
+
+void ShaderBatch::finish() {
+    for (Shader *shader: shaders) shader->finish();
+    for (ComputeShader *shader: computeShaders) shader->finish();
+    shaders.clear();
+    computeShaders.clear();
+}
@@ -0,0 +1,50 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_SHADERBATCH_H
+#define REASONABLEGL_SHADERBATCH_H
+
+#include <cstddef>
+#include <vector>
+#include "glad/glad.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+class Shader;
+
+class ComputeShader;
+
+// Submits the compile and link of many programs before anything asks for a status, so a driver with
+// KHR_parallel_shader_compile works on all of them at once on its own threads. Without the extension the
+// batch still works, the driver then compiles when finish() queries the first status.
+class ShaderBatch {
+public:
+    // Detects the extension and lets the driver use as many compiler threads as it wants, call once after glad.
+    static void configure(GLADloadproc loadProc);
+
+    static bool parallel();
+
+    void add(Shader &shader, bool withGeometry = false);
+
+    void add(ComputeShader &shader);
+
+    // Non blocking, true once every program linked.
+    bool ready() const;
+
+    size_t pendingCount() const;
+
+    // Blocks until everything is linked and reports errors.
+    void finish();
+
+private:
+    static inline bool parallelCompile = false;
+
+    std::vector<Shader *> shaders;
+    std::vector<ComputeShader *> computeShaders;
+};
+
+
+#endif //REASONABLEGL_SHADERBATCH_H
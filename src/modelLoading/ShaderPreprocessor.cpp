@@ -0,0 +1,113 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ShaderPreprocessor.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    // the quoted file name if line is an #include directive, empty otherwise
+    std::string includedFile(const std::string &line) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) return "";
+        size_t open = line.find('"', start + 8);
+        size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        if (close == std::string::npos) return "";
+        return line.substr(open + 1, close - open - 1);
+    }
+
+    bool isVersion(const std::string &line) {
+        size_t start = line.find_first_not_of(" \t");
+        return start != std::string::npos && line.compare(start, 8, "#version") == 0;
+    }
+
+    std::string directoryOf(const std::string &path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+}
+
+ShaderSource ShaderPreprocessor::process(const std::string &path, const ShaderDefines &defines) {
+    ShaderSource source;
+    if (!expand(path, &defines, source)) source.code.clear();
+    return source;
+}
+
+bool ShaderPreprocessor::expand(const std::string &path, const ShaderDefines *defines, ShaderSource &source) {
+    std::string contents;
+    if (!readFile(path, contents)) return false;
+    auto fileIndex = static_cast<int>(source.files.size());
+    source.files.push_back(path);
+
+    auto insertDefines = [&](int nextLine) {
+        for (const auto &[name, value]: *defines) source.code += "#define " + name + " " + value + "\n";
+        source.code += "#line " + std::to_string(nextLine) + " " + std::to_string(fileIndex) + "\n";
+    };
+
+    std::istringstream lines(contents);
+    std::string line;
+    int lineNumber = 0;
+    bool definesPending = defines != nullptr;
+    if (!definesPending) source.code += "#line 1 " + std::to_string(fileIndex) + "\n";
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        if (definesPending && isVersion(line)) {
+            // #version has to stay the first thing in the shader
+            source.code += line + "\n";
+            insertDefines(lineNumber + 1);
+            definesPending = false;
+            continue;
+        }
+        if (definesPending) {
+            insertDefines(lineNumber);
+            definesPending = false;
+        }
+
+        std::string include = includedFile(line);
+        if (include.empty()) {
+            source.code += line + "\n";
+            continue;
+        }
+        std::string includePath = directoryOf(path) + include;
+        if (!std::ifstream(includePath).good()) includePath = std::string(includeDirectory) + include;
+        if (std::find(source.files.begin(), source.files.end(), includePath) == source.files.end()) {
+            if (!expand(includePath, nullptr, source)) {
+                spdlog::error("Shader " + path + " line " + std::to_string(lineNumber) + ": can't include " + include);
+                return false;
+            }
+        }
+        source.code += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+    }
+    if (definesPending) insertDefines(1);
+    return true;
+}
+
+bool ShaderPreprocessor::readFile(const std::string &path, std::string &contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        spdlog::error("FILE_NOT_SUCCESSFULLY_READ: " + path);
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+std::string ShaderPreprocessor::key(const ShaderDefines &defines) {
+    std::string key;
+    for (const auto &[name, value]: defines) key += name + "=" + value + ";";
+    return key;
+}
+
+std::string ShaderPreprocessor::describe(const ShaderSource &source) {
+    std::string description;
+    for (size_t i = 0; i < source.files.size(); ++i) {
+        if (i != 0) description += ", ";
+        description += std::to_string(i) + " = " + source.files[i];
+    }
+    return description;
+}
@@ -0,0 +1,46 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_SHADERPREPROCESSOR_H
+#define REASONABLEGL_SHADERPREPROCESSOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+// name -> value, injected as #define name value. Sorted so equal sets always give the same source and cache key.
+using ShaderDefines = std::map<std::string, std::string>;
+
+struct ShaderSource {
+    std::string code;
+    // source string numbers of the #line directives, index 0 is the file that was processed
+    std::vector<std::string> files;
+};
+
+// Turns a shader file into the string handed to glShaderSource:
+// - #include "file" is replaced by the file, looked up next to the including file and then in includeDirectory.
+//   Every file is included at most once, so includes need no guards and can't recurse.
+// - the defines are inserted right after #version, shaders use #ifndef to give them defaults.
+// - #line directives keep compile errors pointing at the right line, describe() names the source strings.
+class ShaderPreprocessor {
+public:
+    static constexpr const char *includeDirectory = "res/shaders/include/";
+
+    // An empty code string means the file couldn't be read, errors are logged.
+    static ShaderSource process(const std::string &path, const ShaderDefines &defines = {});
+
+    // "NAME=VALUE;..." for keying permutations
+    static std::string key(const ShaderDefines &defines);
+
+    // "0 = path, 1 = include" for error messages
+    static std::string describe(const ShaderSource &source);
+
+private:
+    static bool expand(const std::string &path, const ShaderDefines *defines, ShaderSource &source);
+
+    static bool readFile(const std::string &path, std::string &contents);
+};
+
+
+#endif //REASONABLEGL_SHADERPREPROCESSOR_H
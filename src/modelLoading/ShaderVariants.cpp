@@ -0,0 +1,43 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "ShaderVariants.h"
+#include "ShaderBatch.h"
+#include <chrono>
+
+ShaderVariants::Variant &ShaderVariants::variant(const ShaderDefines &permutation) {
+    Variant &variant = variants[ShaderPreprocessor::key(permutation)];
+    if (variant.shader == nullptr) {
+        ShaderDefines variantDefines = defines;
+        for (const auto &[name, value]: permutation) variantDefines[name] = value;
+        variant.shader = std::make_unique<Shader>(vertexPath.c_str(), fragmentPath.c_str(), std::move(variantDefines));
+    }
+    return variant;
+}
+
+Shader &ShaderVariants::get(const ShaderDefines &permutation) {
+    Variant &found = variant(permutation);
+    if (!found.created) {
+        found.created = true;
+        auto start = std::chrono::steady_clock::now();
+        // a no-op for the parts submit() or a batch already did
+        found.shader->init();
+        spdlog::info("Shader variant {} [{}] ready in {:.2f} ms", fragmentPath, ShaderPreprocessor::key(permutation),
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        found.shader->use();
+        if (onCreate) onCreate(*found.shader);
+    }
+    return *found.shader;
+}
+
+void ShaderVariants::submit(ShaderBatch &batch, const ShaderDefines &permutation) {
+    batch.add(*variant(permutation).shader);
+}
+
+std::vector<Shader *> ShaderVariants::all() const {
+    std::vector<Shader *> shaders;
+    for (const auto &[key, found]: variants)
+        if (found.created) shaders.push_back(found.shader.get());
+    return shaders;
+}
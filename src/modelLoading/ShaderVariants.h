@@ -0,0 +1,58 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_SHADERVARIANTS_H
+#define REASONABLEGL_SHADERVARIANTS_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+
+class ShaderBatch;
+
+// One vertex/fragment pair compiled into specialized programs, one per permutation of defines (shadows on/off,
+// feature flags, ...), so no variant pays for branches it never takes. A variant is compiled the first time it is
+// asked for and kept, its binary additionally lands in the ProgramCache like every other program.
+class ShaderVariants {
+public:
+    ShaderVariants(std::string vertexPath, std::string fragmentPath, ShaderDefines defines = {})
+            : vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)), defines(std::move(defines)) {}
+
+    ShaderVariants(const ShaderVariants &) = delete;
+
+    ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+    // Runs once on every variant right after it is linked and in use, e.g. to set sampler units.
+    std::function<void(Shader &)> onCreate;
+
+    // The program for the permutation on top of the base defines, compiled and linked first if it is new.
+    Shader &get(const ShaderDefines &permutation = {});
+
+    // Starts compiling a permutation that will be needed soon without waiting for it.
+    void submit(ShaderBatch &batch, const ShaderDefines &permutation = {});
+
+    // every variant created so far
+    std::vector<Shader *> all() const;
+
+private:
+    struct Variant {
+        std::unique_ptr<Shader> shader;
+        bool created = false;
+    };
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    ShaderDefines defines;
+    // ShaderPreprocessor::key of the permutation
+    std::unordered_map<std::string, Variant> variants;
+
+    Variant &variant(const ShaderDefines &permutation);
+};
+
+
+#endif //REASONABLEGL_SHADERVARIANTS_H
@@ -1,4 +1,6 @@
 #include "Texture.h"
+#include "TextureCooker.h"
+#include "MappedFile.h"
 
 
 void Texture::use(GLenum GL_TEXTUREX) {
@@ -7,40 +9,181 @@ void Texture::use(GLenum GL_TEXTUREX) {
 }
 
 Texture::~Texture() {
-    glDeleteTextures(1, &ID);
+    // deferred textures that never got uploaded have nothing to free
+    if (ID != 0) glDeleteTextures(1, &ID);
 }
 
 Texture::Texture(string path, string type) {
-    glGenTextures(1, &ID);
-    // set the texture wrapping/filtering options (on the currently bound texture object) //TODO this prob should be in class inputs
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format;
-        if (nrChannels == 1) //nifty 
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, ID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    TextureSource source = TextureSource::load(path, type);
+    if (!source.valid()) {
+        spdlog::error("Failed to load texture: " + path);
+        return;
+    }
+    upload(source, source.bytes);
+    name = path.substr(path.find_last_of('/') + 1);
+    this->path = path;
+    this->type = type;
+}
+
+shared_ptr<Texture> Texture::deferred(const string &path, const string &type) {
+    shared_ptr<Texture> texture(new Texture());
+    texture->name = path.substr(path.find_last_of('/') + 1);
+    texture->path = path;
+    texture->type = type;
+    return texture;
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+namespace {
+    // where GL reads the byte at offset into source.bytes, base holding the bytes from baseOffset on. Without base
+    // they sit in the bound GL_PIXEL_UNPACK_BUFFER and GL takes the pointer as a byte offset into it.
+    const void *at(const unsigned char *base, size_t baseOffset, size_t offset) {
+        size_t relative = offset - baseOffset;
+        if (base == nullptr) return reinterpret_cast<const void *>(relative);
+        return base + relative;
+    }
+}
 
-        stbi_image_free(data);
-        name = path.substr(path.find_last_of('/') + 1);
-        this->path = path;
-        this->type = type;
+void Texture::upload(const TextureSource &source, const unsigned char *base, size_t baseOffset) {
+    if (ID == 0) glGenTextures(1, &ID);
+    glBindTexture(GL_TEXTURE_2D, ID);
+    if (source.compressed) {
+        int levelCount = static_cast<int>(source.levels.size());
+        int first = streamingStartLevel(source);
+        const TextureSource::Level &top = source.levels[first];
+        glTexStorage2D(GL_TEXTURE_2D, levelCount - first, source.format, top.width, top.height);
+        for (int level = first; level < levelCount; ++level) {
+            const TextureSource::Level &data = source.levels[level];
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level - first, 0, 0, data.width, data.height, source.format,
+                                      static_cast<GLsizei>(data.size), at(base, baseOffset, data.offset));
+        }
+        allocatedLevel = residentLevel = startLevel = first;
+        minLod = static_cast<float>(first);
+        if (streamingStartResolution > 0) streamSource = make_shared<TextureSource>(source);
+        gpuBytes = 0;
+        for (int level = first; level < levelCount; ++level) gpuBytes += source.levels[level].size;
     } else {
-        spdlog::error("Failed to load texture: " + path);
-        std::string filename = path.substr(path.find_last_of('/') + 1);
-        spdlog::error("Failed to load texture: " + filename);
+        const TextureSource::Level &data = source.levels[0];
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(source.format), data.width, data.height, 0, source.format,
+                     GL_UNSIGNED_BYTE, at(base, baseOffset, data.offset));
+        glGenerateMipmap(GL_TEXTURE_2D);
+        gpuBytes = data.size * 4 / 3; // the generated chain
+    }
+    setSamplerState();
+    uploaded = true;
+}
+
+void Texture::setSamplerState() {
+    // set the texture wrapping/filtering options (on the currently bound texture object) //TODO this prob should be in class inputs
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+int Texture::streamingStartLevel(const TextureSource &source) {
+    if (!source.compressed || streamingStartResolution <= 0) return 0;
+    int level = 0;
+    while (level + 1 < static_cast<int>(source.levels.size()) &&
+           std::max(source.levels[level].width, source.levels[level].height) > streamingStartResolution)
+        level++;
+    return level;
+}
+
+size_t Texture::streamedBytes(int firstLevel) const {
+    size_t bytes = 0;
+    for (size_t level = firstLevel; level < streamSource->levels.size(); ++level)
+        bytes += streamSource->levels[level].size;
+    return bytes;
+}
+
+void Texture::allocateStreamed(int firstLevel) {
+    const TextureSource &source = *streamSource;
+    int levelCount = static_cast<int>(source.levels.size());
+    const TextureSource::Level &top = source.levels[firstLevel];
+
+    GLuint replacement;
+    glGenTextures(1, &replacement);
+    glBindTexture(GL_TEXTURE_2D, replacement);
+    glTexStorage2D(GL_TEXTURE_2D, levelCount - firstLevel, source.format, top.width, top.height);
+    // resident levels still in range move over on the GPU, no round trip through the file
+    int firstCopied = std::max(residentLevel, firstLevel);
+    for (int level = firstCopied; level < levelCount; ++level) {
+        glCopyImageSubData(ID, GL_TEXTURE_2D, level - allocatedLevel, 0, 0, 0, replacement, GL_TEXTURE_2D,
+                           level - firstLevel, 0, 0, 0, source.levels[level].width, source.levels[level].height, 1);
     }
+    setSamplerState();
+    glDeleteTextures(1, &ID);
+    ID = replacement;
+    allocatedLevel = firstLevel;
+    residentLevel = firstCopied;
+    minLod = std::max(minLod, static_cast<float>(residentLevel));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, residentLevel - allocatedLevel);
+    setMinLod(minLod);
+    gpuBytes = streamedBytes(firstLevel);
+}
+
+void Texture::uploadStreamedLevel(int level, const unsigned char *base, size_t baseOffset) {
+    const TextureSource::Level &data = streamSource->levels[level];
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level - allocatedLevel, 0, 0, data.width, data.height,
+                              streamSource->format, static_cast<GLsizei>(data.size), at(base, baseOffset, data.offset));
+    residentLevel = level;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, residentLevel - allocatedLevel);
+    // MIN_LOD counts from the base level that just moved
+    setMinLod(minLod);
 }
+
+void Texture::setMinLod(float lod) {
+    minLod = lod;
+    glBindTexture(GL_TEXTURE_2D, ID);
+    // MIN_LOD counts from GL_TEXTURE_BASE_LEVEL, which is chain level residentLevel
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, std::max(0.0f, lod - static_cast<float>(residentLevel)));
+}
+
+TextureSource TextureSource::load(const string &path, const string &type, ThreadPool *pool) {
+    TextureSource source;
+    if (Texture::useCookedTextures) {
+        TextureCookSettings settings;
+        settings.highQuality = Texture::highQualityCooking;
+        string cookedPath = TextureCooker::cachePath(path, type, settings);
+        auto file = make_shared<MappedFile>(cookedPath);
+        if (TextureCooker::validate(*file, path, type) == nullptr) {
+            file.reset(); // the cooker replaces the file, it can't be mapped meanwhile
+            if (TextureCooker::cook(path, type, settings, pool)) file = make_shared<MappedFile>(cookedPath);
+        }
+        const CookedTextureHeader *header = file ? TextureCooker::validate(*file, path, type) : nullptr;
+        if (header != nullptr) {
+            const CookedTextureLevel *levels = TextureCooker::levels(*file);
+            source.compressed = true;
+            source.format = header->glInternalFormat;
+            for (uint32_t level = 0; level < header->levelCount; ++level) {
+                source.levels.push_back({static_cast<size_t>(levels[level].byteOffset),
+                                         static_cast<size_t>(levels[level].byteLength),
+                                         static_cast<int>(std::max(1u, header->width >> level)),
+                                         static_cast<int>(std::max(1u, header->height >> level))});
+            }
+            source.bytes = file->data;
+            source.size = file->size;
+            source.mapping = file;
+            return source;
+        }
+    }
+
+    // load and generate the texture
+    int width, height, nrChannels;
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+    if (!data) return source;
+    if (nrChannels == 1) //nifty
+        source.format = GL_RED;
+    else if (nrChannels == 2)
+        source.format = GL_RG;
+    else if (nrChannels == 3)
+        source.format = GL_RGB;
+    else
+        source.format = GL_RGBA;
+    source.size = static_cast<size_t>(width) * height * nrChannels;
+    source.levels.push_back({0, source.size, width, height});
+    source.pixels = shared_ptr<unsigned char>(data, stbi_image_free);
+    source.bytes = data;
+    return source;
+}
\ No newline at end of file
@@ -7,11 +7,41 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <vector>
 #include "spdlog/spdlog.h"
 #include "glad/glad.h"
 
 using namespace std;
 
+class MappedFile;
+class ThreadPool;
+
+// Everything a texture needs before touching GL, safe to load on any thread: either the cooked block compressed mip
+// chain mapped from disk or the decoded stb pixels of the source image.
+struct TextureSource {
+    struct Level {
+        size_t offset; // into bytes
+        size_t size;
+        int width;
+        int height;
+    };
+
+    bool compressed = false;
+    GLenum format = 0; // compressed internal format, or the pixel format of uncompressed data
+    vector<Level> levels;
+    const unsigned char *bytes = nullptr;
+    size_t size = 0;
+
+    // owners of bytes
+    shared_ptr<MappedFile> mapping;
+    shared_ptr<unsigned char> pixels;
+
+    bool valid() const { return bytes != nullptr; }
+
+    // pool, when given, helps cooking the texture if its cache entry is missing or stale
+    static TextureSource load(const string &path, const string &type, ThreadPool *pool = nullptr);
+};
 
 
 class Texture {
@@ -20,14 +50,64 @@ public:
 
     ~Texture();
 
+    // Texture without GL storage yet, filled later by upload() on the GL thread.
+    static shared_ptr<Texture> deferred(const string &path, const string &type);
+
+    // Creates the GL texture from source. base is where GL reads source.bytes from baseOffset on: source.bytes itself
+    // with baseOffset 0, or nullptr when they were staged at offset 0 of the bound GL_PIXEL_UNPACK_BUFFER. Cooked
+    // textures only get their levels from streamingStartLevel on, the caller may leave out the bytes in front of those.
+    void upload(const TextureSource &source, const unsigned char *base, size_t baseOffset = 0);
+
+    // first level of a cooked chain that is loaded up front
+    static int streamingStartLevel(const TextureSource &source);
+
+    // Immutable storage for mip chain levels firstLevel and coarser, resident levels that fit are copied over.
+    // The GL texture is replaced, ID changes.
+    void allocateStreamed(int firstLevel);
+
+    // Fills chain level residentLevel - 1 from base and baseOffset, same meaning as in upload, and starts sampling it.
+    void uploadStreamedLevel(int level, const unsigned char *base, size_t baseOffset = 0);
+
+    // clamps sampling to chain level lod and coarser, fractional values blend new levels in
+    void setMinLod(float lod);
+
+    // bytes of chain levels firstLevel and coarser
+    size_t streamedBytes(int firstLevel) const;
+
     // the texture ID
     GLuint ID{}; // TODO add more than one texture on top of it
     string path;
     string type;
     string name;
+    bool uploaded = false;
+    // size of all levels on the GPU, what AssetRegistry budgets with
+    size_t gpuBytes = 0;
 
     // constructor reads and builds the texture
     void use(GLenum GL_TEXTUREX);
+
+    // load block compressed mips from the TextureCooker cache, cooking them first if needed
+    static inline bool useCookedTextures = true;
+
+    // cook albedo maps as BC7, the TextureCooker tool's --high-quality
+    static inline bool highQualityCooking = false;
+
+    // cooked textures start with the levels up to this size, TextureStreamer raises them on demand. 0 loads the
+    // whole chain.
+    static inline int streamingStartResolution = 64;
+
+    // Mip streaming state of cooked textures, chain levels count from the full resolution source. GL level 0 of the
+    // texture is chain level allocatedLevel, levels from residentLevel on have data.
+    shared_ptr<TextureSource> streamSource;
+    int allocatedLevel = 0;
+    int residentLevel = 0;
+    int startLevel = 0;
+    float minLod = 0.0f;
+
+private:
+    Texture() = default;
+
+    void setSamplerState();
 };
 
 
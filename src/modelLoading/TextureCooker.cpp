@@ -0,0 +1,226 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "TextureCooker.h"
+#include "MappedFile.h"
+#include "stb_image.h"
+#include "spdlog/spdlog.h"
+#include "glad/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+// S3TC is an extension, not every glad configuration has the names
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+    constexpr char identifier[8] = {'R', 'G', 'L', 'T', 'E', 'X', '\r', '\n'};
+    constexpr uint32_t cookedVersion = 1;
+    constexpr size_t levelAlignment = 16;
+
+    enum class MipFilter {
+        Color,  // averaged in linear space, the shaders treat albedo as gamma 2.2
+        Normal, // averaged as vectors and renormalized
+        Linear
+    };
+
+    struct Image {
+        int width, height;
+        std::vector<uint8_t> rgba;
+    };
+
+    Image downsample(const Image &source, MipFilter filter) {
+        Image result{std::max(1, source.width / 2), std::max(1, source.height / 2), {}};
+        result.rgba.resize(static_cast<size_t>(result.width) * result.height * 4);
+        auto texel = [&](int x, int y, int c) {
+            x = std::min(x, source.width - 1);
+            y = std::min(y, source.height - 1);
+            return source.rgba[(static_cast<size_t>(y) * source.width + x) * 4 + c] / 255.0f;
+        };
+
+        for (int y = 0; y < result.height; ++y) {
+            for (int x = 0; x < result.width; ++x) {
+                float sum[4] = {};
+                for (int s = 0; s < 4; ++s) {
+                    int sx = x * 2 + (s & 1), sy = y * 2 + (s >> 1);
+                    for (int c = 0; c < 4; ++c) {
+                        float value = texel(sx, sy, c);
+                        if (filter == MipFilter::Color && c < 3) value = std::pow(value, 2.2f);
+                        if (filter == MipFilter::Normal && c < 3) value = value * 2.0f - 1.0f;
+                        sum[c] += value * 0.25f;
+                    }
+                }
+                if (filter == MipFilter::Color) {
+                    for (int c = 0; c < 3; ++c) sum[c] = std::pow(sum[c], 1.0f / 2.2f);
+                } else if (filter == MipFilter::Normal) {
+                    float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                    for (int c = 0; c < 3; ++c) sum[c] = (length > 0.0f ? sum[c] / length : 0.0f) * 0.5f + 0.5f;
+                }
+                uint8_t *out = &result.rgba[(static_cast<size_t>(y) * result.width + x) * 4];
+                for (int c = 0; c < 4; ++c) out[c] = static_cast<uint8_t>(std::lround(std::clamp(sum[c], 0.0f, 1.0f) * 255.0f));
+            }
+        }
+        return result;
+    }
+
+    uint64_t fnv1a(const std::string &text) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c: text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+std::string TextureCooker::cachePath(const std::string &sourcePath, const std::string &type,
+                                     const TextureCookSettings &settings) {
+    // the tool and the game have to agree on the key, however the path was spelled
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(sourcePath, error);
+    std::string key = error ? sourcePath : absolute.lexically_normal().generic_string();
+    // type and settings pick the block format, one source cooked two ways is two entries
+    key += "|" + type + (settings.highQuality ? "|high" : "");
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(fnv1a(key)));
+    return std::string(directory) + name + ".rgltex";
+}
+
+BlockFormat TextureCooker::chooseFormat(const std::string &type, bool hasAlpha, const TextureCookSettings &settings) {
+    if (type == "texture_normal") return BlockFormat::BC5;
+    if (type == "texture_metallic" || type == "texture_roughness" || type == "texture_ao" ||
+        type == "texture_height")
+        return BlockFormat::BC4;
+    if (settings.highQuality) return BlockFormat::BC7;
+    return hasAlpha ? BlockFormat::BC3 : BlockFormat::BC1;
+}
+
+uint32_t TextureCooker::glInternalFormat(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        case BlockFormat::BC7:
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+int64_t TextureCooker::sourceTime(const std::string &sourcePath) {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(sourcePath, error);
+    if (error) return 0;
+    return static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+uint64_t TextureCooker::typeHash(const std::string &type) {
+    return fnv1a(type);
+}
+
+bool TextureCooker::cook(const std::string &sourcePath, const std::string &type,
+                         const TextureCookSettings &settings, ThreadPool *pool) {
+    int64_t time = sourceTime(sourcePath);
+    int width, height, channels;
+    unsigned char *data = stbi_load(sourcePath.c_str(), &width, &height, &channels, 4);
+    if (data == nullptr || time == 0) {
+        stbi_image_free(data);
+        return false;
+    }
+    Image image{width, height, std::vector<uint8_t>(data, data + static_cast<size_t>(width) * height * 4)};
+    stbi_image_free(data);
+
+    bool hasAlpha = false;
+    for (size_t i = 3; i < image.rgba.size() && !hasAlpha; i += 4) hasAlpha = image.rgba[i] != 255;
+    BlockFormat format = chooseFormat(type, hasAlpha, settings);
+    MipFilter filter = type == "texture_normal" ? MipFilter::Normal
+                                                : type == "texture_albedo" ? MipFilter::Color : MipFilter::Linear;
+
+    CookedTextureHeader header{};
+    memcpy(header.identifier, identifier, sizeof(identifier));
+    header.version = cookedVersion;
+    header.format = format;
+    header.glInternalFormat = glInternalFormat(format);
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.levelCount = 1 + static_cast<uint32_t>(std::floor(std::log2(static_cast<float>(std::max(width, height)))));
+    header.sourceTime = time;
+    header.typeHash = typeHash(type);
+
+    std::vector<CookedTextureLevel> levelIndex(header.levelCount);
+    std::vector<uint8_t> levelData;
+    size_t dataStart = sizeof(CookedTextureHeader) + levelIndex.size() * sizeof(CookedTextureLevel);
+    for (uint32_t level = 0; level < header.levelCount; ++level) {
+        if (level > 0) image = downsample(image, filter);
+        std::vector<uint8_t> blocks = BlockCompression::encode(format, image.rgba.data(), image.width, image.height,
+                                                             pool);
+        levelData.resize((levelData.size() + levelAlignment - 1) / levelAlignment * levelAlignment);
+        levelIndex[level].byteOffset = dataStart + levelData.size();
+        levelIndex[level].byteLength = blocks.size();
+        levelData.insert(levelData.end(), blocks.begin(), blocks.end());
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string path = cachePath(sourcePath, type, settings);
+    // textures can be cooked from several loader threads at once, each writes its own temporary
+    std::string temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        spdlog::warn("Failed to write cooked texture " + path);
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(levelIndex.data()),
+              static_cast<std::streamsize>(levelIndex.size() * sizeof(CookedTextureLevel)));
+    out.write(reinterpret_cast<const char *>(levelData.data()), static_cast<std::streamsize>(levelData.size()));
+    out.close();
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        spdlog::warn("Failed to write cooked texture " + path + ": " + error.message());
+        return false;
+    }
+    spdlog::info("Cooked {} ({}) into {}: BC{}, {} levels, {} B instead of {} B", sourcePath, type, path,
+                 static_cast<uint32_t>(format), header.levelCount, levelData.size(),
+                 static_cast<size_t>(width) * height * 4 * 4 / 3);
+    return true;
+}
+
+const CookedTextureHeader *TextureCooker::validate(const MappedFile &file, const std::string &sourcePath,
+                                                   const std::string &type) {
+    if (!file.valid() || file.size < sizeof(CookedTextureHeader)) return nullptr;
+    const auto *header = reinterpret_cast<const CookedTextureHeader *>(file.data);
+    if (memcmp(header->identifier, identifier, sizeof(identifier)) != 0 || header->version != cookedVersion)
+        return nullptr;
+    if (header->sourceTime != sourceTime(sourcePath) || header->typeHash != typeHash(type)) return nullptr;
+    if (header->levelCount == 0 || header->levelCount > 32 ||
+        file.size < sizeof(CookedTextureHeader) + header->levelCount * sizeof(CookedTextureLevel))
+        return nullptr;
+
+    const CookedTextureLevel *index = levels(file);
+    for (uint32_t level = 0; level < header->levelCount; ++level) {
+        uint32_t width = std::max(1u, header->width >> level), height = std::max(1u, header->height >> level);
+        if (index[level].byteLength != BlockCompression::imageSize(header->format, width, height) ||
+            index[level].byteOffset > file.size || index[level].byteLength > file.size - index[level].byteOffset)
+            return nullptr;
+    }
+    return header;
+}
+
+const CookedTextureLevel *TextureCooker::levels(const MappedFile &file) {
+    return reinterpret_cast<const CookedTextureLevel *>(file.data + sizeof(CookedTextureHeader));
+}
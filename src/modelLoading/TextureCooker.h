@@ -0,0 +1,71 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_TEXTURECOOKER_H
+#define REASONABLEGL_TEXTURECOOKER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+
+class MappedFile;
+class ThreadPool;
+
+// Cooked texture container, laid out like KTX2: a fixed header, then a level index, then the block compressed
+// level data (largest first, 16 byte aligned) ready for glCompressedTexImage2D.
+struct CookedTextureHeader {
+    char identifier[8];
+    uint32_t version;
+    BlockFormat format;
+    uint32_t glInternalFormat;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    int64_t sourceTime;
+    uint64_t typeHash;
+};
+
+struct CookedTextureLevel {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+};
+
+struct TextureCookSettings {
+    // BC7 instead of BC1/BC3 for albedo maps, slower to cook
+    bool highQuality = false;
+};
+
+// Decodes a source image, builds the mip chain on the CPU and block compresses it with a format picked from the
+// texture type. Used lazily by Texture and ahead of time by the TextureCooker tool, both write to the same cache.
+class TextureCooker {
+public:
+    static constexpr const char *directory = "res/cache/textures/";
+
+    static std::string cachePath(const std::string &sourcePath, const std::string &type,
+                                 const TextureCookSettings &settings);
+
+    // albedo: BC1 (BC3 with alpha, BC7 in high quality), normal: BC5, single channel maps: BC4
+    static BlockFormat chooseFormat(const std::string &type, bool hasAlpha, const TextureCookSettings &settings);
+
+    static uint32_t glInternalFormat(BlockFormat format);
+
+    // pool, when given, encodes the blocks of every level in parallel
+    static bool cook(const std::string &sourcePath, const std::string &type,
+                     const TextureCookSettings &settings = TextureCookSettings(), ThreadPool *pool = nullptr);
+
+    // Header of a cooked file that is complete and still matches its source, nullptr otherwise.
+    static const CookedTextureHeader *validate(const MappedFile &file, const std::string &sourcePath,
+                                               const std::string &type);
+
+    static const CookedTextureLevel *levels(const MappedFile &file);
+
+private:
+    static int64_t sourceTime(const std::string &sourcePath);
+
+    static uint64_t typeHash(const std::string &type);
+};
+
+
+#endif //REASONABLEGL_TEXTURECOOKER_H
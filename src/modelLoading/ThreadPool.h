@@ -0,0 +1,46 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_THREADPOOL_H
+#define REASONABLEGL_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in FIFO order. Tasks still queued on destruction are dropped.
+class ThreadPool {
+public:
+    // 0 picks one thread less than the hardware has, the GL thread keeps its core
+    explicit ThreadPool(unsigned int threadCount = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Runs body(0..count-1) spread over the workers and the calling thread, returns once every index ran. The caller
+    // works through the indices as well, so this is safe to call from a task of the same pool.
+    void parallelFor(size_t count, const std::function<void(size_t index)> &body);
+
+    size_t threadCount() const { return workers.size(); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+
+#endif //REASONABLEGL_THREADPOOL_H
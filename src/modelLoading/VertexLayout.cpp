@@ -0,0 +1,221 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#include "VertexLayout.h"
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+    GLsizei positionSize(PositionFormat format) {
+        return format == PositionFormat::Float ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+    }
+
+    template<typename T>
+    void write(uint8_t *&dst, T value) {
+        std::memcpy(dst, &value, sizeof(T));
+        dst += sizeof(T);
+    }
+
+    template<typename T>
+    T read(const uint8_t *&src) {
+        T value;
+        std::memcpy(&value, src, sizeof(T));
+        src += sizeof(T);
+        return value;
+    }
+
+    float signNotZero(float v) {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+}
+
+glm::vec2 octahedralEncode(glm::vec3 n) {
+    float l1 = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+    if (l1 == 0.0f) return glm::vec2(0.0f);
+    n /= l1;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p = glm::vec2((1.0f - glm::abs(n.y)) * signNotZero(n.x), (1.0f - glm::abs(n.x)) * signNotZero(n.y));
+    }
+    return p;
+}
+
+VertexLayout VertexLayout::Full() {
+    return VertexLayout();
+}
+
+VertexLayout VertexLayout::Compact() {
+    VertexLayout layout;
+    layout.positionFormat = PositionFormat::UNorm16;
+    layout.octahedralNormals = true;
+    layout.halfTexCoords = true;
+    return layout;
+}
+
+GLsizei VertexLayout::normalOffset() const {
+    return positionSize(positionFormat);
+}
+
+GLsizei VertexLayout::texCoordsOffset() const {
+    return normalOffset() + (octahedralNormals ? 2 * sizeof(int16_t) : 3 * sizeof(float));
+}
+
+GLsizei VertexLayout::tangentOffset() const {
+    return texCoordsOffset() + (halfTexCoords ? 2 * sizeof(uint16_t) : 2 * sizeof(float));
+}
+
+GLsizei VertexLayout::stride() const {
+    return tangentOffset() + (octahedralNormals ? 4 * sizeof(int16_t) : 6 * sizeof(float));
+}
+
+glm::vec3 VertexLayout::decodeOffset(glm::vec3 boundsMin, glm::vec3 boundsMax) const {
+    switch (positionFormat) {
+        case PositionFormat::Half:
+            return (boundsMin + boundsMax) * 0.5f;
+        case PositionFormat::UNorm16:
+            return boundsMin;
+        default:
+            return glm::vec3(0.0f);
+    }
+}
+
+glm::vec3 VertexLayout::decodeScale(glm::vec3 boundsMin, glm::vec3 boundsMax) const {
+    if (positionFormat == PositionFormat::UNorm16) {
+        return glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    }
+    return glm::vec3(1.0f);
+}
+
+std::vector<uint8_t> VertexLayout::pack(const std::vector<Vertex> &vertices, glm::vec3 boundsMin,
+                                        glm::vec3 boundsMax) const {
+    std::vector<uint8_t> data(vertices.size() * stride());
+    glm::vec3 offset = decodeOffset(boundsMin, boundsMax);
+    glm::vec3 scale = decodeScale(boundsMin, boundsMax);
+
+    uint8_t *dst = data.data();
+    for (const Vertex &vertex: vertices) {
+        // position
+        glm::vec3 position = (vertex.Position - offset) / scale;
+        for (int i = 0; i < 3; ++i) {
+            if (positionFormat == PositionFormat::Float)
+                write(dst, position[i]);
+            else if (positionFormat == PositionFormat::Half)
+                write(dst, glm::packHalf1x16(position[i]));
+            else
+                write(dst, glm::packUnorm1x16(position[i]));
+        }
+        if (positionFormat != PositionFormat::Float)
+            write<uint16_t>(dst, 0); // pad to 8 bytes
+
+        // normal
+        if (octahedralNormals) {
+            glm::vec2 octNormal = octahedralEncode(vertex.Normal);
+            write(dst, glm::packSnorm1x16(octNormal.x));
+            write(dst, glm::packSnorm1x16(octNormal.y));
+        } else {
+            write(dst, vertex.Normal);
+        }
+
+        // texCoords
+        if (halfTexCoords) {
+            write(dst, glm::packHalf1x16(vertex.TexCoords.x));
+            write(dst, glm::packHalf1x16(vertex.TexCoords.y));
+        } else {
+            write(dst, vertex.TexCoords);
+        }
+
+        // tangent frame
+        if (octahedralNormals) {
+            glm::vec2 octTangent = octahedralEncode(vertex.Tangent);
+            float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+            write(dst, glm::packSnorm1x16(octTangent.x));
+            write(dst, glm::packSnorm1x16(octTangent.y));
+            write<uint16_t>(dst, 0);
+            write(dst, glm::packSnorm1x16(handedness));
+        } else {
+            write(dst, vertex.Tangent);
+            write(dst, vertex.Bitangent);
+        }
+    }
+    return data;
+}
+
+std::vector<glm::vec3> VertexLayout::unpackPositions(const uint8_t *data, size_t vertexCount, glm::vec3 boundsMin,
+                                                    glm::vec3 boundsMax) const {
+    std::vector<glm::vec3> positions(vertexCount);
+    glm::vec3 offset = decodeOffset(boundsMin, boundsMax);
+    glm::vec3 scale = decodeScale(boundsMin, boundsMax);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        // position is always the first attribute
+        const uint8_t *src = data + v * stride();
+        glm::vec3 position;
+        for (int i = 0; i < 3; ++i) {
+            if (positionFormat == PositionFormat::Float)
+                position[i] = read<float>(src);
+            else if (positionFormat == PositionFormat::Half)
+                position[i] = glm::unpackHalf1x16(read<uint16_t>(src));
+            else
+                position[i] = glm::unpackUnorm1x16(read<uint16_t>(src));
+        }
+        positions[v] = position * scale + offset;
+    }
+    return positions;
+}
+
+std::vector<uint8_t> VertexLayout::packSkin(const std::vector<Vertex> &vertices) {
+    std::vector<uint8_t> data(vertices.size() * skinStride);
+    uint8_t *dst = data.data();
+    for (const Vertex &vertex: vertices) {
+        for (int id: vertex.m_BoneIDs)
+            write(dst, static_cast<uint16_t>(id < 0 ? 0 : id));
+        for (float weight: vertex.m_Weights)
+            write(dst, glm::packUnorm1x8(weight));
+    }
+    return data;
+}
+
+void VertexLayout::setAttributes() const {
+    GLsizei vertexStride = stride();
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    if (positionFormat == PositionFormat::Float)
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void *) 0);
+    else if (positionFormat == PositionFormat::Half)
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, vertexStride, (void *) 0);
+    else
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, vertexStride, (void *) 0);
+
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    if (octahedralNormals)
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, vertexStride, (void *) (intptr_t) normalOffset());
+    else
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void *) (intptr_t) normalOffset());
+
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, vertexStride,
+                          (void *) (intptr_t) texCoordsOffset());
+
+    // vertex tangent (and bitangent for the full layout)
+    glEnableVertexAttribArray(3);
+    if (octahedralNormals) {
+        glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, vertexStride, (void *) (intptr_t) tangentOffset());
+        glDisableVertexAttribArray(4);
+    } else {
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, vertexStride, (void *) (intptr_t) tangentOffset());
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, vertexStride,
+                              (void *) (intptr_t) (tangentOffset() + 3 * sizeof(float)));
+    }
+}
+
+void VertexLayout::setSkinAttributes() {
+    // ids
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, GL_UNSIGNED_SHORT, skinStride, (void *) 0);
+    // weights
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, skinStride, (void *) (4 * sizeof(uint16_t)));
+}
@@ -0,0 +1,87 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+#ifndef REASONABLEGL_VERTEXLAYOUT_H
+#define REASONABLEGL_VERTEXLAYOUT_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad/glad.h"
+
+#define MAX_BONE_INFLUENCE 4
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+    //bone indexes which will influence this vertex
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    //weights from each bone
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+enum class PositionFormat {
+    Float,   // 3 x float
+    Half,    // 4 x half, relative to the bounds center
+    UNorm16  // 4 x normalized ushort, relative to the bounds min/extent
+};
+
+// Describes how a mesh stores its vertices on the GPU. Attribute locations never change (0 position, 1 normal,
+// 2 texCoords, 3 tangent, 4 bitangent, 5 bone ids, 6 bone weights) so shaders only need the decode uniforms
+// set by Mesh::bindVertexFormat to work with every layout.
+struct VertexLayout {
+    PositionFormat positionFormat = PositionFormat::Float;
+    bool octahedralNormals = false; // normal as 2 x snorm16, tangent as 2 x snorm16 + handedness, no bitangent
+    bool halfTexCoords = false;
+    bool skinning = false; // bone stream is uploaded only if this is set AND the mesh actually has bones
+
+    // 56 bytes per vertex, same precision as Vertex
+    static VertexLayout Full();
+
+    // 24 bytes per vertex
+    static VertexLayout Compact();
+
+    GLsizei stride() const;
+
+    GLsizei normalOffset() const;
+
+    GLsizei texCoordsOffset() const;
+
+    GLsizei tangentOffset() const;
+
+    // Interleaves vertices into the layout. Quantized positions are stored relative to boundsMin/boundsMax.
+    std::vector<uint8_t> pack(const std::vector<Vertex> &vertices, glm::vec3 boundsMin, glm::vec3 boundsMax) const;
+
+    // Decodes just the positions of an interleaved stream made by pack with the same bounds.
+    std::vector<glm::vec3> unpackPositions(const uint8_t *data, size_t vertexCount, glm::vec3 boundsMin,
+                                           glm::vec3 boundsMax) const;
+
+    // ids as 4 x ushort followed by weights as 4 x normalized ubyte, 12 bytes per vertex
+    static std::vector<uint8_t> packSkin(const std::vector<Vertex> &vertices);
+
+    static constexpr GLsizei skinStride = 4 * sizeof(uint16_t) + 4 * sizeof(uint8_t);
+
+    // Sets attribute pointers 0-4 for the currently bound GL_ARRAY_BUFFER and VAO.
+    void setAttributes() const;
+
+    // Sets attribute pointers 5-6 for the currently bound GL_ARRAY_BUFFER and VAO.
+    static void setSkinAttributes();
+
+    // Values for the vertexPositionOffset/vertexPositionScale uniforms: position = aPos * scale + offset.
+    glm::vec3 decodeOffset(glm::vec3 boundsMin, glm::vec3 boundsMax) const;
+
+    glm::vec3 decodeScale(glm::vec3 boundsMin, glm::vec3 boundsMax) const;
+};
+
+glm::vec2 octahedralEncode(glm::vec3 n);
+
+#endif //REASONABLEGL_VERTEXLAYOUT_H
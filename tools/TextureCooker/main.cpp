@@ -0,0 +1,61 @@
+//
+// Created by redkc on 19/10/2026.
+//
+
+// Cooks textures into res/cache/textures ahead of time, so the game never has to do it on first load.
+// usage: TextureCooker [--high-quality] [--type <texture type>] <image>...
+// Without --type the type is guessed from the file name suffix (_albedo, _normal, _metallic, _roughness, _ao).
+// Run it from the project directory and pass the paths the same way the game does. --high-quality entries are only
+// used by a game with Texture::highQualityCooking set.
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "stb_image.h"
+#include "modelLoading/TextureCooker.h"
+#include "modelLoading/ThreadPool.h"
+#include "spdlog/spdlog.h"
+#include <string>
+
+static std::string guessType(const std::string &path) {
+    const char *suffixes[][2] = {
+            {"_albedo",    "texture_albedo"},
+            {"_normal",    "texture_normal"},
+            {"_metallic",  "texture_metallic"},
+            {"_roughness", "texture_roughness"},
+            {"_ao",        "texture_ao"},
+    };
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    for (auto &suffix: suffixes) {
+        if (name.find(suffix[0]) != std::string::npos) return suffix[1];
+    }
+    return "texture_albedo";
+}
+
+int main(int argc, char **argv) {
+    // must match the game, see init() in main.cpp
+    stbi_set_flip_vertically_on_load(true);
+
+    TextureCookSettings settings;
+    // encodes the rows of blocks of every level
+    ThreadPool pool;
+    std::string type;
+    int failures = 0, cooked = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--high-quality") {
+            settings.highQuality = true;
+        } else if (argument == "--type" && i + 1 < argc) {
+            type = argv[++i];
+        } else if (TextureCooker::cook(argument, type.empty() ? guessType(argument) : type, settings, &pool)) {
+            cooked++;
+        } else {
+            spdlog::error("Failed to cook " + argument);
+            failures++;
+        }
+    }
+    if (cooked + failures == 0) {
+        spdlog::info("usage: TextureCooker [--high-quality] [--type <texture type>] <image>...");
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}